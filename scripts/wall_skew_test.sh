@@ -0,0 +1,112 @@
+#!/bin/bash
+
+# Video wall skew test
+# Launches one offscreen VideoTimeline instance per wall tile against a running
+# server, lets them play in lockstep and reports the skew between tiles.
+#
+# Every instance logs "[Sync] Position ... skew=<ms> at=<synced ms>" about once a
+# second. Samples are grouped by synced second and playlist item; the spread
+# (max - min skew across tiles) of each group is the inter-tile skew.
+#
+# Usage: ./scripts/wall_skew_test.sh [-s host:port] [-g COLSxROWS] [-d seconds] [-b binary]
+#
+# The server's playlist should contain a video (the harness measures video
+# position); run it with e.g. ./server/run.sh.
+
+set -e
+
+SERVER="localhost:3232"
+GRID="2x2"
+DURATION=60
+APP_BINARY="./build/VideoTimeline"
+
+while getopts "s:g:d:b:h" opt; do
+    case $opt in
+        s) SERVER="$OPTARG" ;;
+        g) GRID="$OPTARG" ;;
+        d) DURATION="$OPTARG" ;;
+        b) APP_BINARY="$OPTARG" ;;
+        *) echo "Usage: $0 [-s host:port] [-g COLSxROWS] [-d seconds] [-b binary]"; exit 1 ;;
+    esac
+done
+
+if [ ! -x "$APP_BINARY" ]; then
+    echo "Error: $APP_BINARY not found. Build first with ./scripts/build.sh"
+    exit 1
+fi
+
+if ! curl -sf "http://$SERVER/api/media/playlist" >/dev/null; then
+    echo "Error: no server reachable at $SERVER"
+    exit 1
+fi
+
+COLS=${GRID%x*}
+ROWS=${GRID#*x}
+TILES=$((COLS * ROWS))
+WORK_DIR=$(mktemp -d /tmp/wall_skew.XXXXXX)
+PIDS=()
+
+cleanup() {
+    for pid in "${PIDS[@]}"; do
+        kill "$pid" 2>/dev/null || true
+    done
+    wait 2>/dev/null || true
+}
+trap cleanup EXIT
+
+echo "Starting $TILES tiles ($GRID) against $SERVER for ${DURATION}s, logs in $WORK_DIR"
+
+for ((row = 0; row < ROWS; row++)); do
+    for ((col = 0; col < COLS; col++)); do
+        tile="${col}_${row}"
+        mkdir -p "$WORK_DIR/cache_$tile"
+        # Separate cache dirs so tiles don't share (or fight over) cached media
+        QT_QPA_PLATFORM=offscreen XDG_CACHE_HOME="$WORK_DIR/cache_$tile" \
+            "$APP_BINARY" --network "$SERVER" --wall "$GRID" --tile "$col,$row" \
+            --log-level debug --quiet-hwaccel > "$WORK_DIR/tile_$tile.log" 2>&1 &
+        PIDS+=($!)
+    done
+done
+
+sleep "$DURATION"
+cleanup
+PIDS=()
+
+# tile bucket item skew, one line per sample
+for log in "$WORK_DIR"/tile_*.log; do
+    tile=$(basename "$log" .log)
+    grep "\[Sync\] Position" "$log" | awk -v tile="$tile" '{
+        for (i = 1; i <= NF; i++) {
+            split($i, kv, "=")
+            if (kv[1] == "item") item = kv[2]
+            else if (kv[1] == "skew") skew = kv[2]
+            else if (kv[1] == "at") at = kv[2]
+        }
+        print tile, int(at / 1000), item, skew
+    }'
+done > "$WORK_DIR/samples.txt"
+
+# Spread per (second, item) over groups where every tile reported
+awk -v tiles="$TILES" '{
+    key = $2 " " $3
+    if (!(key SUBSEP $1 in seen)) {
+        seen[key SUBSEP $1] = 1
+        count[key]++
+        if (!(key in lo) || $4 < lo[key]) lo[key] = $4
+        if (!(key in hi) || $4 > hi[key]) hi[key] = $4
+    }
+} END {
+    for (key in count) if (count[key] == tiles) print hi[key] - lo[key]
+}' "$WORK_DIR/samples.txt" | sort -n > "$WORK_DIR/spread.txt"
+
+SAMPLES=$(wc -l < "$WORK_DIR/spread.txt")
+if [ "$SAMPLES" -eq 0 ]; then
+    echo "No overlapping samples. Check that the playlist has a video and tiles reached lockstep:"
+    echo "  grep Sync $WORK_DIR/tile_*.log"
+    exit 1
+fi
+
+awk '{ v[NR] = $1; sum += $1 } END {
+    p95 = v[int((NR - 1) * 0.95) + 1]
+    printf "Inter-tile skew over %d samples: mean %.1f ms, p95 %d ms, max %d ms\n", NR, sum / NR, p95, v[NR]
+}' "$WORK_DIR/spread.txt"
@@ -4,6 +4,7 @@
 #include <QTcpSocket>
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
@@ -53,6 +54,12 @@ HttpServer::HttpServer(QObject *parent) : QObject(parent), port(3232) {
         server = new QTcpServer(this);
         connect(server, &QTcpServer::newConnection, this, &HttpServer::handleNewConnection);
         
+        // Live streams for "stream" playlist items
+        streamRelay = new StreamRelay(this);
+        connect(streamRelay, &StreamRelay::message, this, [this](bool warning, const QString &text) {
+            log(warning ? WARN : INFO, text);
+        });
+        
         // Setup directories
         QDir().mkpath(dataDir);
         QDir().mkpath(mediaDir);
@@ -66,6 +73,8 @@ HttpServer::HttpServer(QObject *parent) : QObject(parent), port(3232) {
         
         // Generate playlist from media folder only if needed
         ensurePlaylist();
+        
+        loadStreams();
     }
 
 HttpServer::~HttpServer() {
@@ -98,8 +107,14 @@ void HttpServer::handleNewConnection() {
     }
 
 void HttpServer::handleRequest(QTcpSocket *socket) {
+        // Receive timestamp for /api/time, taken before any parsing or logging
+        socket->setProperty("receive_ms", QDateTime::currentMSecsSinceEpoch());
         QByteArray request = socket->readAll();
         
+        // Headers used to resume interrupted media downloads
+        socket->setProperty("range", headerValue(request, "Range"));
+        socket->setProperty("if_range", headerValue(request, "If-Range"));
+        
         // Parse request line
         int firstSpace = request.indexOf(' ');
         int secondSpace = request.indexOf(' ', firstSpace + 1);
@@ -147,6 +162,12 @@ void HttpServer::handleGetRequest(QTcpSocket *socket, const QString &path) {
             toggleScreenMirroring(socket);
         } else if (path == "/api/special/check") {
             handleCheckSpecialEvent(socket);
+        } else if (path == "/api/stream/list") {
+            handleGetStreamList(socket);
+        } else if (path == "/api/decode/reports") {
+            handleGetDecodeReports(socket);
+        } else if (path.startsWith("/stream/")) {
+            handleGetStream(socket, path);
         } else if (path.startsWith("/media/")) {
             handleGetMediaFile(socket, path);
         } else {
@@ -166,6 +187,8 @@ void HttpServer::handlePostRequest(QTcpSocket *socket, const QString &path, cons
             handlePostSchedule(socket, body);
         } else if (path == "/api/media/playlist") {
             handlePostPlaylist(socket, body);
+        } else if (path == "/api/decode/report") {
+            handlePostDecodeReport(socket, body);
         } else {
             sendResponse(socket, "404 Not Found", "text/plain", "Not Found");
         }
@@ -300,6 +323,11 @@ void HttpServer::handleGetPlaylist(QTcpSocket *socket) {
                     log(INFO, "Auto-regenerating playlist due to media folder changes");
                     generatePlaylist();
                     json = readFile(filePath);
+                } else if (!playlist.contains("epoch")) {
+                    // Older playlist files have no epoch; the file's modification time is
+                    // stable across requests so all clients still agree on one
+                    playlist["epoch"] = QFileInfo(filePath).lastModified().toMSecsSinceEpoch();
+                    json = QJsonDocument(playlist).toJson(QJsonDocument::Indented);
                 }
             } else {
                 log(ERROR, QString("Invalid playlist JSON, regenerating: %1").arg(error.errorString()));
@@ -308,6 +336,8 @@ void HttpServer::handleGetPlaylist(QTcpSocket *socket) {
             }
         }
         
+        // Displays that can't decode an item in time get its lighter rendition
+        json = applyLightRenditions(json, socket->peerAddress().toString());
         sendResponse(socket, "200 OK", "application/json", json);
     }
 
@@ -324,10 +354,17 @@ void HttpServer::handleGetTime(QTcpSocket *socket) {
         timeObj["timezone"] = now.timeZone().displayName(QTimeZone::GenericTime, QTimeZone::DefaultName);
         timeObj["server_hostname"] = QHostInfo::localHostName();
         
-        QJsonDocument doc(timeObj);
-        QString json = doc.toJson(QJsonDocument::Compact);
+        // NTP-style receive/transmit timestamps so clients can separate our
+        // processing time from the network round trip
+        qint64 receiveMs = socket->property("receive_ms").toLongLong();
+        timeObj["receive_timestamp"] = receiveMs > 0 ? receiveMs : timestamp;
         
         log(DEBUG, QString("Time sync request: %1").arg(isoString));
+        
+        // Transmit timestamp as late as possible, right before the reply is written
+        timeObj["transmit_timestamp"] = QDateTime::currentMSecsSinceEpoch();
+        QJsonDocument doc(timeObj);
+        QString json = doc.toJson(QJsonDocument::Compact);
         sendResponse(socket, "200 OK", "application/json", json);
     }
 
@@ -351,10 +388,38 @@ void HttpServer::handleGetMediaFile(QTcpSocket *socket, const QString &path) {
         
         QFile file(filePath);
         if (file.open(QIODevice::ReadOnly)) {
-            QByteArray content = file.readAll();
             QString contentType = getContentType(fileName);
+            qint64 fileSize = file.size();
+            
+            // The ETag identifies this version of the file; clients resuming a
+            // download send it back in If-Range
+            QFileInfo info(filePath);
+            QString etag = QString("\"%1-%2\"").arg(info.lastModified().toMSecsSinceEpoch(), 0, 16).arg(fileSize, 0, 16);
+            QString headers = QString("Accept-Ranges: bytes\r\nETag: %1\r\n").arg(etag);
+            
+            QByteArray range = socket->property("range").toByteArray();
+            QByteArray ifRange = socket->property("if_range").toByteArray();
+            if (!range.isEmpty() && (ifRange.isEmpty() || ifRange == etag.toUtf8())) {
+                qint64 start = 0;
+                qint64 end = 0;
+                if (!parseByteRange(range, fileSize, &start, &end)) {
+                    log(WARN, QString("Unsatisfiable range %1 for %2").arg(QString(range)).arg(fileName));
+                    sendMediaResponse(socket, "416 Range Not Satisfiable", "text/plain", QByteArray(),
+                                      headers + QString("Content-Range: bytes */%1\r\n").arg(fileSize));
+                    return;
+                }
+                
+                file.seek(start);
+                QByteArray content = file.read(end - start + 1);
+                log(DEBUG, QString("Serving file: %1 bytes %2-%3/%4 (%5) to %6").arg(fileName).arg(start).arg(end).arg(fileSize).arg(contentType).arg(socket->peerAddress().toString()));
+                sendMediaResponse(socket, "206 Partial Content", contentType, content,
+                                  headers + QString("Content-Range: bytes %1-%2/%3\r\n").arg(start).arg(end).arg(fileSize));
+                return;
+            }
+            
+            QByteArray content = file.readAll();
             log(DEBUG, QString("Serving file: %1 (%2 bytes, %3) to %4").arg(fileName).arg(content.size()).arg(contentType).arg(socket->peerAddress().toString()));
-            sendResponse(socket, "200 OK", contentType, content);
+            sendMediaResponse(socket, "200 OK", contentType, content, headers);
         } else {
             log(ERROR, QString("Failed to read media file: %1").arg(filePath));
             sendResponse(socket, "500 Internal Server Error", "text/plain", "Could not read file");
@@ -388,6 +453,11 @@ void HttpServer::handlePostPlaylist(QTcpSocket *socket, const QByteArray &body)
                 playlist["auto_regenerate"] = true;
             }
             
+            // A new playlist starts a new lockstep loop unless the caller pins the epoch
+            if (!playlist.contains("epoch")) {
+                playlist["epoch"] = QDateTime::currentMSecsSinceEpoch();
+            }
+            
             // Write the updated playlist
             QJsonDocument updatedDoc(playlist);
             QString filePath = dataDir + "/playlist.json";
@@ -420,6 +490,66 @@ void HttpServer::sendResponse(QTcpSocket *socket, const QString &status, const Q
         log(DEBUG, QString("Response: %1 %2 (%3 bytes) to %4").arg(status).arg(contentType).arg(body.size()).arg(clientIP));
     }
     
+void HttpServer::sendMediaResponse(QTcpSocket *socket, const QString &status, const QString &contentType, const QByteArray &body, const QString &extraHeaders) {
+        QString response = QString("HTTP/1.1 %1\r\n"
+                                  "Content-Type: %2\r\n"
+                                  "Content-Length: %3\r\n"
+                                  "%4"
+                                  "Access-Control-Allow-Origin: *\r\n"
+                                  "\r\n")
+                          .arg(status)
+                          .arg(contentType)
+                          .arg(body.size())
+                          .arg(extraHeaders);
+        
+        socket->write(response.toUtf8() + body);
+        socket->flush();
+        
+        QString clientIP = socket->peerAddress().toString();
+        log(DEBUG, QString("Response: %1 %2 (%3 bytes) to %4").arg(status).arg(contentType).arg(body.size()).arg(clientIP));
+    }
+    
+QByteArray HttpServer::headerValue(const QByteArray &request, const QByteArray &name) {
+        int headerEnd = request.indexOf("\r\n\r\n");
+        QList<QByteArray> lines = request.left(headerEnd == -1 ? request.size() : headerEnd).split('\n');
+        for (int i = 1; i < lines.size(); ++i) { // Skip the request line
+            QByteArray line = lines[i].trimmed();
+            int colon = line.indexOf(':');
+            if (colon > 0 && line.left(colon).trimmed().toLower() == name.toLower()) {
+                return line.mid(colon + 1).trimmed();
+            }
+        }
+        return QByteArray();
+    }
+    
+bool HttpServer::parseByteRange(const QByteArray &range, qint64 fileSize, qint64 *start, qint64 *end) {
+        // Single ranges only: "bytes=N-" or "bytes=N-M"
+        if (!range.startsWith("bytes=") || range.contains(',')) {
+            return false;
+        }
+        QByteArray spec = range.mid(6);
+        int dash = spec.indexOf('-');
+        if (dash <= 0) {
+            return false; // Suffix ranges ("bytes=-N") are not used by our clients
+        }
+        
+        bool ok = false;
+        *start = spec.left(dash).toLongLong(&ok);
+        if (!ok || *start < 0 || *start >= fileSize) {
+            return false;
+        }
+        *end = fileSize - 1;
+        QByteArray last = spec.mid(dash + 1);
+        if (!last.isEmpty()) {
+            qint64 requestedEnd = last.toLongLong(&ok);
+            if (!ok || requestedEnd < *start) {
+                return false;
+            }
+            *end = qMin(requestedEnd, fileSize - 1);
+        }
+        return true;
+    }
+    
 void HttpServer::sendHeadResponse(QTcpSocket *socket, const QString &status, const QString &contentType, qint64 contentLength) {
         QString response = QString("HTTP/1.1 %1\r\n"
                                   "Content-Type: %2\r\n"
@@ -570,6 +700,12 @@ void HttpServer::generatePlaylist() {
             QString fileName = fileInfo.fileName();
             QString ext = fileInfo.suffix().toLower();
             
+            // name.lite.mp4 is a lighter rendition of name.mp4, not an item of its own
+            if (fileInfo.completeBaseName().endsWith(".lite", Qt::CaseInsensitive)) {
+                log(DEBUG, QString("Skipping light rendition: %1").arg(fileName));
+                continue;
+            }
+            
             QJsonObject item;
             
             if (ext == "mp4" || ext == "avi" || ext == "mov" || ext == "webm") {
@@ -677,6 +813,7 @@ void HttpServer::generatePlaylist() {
         
         QJsonObject playlist;
         playlist["auto_regenerate"] = true; // Default to auto-regenerate for new playlists
+        playlist["epoch"] = QDateTime::currentMSecsSinceEpoch(); // Lockstep loop start shared by all clients
         playlist["items"] = items;
         
         QJsonDocument doc(playlist);
@@ -715,7 +852,14 @@ bool HttpServer::shouldRegeneratePlaylist() {
             QJsonObject playlist = doc.object();
             QJsonArray items = playlist["items"].toArray();
             
-            if (items.size() != files.size()) {
+            // Light renditions are never items
+            int itemFiles = 0;
+            for (const QFileInfo &fileInfo : files) {
+                if (!fileInfo.completeBaseName().endsWith(".lite", Qt::CaseInsensitive)) {
+                    itemFiles++;
+                }
+            }
+            if (items.size() != itemFiles) {
                 return true; // Number of files changed
             }
         }
@@ -884,6 +1028,161 @@ void HttpServer::handleCheckSpecialEvent(QTcpSocket *socket) {
     }
 
 
+void HttpServer::loadStreams() {
+    // Always there, for testing displays and the network without a source
+    streamRelay->setSource("synthetic", QUrl("synthetic:"));
+    
+    // data/streams.json: {"streams": {"name": "http://source/mjpeg", ...}}
+    QString filePath = dataDir + "/streams.json";
+    if (!QFile::exists(filePath)) {
+        return;
+    }
+    streamsModified = QFileInfo(filePath).lastModified();
+    QJsonParseError error;
+    QJsonDocument doc = QJsonDocument::fromJson(readFile(filePath).toUtf8(), &error);
+    if (error.error != QJsonParseError::NoError || !doc.isObject()) {
+        log(ERROR, QString("Invalid streams.json: %1").arg(error.errorString()));
+        return;
+    }
+    QJsonObject streams = doc.object().value("streams").toObject();
+    for (auto it = streams.constBegin(); it != streams.constEnd(); ++it) {
+        QUrl source(it.value().toString());
+        if (it.key().contains('/') || !source.isValid()) {
+            log(WARN, QString("Skipping stream %1: invalid name or source").arg(it.key()));
+            continue;
+        }
+        streamRelay->setSource(it.key(), source);
+        log(INFO, QString("Stream %1 from %2").arg(it.key(), source.toString()));
+    }
+}
+
+void HttpServer::handleGetStream(QTcpSocket *socket, const QString &path) {
+    QString name = path.mid(8); // Remove "/stream/"
+    if (!streamRelay->hasStream(name)) {
+        // Added to streams.json since it was loaded? Only re-read when the
+        // file changed, or any client could make us read it at will
+        QFileInfo streamsFile(dataDir + "/streams.json");
+        if (streamsFile.exists() && streamsFile.lastModified() != streamsModified) {
+            loadStreams();
+        }
+    }
+    if (!streamRelay->hasStream(name)) {
+        log(WARN, QString("Unknown stream requested: %1 from %2").arg(name).arg(socket->peerAddress().toString()));
+        sendResponse(socket, "404 Not Found", "text/plain", "Unknown stream");
+        return;
+    }
+    streamRelay->subscribe(name, socket);
+}
+
+void HttpServer::handleGetStreamList(QTcpSocket *socket) {
+    QJsonObject response;
+    response["streams"] = streamRelay->status();
+    sendResponse(socket, "200 OK", "application/json", QJsonDocument(response).toJson(QJsonDocument::Indented));
+}
+
+void HttpServer::handlePostDecodeReport(QTcpSocket *socket, const QByteArray &body) {
+    QJsonParseError error;
+    QJsonDocument doc = QJsonDocument::fromJson(body, &error);
+    QJsonObject report = doc.object();
+    QString mediaPath = report.value("path").toString();
+    if (error.error != QJsonParseError::NoError || !doc.isObject() || mediaPath.isEmpty()) {
+        sendResponse(socket, "400 Bad Request", "application/json", "{\"status\":\"error\",\"message\":\"Invalid decode report\"}");
+        return;
+    }
+    
+    QString clientIP = socket->peerAddress().toString();
+    report["receivedAt"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+    bool wasOverBudget = decodeReports.value(clientIP).value(mediaPath).value("overBudget").toBool();
+    decodeReports[clientIP][mediaPath] = report;
+    
+    QJsonObject response;
+    response["status"] = "success";
+    if (report.value("overBudget").toBool()) {
+        QString substitute = lightRenditionFor(mediaPath);
+        response["substitute"] = substitute.isEmpty() ? QJsonValue() : QJsonValue(substitute);
+        if (!wasOverBudget) {
+            log(WARN, QString("%1 (%2) can't keep up with %3: %4 %5x%6 on %7 decoder, %8 of %9 frames late%10")
+                .arg(report.value("host").toString(), clientIP, mediaPath, report.value("codec").toString())
+                .arg(report.value("width").toInt())
+                .arg(report.value("height").toInt())
+                .arg(report.value("decoder").toString())
+                .arg(report.value("lateFrames").toInt())
+                .arg(report.value("frames").toInt())
+                .arg(substitute.isEmpty() ? QString(", no light rendition to substitute")
+                                          : QString(", serving %1 instead").arg(substitute)));
+        }
+    }
+    sendResponse(socket, "200 OK", "application/json", QJsonDocument(response).toJson(QJsonDocument::Compact));
+}
+
+void HttpServer::handleGetDecodeReports(QTcpSocket *socket) {
+    QJsonObject clients;
+    for (auto client = decodeReports.constBegin(); client != decodeReports.constEnd(); ++client) {
+        QJsonArray items;
+        for (const QJsonObject &report : client.value()) {
+            items.append(report);
+        }
+        clients[client.key()] = items;
+    }
+    QJsonObject response;
+    response["clients"] = clients;
+    sendResponse(socket, "200 OK", "application/json", QJsonDocument(response).toJson(QJsonDocument::Indented));
+}
+
+QString HttpServer::lightRenditionFor(const QString &mediaPath) {
+    // /media/name.mp4 -> /media/name.lite.<any video extension>, if there is one
+    if (!mediaPath.startsWith("/media/")) {
+        return QString();
+    }
+    QFileInfo original(mediaDir + "/" + mediaPath.mid(7));
+    if (original.completeBaseName().endsWith(".lite", Qt::CaseInsensitive)) {
+        return QString(); // Already the light one
+    }
+    QStringList extensions = {"mp4", "webm", "mov"};
+    for (const QString &ext : extensions) {
+        QString fileName = original.completeBaseName() + ".lite." + ext;
+        if (QFile::exists(original.absolutePath() + "/" + fileName)) {
+            QString directory = QFileInfo(mediaPath).path(); // Keeps subdirectories under /media
+            return directory + "/" + fileName;
+        }
+    }
+    return QString();
+}
+
+QString HttpServer::applyLightRenditions(const QString &playlistJson, const QString &clientIP) {
+    if (!decodeReports.contains(clientIP)) {
+        return playlistJson;
+    }
+    QJsonDocument doc = QJsonDocument::fromJson(playlistJson.toUtf8());
+    if (!doc.isObject()) {
+        return playlistJson;
+    }
+    
+    const QHash<QString, QJsonObject> &reports = decodeReports[clientIP];
+    QJsonObject playlist = doc.object();
+    QJsonArray items = playlist.value("items").toArray();
+    int substituted = 0;
+    for (int i = 0; i < items.size(); ++i) {
+        QJsonObject item = items.at(i).toObject();
+        QString mediaPath = item.value("url").toString();
+        if (item.value("type").toString() != "video" || !reports.value(mediaPath).value("overBudget").toBool()) {
+            continue;
+        }
+        QString substitute = lightRenditionFor(mediaPath);
+        if (!substitute.isEmpty()) {
+            item["url"] = substitute;
+            items[i] = item;
+            substituted++;
+        }
+    }
+    if (substituted == 0) {
+        return playlistJson;
+    }
+    playlist["items"] = items;
+    log(INFO, QString("Serving %1 light rendition(s) to %2").arg(substituted).arg(clientIP));
+    return QJsonDocument(playlist).toJson(QJsonDocument::Indented);
+}
+
 int main(int argc, char *argv[]) {
     QCoreApplication app(argc, argv);
     
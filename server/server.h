@@ -5,6 +5,10 @@
 #include <QTcpServer>
 #include <QTcpSocket>
 #include <QString>
+#include <QHash>
+#include <QJsonObject>
+#include <QDateTime>
+#include "streamrelay.h"
 
 class HttpServer : public QObject {
     Q_OBJECT
@@ -44,6 +48,9 @@ private:
     void sendHeadResponse(QTcpSocket *socket, const QString &status, const QString &contentType, qint64 contentLength);
     void sendResponse(QTcpSocket *socket, const QString &status, const QString &contentType, const QString &body);
     void sendResponse(QTcpSocket *socket, const QString &status, const QString &contentType, const char *body);
+    void sendMediaResponse(QTcpSocket *socket, const QString &status, const QString &contentType, const QByteArray &body, const QString &extraHeaders);
+    QByteArray headerValue(const QByteArray &request, const QByteArray &name);
+    bool parseByteRange(const QByteArray &range, qint64 fileSize, qint64 *start, qint64 *end);
     QString readFile(const QString &filePath);
     void writeFile(const QString &filePath, const QByteArray &data);
     QString getContentType(const QString &fileName);
@@ -56,11 +63,21 @@ private:
     void toggleScreenMirroring(QTcpSocket *socket);
     QString checkForActiveSpecialEvent();
     void handleCheckSpecialEvent(QTcpSocket *socket);
+    void loadStreams();
+    void handleGetStream(QTcpSocket *socket, const QString &path);
+    void handleGetStreamList(QTcpSocket *socket);
+    void handlePostDecodeReport(QTcpSocket *socket, const QByteArray &body);
+    void handleGetDecodeReports(QTcpSocket *socket);
+    QString lightRenditionFor(const QString &mediaPath);
+    QString applyLightRenditions(const QString &playlistJson, const QString &clientIP);
 
     QTcpServer *server;
+    StreamRelay *streamRelay;
     quint16 port;
     QString dataDir;
     QString mediaDir;
+    QHash<QString, QHash<QString, QJsonObject>> decodeReports; // Client IP -> media path -> latest report
+    QDateTime streamsModified; // Of the streams.json last loaded
 };
 
 #endif // HTTPSERVER_H
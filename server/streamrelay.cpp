@@ -0,0 +1,262 @@
+#include "streamrelay.h"
+#include "../src/multipart.h" // Shared with the client's StreamReceiver
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QDateTime>
+#include <QJsonObject>
+#include <QImage>
+#include <QPainter>
+#include <QColor>
+#include <QBuffer>
+
+static const QByteArray OUT_BOUNDARY = "frame";
+
+StreamRelay::StreamRelay(QObject *parent) : QObject(parent) {
+    m_network = new QNetworkAccessManager(this);
+}
+
+StreamRelay::~StreamRelay() {
+    for (Stream *stream : std::as_const(m_streams)) {
+        stopSource(stream);
+    }
+    qDeleteAll(m_streams);
+}
+
+void StreamRelay::setSource(const QString &name, const QUrl &source) {
+    Stream *stream = m_streams.value(name);
+    if (stream) {
+        if (stream->source == source) {
+            return;
+        }
+        stopSource(stream);
+        stream->source = source;
+        if (!stream->viewers.isEmpty()) {
+            startSource(stream);
+        }
+        return;
+    }
+
+    stream = new Stream;
+    stream->name = name;
+    stream->source = source;
+
+    stream->generator = new QTimer(this);
+    stream->generator->setInterval(1000 / SYNTHETIC_FPS);
+    stream->generator->setTimerType(Qt::PreciseTimer);
+    connect(stream->generator, &QTimer::timeout, this, [this, stream]() {
+        generateFrame(stream);
+    });
+
+    stream->retryTimer = new QTimer(this);
+    stream->retryTimer->setSingleShot(true);
+    stream->retryTimer->setInterval(RETRY_MS);
+    connect(stream->retryTimer, &QTimer::timeout, this, [this, stream]() {
+        if (!stream->viewers.isEmpty()) {
+            startSource(stream);
+        }
+    });
+
+    stream->idleTimer = new QTimer(this);
+    stream->idleTimer->setSingleShot(true);
+    stream->idleTimer->setInterval(IDLE_STOP_MS);
+    connect(stream->idleTimer, &QTimer::timeout, this, [this, stream]() {
+        stopSource(stream);
+        emit message(false, QString("Stream %1: no viewers left, source stopped").arg(stream->name));
+    });
+
+    m_streams.insert(name, stream);
+}
+
+bool StreamRelay::hasStream(const QString &name) const {
+    return m_streams.contains(name);
+}
+
+void StreamRelay::subscribe(const QString &name, QTcpSocket *socket) {
+    Stream *stream = m_streams.value(name);
+    if (!stream) {
+        return;
+    }
+
+    // From here on the socket only carries frames
+    disconnect(socket, &QTcpSocket::readyRead, nullptr, nullptr);
+    socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    socket->write("HTTP/1.1 200 OK\r\n"
+                  "Content-Type: multipart/x-mixed-replace; boundary=" + OUT_BOUNDARY + "\r\n"
+                  "Cache-Control: no-cache, no-store\r\n"
+                  "Connection: close\r\n"
+                  "Access-Control-Allow-Origin: *\r\n"
+                  "\r\n");
+    socket->setProperty("stream_sequence", 0);
+
+    stream->viewers.append(socket);
+    connect(socket, &QTcpSocket::bytesWritten, this, [this, stream, socket]() {
+        sendLatest(stream, socket); // Drained: catch up with the newest frame
+    });
+    connect(socket, &QTcpSocket::disconnected, this, [this, stream, socket]() {
+        stream->viewers.removeAll(socket);
+        stream->viewers.removeAll(QPointer<QTcpSocket>());
+        emit message(false, QString("Stream %1: viewer left, %2 remaining").arg(stream->name).arg(stream->viewers.size()));
+        if (stream->viewers.isEmpty()) {
+            stream->idleTimer->start();
+        }
+    });
+
+    emit message(false, QString("Stream %1: viewer %2 joined, %3 watching")
+                 .arg(stream->name, socket->peerAddress().toString()).arg(stream->viewers.size()));
+    stream->idleTimer->stop();
+    startSource(stream);
+    sendLatest(stream, socket);
+}
+
+QJsonArray StreamRelay::status() const {
+    QJsonArray streams;
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    for (const Stream *stream : m_streams) {
+        QJsonObject entry;
+        entry["name"] = stream->name;
+        entry["url"] = "/stream/" + stream->name;
+        entry["source"] = stream->source.toString();
+        entry["running"] = stream->reply != nullptr || stream->generator->isActive();
+        entry["viewers"] = stream->viewers.size();
+        entry["frames"] = static_cast<qint64>(stream->framesIn);
+        entry["frame_age_ms"] = stream->frame.isEmpty() ? -1 : now - stream->timestampMs;
+        streams.append(entry);
+    }
+    return streams;
+}
+
+void StreamRelay::startSource(Stream *stream) {
+    if (stream->source.scheme() == "synthetic") {
+        if (!stream->generator->isActive()) {
+            stream->generator->start();
+            emit message(false, QString("Stream %1: synthetic source started").arg(stream->name));
+        }
+        return;
+    }
+    if (stream->reply || stream->retryTimer->isActive()) {
+        return;
+    }
+
+    QNetworkRequest request(stream->source);
+    request.setRawHeader("Cache-Control", "no-cache");
+    QNetworkReply *reply = m_network->get(request);
+    stream->reply = reply;
+    stream->buffer.clear();
+    stream->boundary.clear();
+    emit message(false, QString("Stream %1: pulling %2").arg(stream->name, stream->source.toString()));
+
+    connect(reply, &QNetworkReply::readyRead, this, [this, stream, reply]() {
+        if (stream->reply != reply) {
+            return;
+        }
+        if (stream->boundary.isEmpty()) {
+            stream->boundary = multipartBoundary(reply->header(QNetworkRequest::ContentTypeHeader).toByteArray());
+            if (stream->boundary.isEmpty()) {
+                emit message(true, QString("Stream %1: source is not multipart (Content-Type %2)")
+                             .arg(stream->name, reply->header(QNetworkRequest::ContentTypeHeader).toString()));
+                stopSource(stream);
+                stream->retryTimer->start();
+                return;
+            }
+        }
+        stream->buffer.append(reply->readAll());
+        parseParts(stream);
+    });
+    connect(reply, &QNetworkReply::finished, this, [this, stream, reply]() {
+        reply->deleteLater();
+        if (stream->reply != reply) {
+            return; // Stopped on purpose
+        }
+        stream->reply = nullptr;
+        emit message(true, QString("Stream %1: source ended (%2), retrying").arg(stream->name, reply->errorString()));
+        if (!stream->viewers.isEmpty()) {
+            stream->retryTimer->start();
+        }
+    });
+}
+
+void StreamRelay::stopSource(Stream *stream) {
+    stream->generator->stop();
+    stream->retryTimer->stop();
+    if (stream->reply) {
+        QNetworkReply *reply = stream->reply;
+        stream->reply = nullptr;
+        reply->abort();
+    }
+    stream->buffer.clear();
+    stream->frame.clear(); // Stale by the time anyone watches again
+}
+
+void StreamRelay::parseParts(Stream *stream) {
+    const QList<MultipartPart> parts = takeMultipartParts(&stream->buffer, stream->boundary);
+    for (const MultipartPart &part : parts) {
+        publish(stream, part.body, part.hasTimestamp ? part.timestampMs : QDateTime::currentMSecsSinceEpoch());
+    }
+    if (stream->buffer.size() > MAX_BUFFER_BYTES) {
+        emit message(true, QString("Stream %1: no frame in %2 bytes, resynchronising").arg(stream->name).arg(stream->buffer.size()));
+        stream->buffer.clear();
+    }
+}
+
+void StreamRelay::generateFrame(Stream *stream) {
+    int frame = stream->generated++;
+    QImage image(SYNTHETIC_WIDTH, SYNTHETIC_HEIGHT, QImage::Format_RGB32);
+    image.fill(QColor::fromHsv((frame * 2) % 360, 160, 110));
+
+    QPainter painter(&image);
+    // A sweeping bar makes stutter and dropped frames visible at a glance
+    painter.fillRect((frame * 8) % SYNTHETIC_WIDTH, 0, 24, SYNTHETIC_HEIGHT, Qt::white);
+    // Frame number as 16 blocks, most significant first; no fonts needed
+    for (int bit = 0; bit < 16; ++bit) {
+        QColor color = (frame >> (15 - bit)) & 1 ? Qt::white : Qt::black;
+        painter.fillRect(16 + bit * 24, SYNTHETIC_HEIGHT - 40, 20, 20, color);
+    }
+    painter.end();
+
+    QByteArray jpeg;
+    QBuffer buffer(&jpeg);
+    buffer.open(QIODevice::WriteOnly);
+    image.save(&buffer, "JPG", 75);
+    publish(stream, jpeg, QDateTime::currentMSecsSinceEpoch());
+}
+
+void StreamRelay::publish(Stream *stream, const QByteArray &jpeg, qint64 timestampMs) {
+    if (jpeg.isEmpty()) {
+        return;
+    }
+    stream->frame = jpeg;
+    stream->timestampMs = timestampMs;
+    stream->sequence++;
+    stream->framesIn++;
+    for (const QPointer<QTcpSocket> &viewer : std::as_const(stream->viewers)) {
+        if (viewer) {
+            sendLatest(stream, viewer);
+        }
+    }
+}
+
+void StreamRelay::sendLatest(Stream *stream, QTcpSocket *socket) {
+    if (stream->frame.isEmpty() || socket->state() != QAbstractSocket::ConnectedState) {
+        return;
+    }
+    // Still sending an older frame: this one is skipped, the newest goes
+    // out once the socket drains
+    if (socket->bytesToWrite() > 0) {
+        return;
+    }
+    if (socket->property("stream_sequence").toULongLong() == stream->sequence) {
+        return;
+    }
+    socket->setProperty("stream_sequence", stream->sequence);
+
+    QByteArray header = "--" + OUT_BOUNDARY + "\r\n"
+                        "Content-Type: image/jpeg\r\n"
+                        "Content-Length: " + QByteArray::number(stream->frame.size()) + "\r\n"
+                        "X-Timestamp: " + QByteArray::number(stream->timestampMs) + "\r\n"
+                        "X-Sequence: " + QByteArray::number(stream->sequence) + "\r\n"
+                        "\r\n";
+    socket->write(header + stream->frame + "\r\n");
+}
@@ -0,0 +1,75 @@
+#ifndef STREAMRELAY_H
+#define STREAMRELAY_H
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QPointer>
+#include <QUrl>
+#include <QJsonArray>
+
+class QNetworkAccessManager;
+class QNetworkReply;
+class QTcpSocket;
+class QTimer;
+
+// Relays live frame streams to the displays as multipart/x-mixed-replace JPEG
+// (MJPEG). A stream's source is pulled from an MJPEG URL (a laptop running
+// ffmpeg or mjpg-streamer, an IP camera) or is "synthetic:", a generated test
+// pattern. Only the newest frame is kept: a display still receiving the
+// previous one skips the frames in between, so a slow link costs frame rate
+// rather than latency. Every frame goes out with an X-Timestamp header (the
+// source's if it sent one, else when the relay received it) for the displays
+// to measure end-to-end latency. Sources run only while someone watches.
+class StreamRelay : public QObject {
+    Q_OBJECT
+
+public:
+    explicit StreamRelay(QObject *parent = nullptr);
+    ~StreamRelay();
+
+    void setSource(const QString &name, const QUrl &source);
+    bool hasStream(const QString &name) const;
+    void subscribe(const QString &name, QTcpSocket *socket); // Takes over the socket
+    QJsonArray status() const;
+
+signals:
+    void message(bool warning, const QString &text);
+
+private:
+    struct Stream {
+        QString name;
+        QUrl source;
+        QNetworkReply *reply = nullptr; // Pulling from source
+        QByteArray buffer;              // Received, not yet parsed
+        QByteArray boundary;
+        QTimer *generator = nullptr;    // Drives synthetic: sources
+        int generated = 0;
+        QTimer *retryTimer = nullptr;   // Reconnects after the source dropped
+        QTimer *idleTimer = nullptr;    // Stops the source once nobody watches
+        QByteArray frame;               // Newest JPEG
+        qint64 timestampMs = 0;
+        quint64 sequence = 0;           // Of frame; viewers remember the last one sent
+        quint64 framesIn = 0;
+        QList<QPointer<QTcpSocket>> viewers;
+    };
+
+    void startSource(Stream *stream);
+    void stopSource(Stream *stream);
+    void parseParts(Stream *stream);
+    void generateFrame(Stream *stream);
+    void publish(Stream *stream, const QByteArray &jpeg, qint64 timestampMs);
+    void sendLatest(Stream *stream, QTcpSocket *socket);
+
+    QNetworkAccessManager *m_network;
+    QHash<QString, Stream *> m_streams;
+
+    static const int SYNTHETIC_FPS = 15;
+    static const int SYNTHETIC_WIDTH = 640;
+    static const int SYNTHETIC_HEIGHT = 360;
+    static const int RETRY_MS = 2000;
+    static const int IDLE_STOP_MS = 10000;
+    static const int MAX_BUFFER_BYTES = 16 * 1024 * 1024; // Without a parsable frame in it
+};
+
+#endif // STREAMRELAY_H
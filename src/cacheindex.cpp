@@ -0,0 +1,128 @@
+#include "cacheindex.h"
+#include <QtAlgorithms>
+
+CacheIndex::~CacheIndex()
+{
+    clear();
+}
+
+CacheEntry *CacheIndex::find(const QString &key)
+{
+    Node *node = m_nodes.value(key, nullptr);
+    return node ? &node->entry : nullptr;
+}
+
+const CacheEntry *CacheIndex::find(const QString &key) const
+{
+    Node *node = m_nodes.value(key, nullptr);
+    return node ? &node->entry : nullptr;
+}
+
+void CacheIndex::touch(const QString &key, qint64 accessTime)
+{
+    Node *node = m_nodes.value(key, nullptr);
+    if (!node) {
+        return;
+    }
+    node->entry.lastAccess = accessTime;
+    if (node != m_head) {
+        unlink(node);
+        pushFront(node);
+    }
+}
+
+void CacheIndex::insert(const QString &key, const CacheEntry &entry)
+{
+    Node *node = m_nodes.value(key, nullptr);
+    if (node) {
+        m_totalSize -= node->entry.size;
+        unlink(node);
+    } else {
+        node = new Node;
+        node->key = key;
+        m_nodes.insert(key, node);
+    }
+    node->entry = entry;
+    m_totalSize += entry.size;
+    pushFront(node);
+}
+
+bool CacheIndex::remove(const QString &key)
+{
+    Node *node = m_nodes.take(key);
+    if (!node) {
+        return false;
+    }
+    m_totalSize -= node->entry.size;
+    unlink(node);
+    delete node;
+    return true;
+}
+
+void CacheIndex::clear()
+{
+    qDeleteAll(m_nodes);
+    m_nodes.clear();
+    m_head = nullptr;
+    m_tail = nullptr;
+    m_totalSize = 0;
+}
+
+QString CacheIndex::leastRecentKey(const QSet<QString> &skip) const
+{
+    for (Node *node = m_tail; node; node = node->prev) {
+        if (!skip.contains(node->key)) {
+            return node->key;
+        }
+    }
+    return QString();
+}
+
+QList<CacheEntry> CacheIndex::entries() const
+{
+    QList<CacheEntry> result;
+    result.reserve(m_nodes.size());
+    for (Node *node = m_tail; node; node = node->prev) {
+        result.append(node->entry);
+    }
+    return result;
+}
+
+QStringList CacheIndex::keys() const
+{
+    QStringList result;
+    result.reserve(m_nodes.size());
+    for (Node *node = m_tail; node; node = node->prev) {
+        result.append(node->key);
+    }
+    return result;
+}
+
+void CacheIndex::unlink(Node *node)
+{
+    if (node->prev) {
+        node->prev->next = node->next;
+    } else {
+        m_head = node->next;
+    }
+    if (node->next) {
+        node->next->prev = node->prev;
+    } else {
+        m_tail = node->prev;
+    }
+    node->prev = nullptr;
+    node->next = nullptr;
+}
+
+void CacheIndex::pushFront(Node *node)
+{
+    node->prev = nullptr;
+    node->next = m_head;
+    if (m_head) {
+        m_head->prev = node;
+    }
+    m_head = node;
+    if (!m_tail) {
+        m_tail = node;
+    }
+}
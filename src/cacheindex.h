@@ -0,0 +1,74 @@
+#ifndef CACHEINDEX_H
+#define CACHEINDEX_H
+
+#include <QString>
+#include <QHash>
+#include <QList>
+#include <QStringList>
+#include <QSet>
+
+struct CacheEntry {
+    QString url;           // Original URL
+    QString localPath;     // Path to cached file
+    qint64 size;          // File size in bytes
+    qint64 lastAccess;    // Timestamp of last access
+    QString contentHash;   // Hash of the content for change detection
+};
+
+// In-memory index of cached files for MediaCache. Entries live in nodes
+// threaded on an intrusive doubly linked list in recency order and are found
+// through a hash of cache keys, so lookup, touch, insert and eviction are all
+// O(1). The byte total is kept up to date on every change instead of being
+// recomputed.
+class CacheIndex
+{
+public:
+    CacheIndex() = default;
+    ~CacheIndex();
+    CacheIndex(const CacheIndex&) = delete;
+    CacheIndex& operator=(const CacheIndex&) = delete;
+
+    CacheEntry *find(const QString &key);
+    const CacheEntry *find(const QString &key) const;
+    bool contains(const QString &key) const { return m_nodes.contains(key); }
+
+    // Mark an entry as most recently used
+    void touch(const QString &key, qint64 accessTime);
+
+    // Insert (or replace) an entry as the most recently used one
+    void insert(const QString &key, const CacheEntry &entry);
+    bool remove(const QString &key);
+    void clear();
+
+    // Least recently used entry, or nullptr when empty
+    const CacheEntry *leastRecent() const { return m_tail ? &m_tail->entry : nullptr; }
+    QString leastRecentKey() const { return m_tail ? m_tail->key : QString(); }
+    QString leastRecentKey(const QSet<QString> &skip) const; // Oldest not in skip, walking from the tail
+
+    int size() const { return m_nodes.size(); }
+    bool isEmpty() const { return m_nodes.isEmpty(); }
+    qint64 totalSize() const { return m_totalSize; }
+
+    // All entries, least recently used first (re-inserting in this order
+    // restores the same recency order)
+    QList<CacheEntry> entries() const;
+    QStringList keys() const; // Same order as entries()
+
+private:
+    struct Node {
+        QString key;
+        CacheEntry entry;
+        Node *prev = nullptr; // Towards the most recent end
+        Node *next = nullptr; // Towards the least recent end
+    };
+
+    void unlink(Node *node);
+    void pushFront(Node *node);
+
+    QHash<QString, Node*> m_nodes; // Cache key -> node
+    Node *m_head = nullptr; // Most recently used
+    Node *m_tail = nullptr; // Least recently used
+    qint64 m_totalSize = 0;
+};
+
+#endif // CACHEINDEX_H
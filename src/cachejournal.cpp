@@ -0,0 +1,295 @@
+#include "cachejournal.h"
+#include <QDataStream>
+#include <QDebug>
+#include <QtEndian>
+#include <cstdio>
+
+CacheJournal::CacheJournal(QObject *parent)
+    : QObject(parent)
+{
+    m_compactionPool.setMaxThreadCount(1);
+}
+
+CacheJournal::~CacheJournal()
+{
+    close();
+    m_compactionPool.waitForDone();
+}
+
+bool CacheJournal::open(const QString &dir, CacheIndex *index)
+{
+    close();
+    m_path = dir + "/index.journal";
+    m_index = index;
+    m_recordCount = 0;
+
+    bool replayed = false;
+    QFile existing(m_path);
+    if (existing.open(QIODevice::ReadOnly)) {
+        qint64 size = existing.size();
+        uchar *mapped = existing.map(0, size);
+        QByteArray data = mapped ? QByteArray::fromRawData(reinterpret_cast<const char*>(mapped), size)
+                                 : existing.readAll();
+
+        qint64 validLength = 0;
+        replayed = replay(data, &validLength);
+        if (mapped) {
+            existing.unmap(mapped);
+        }
+        existing.close();
+
+        if (!replayed) {
+            qWarning() << "Cache: Journal header invalid, starting a new journal";
+            QFile::remove(m_path);
+        } else if (validLength < size) {
+            // Incomplete or corrupt tail from an interrupted append
+            qWarning() << "Cache: Journal truncated at" << validLength << "of" << size << "bytes";
+            QFile::resize(m_path, validLength);
+        }
+    }
+
+    m_file.setFileName(m_path);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qWarning() << "Cache: Failed to open journal:" << m_file.errorString();
+        return replayed;
+    }
+    if (m_file.size() == 0) {
+        QByteArray header;
+        QDataStream out(&header, QIODevice::WriteOnly);
+        out << MAGIC << VERSION;
+        m_file.write(header);
+        m_file.flush();
+    }
+
+    qDebug() << "Cache: Journal replayed" << m_recordCount << "records," << m_index->size() << "entries";
+    return replayed;
+}
+
+void CacheJournal::close()
+{
+    ++m_generation;
+    m_compacting = false;
+    m_pendingRecords.clear();
+    if (m_file.isOpen()) {
+        m_file.close();
+    }
+}
+
+void CacheJournal::recordInsert(const QString &key, const CacheEntry &entry)
+{
+    append(InsertRecord, encodeInsert(key, entry));
+}
+
+void CacheJournal::recordTouch(const QString &key, qint64 accessTime)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << key << accessTime;
+    append(TouchRecord, payload);
+}
+
+void CacheJournal::recordRemove(const QString &key)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << key;
+    append(RemoveRecord, payload);
+}
+
+void CacheJournal::rewrite()
+{
+    if (!m_index || m_path.isEmpty()) {
+        return;
+    }
+    close();
+
+    QString tempPath = m_path + ".compact";
+    QFile temp(tempPath);
+    QByteArray data = encodeSnapshot(m_index->keys(), m_index->entries());
+    if (temp.open(QIODevice::WriteOnly | QIODevice::Truncate) && temp.write(data) == data.size()) {
+        temp.close();
+        std::rename(QFile::encodeName(tempPath).constData(), QFile::encodeName(m_path).constData());
+    } else {
+        qWarning() << "Cache: Failed to rewrite journal:" << temp.errorString();
+    }
+
+    m_file.setFileName(m_path);
+    m_file.open(QIODevice::WriteOnly | QIODevice::Append);
+    m_recordCount = m_index->size();
+}
+
+void CacheJournal::append(RecordType type, const QByteArray &payload)
+{
+    if (!m_file.isOpen()) {
+        return;
+    }
+
+    QByteArray record = encodeRecord(type, payload);
+    m_file.write(record);
+    m_file.flush(); // Hand it to the OS so a crash of this process can't lose it
+    ++m_recordCount;
+
+    if (m_compacting) {
+        m_pendingRecords.append(record);
+    } else if (m_recordCount > qMax(COMPACT_MIN_RECORDS, COMPACT_RATIO * m_index->size())) {
+        startCompaction();
+    }
+}
+
+bool CacheJournal::replay(const QByteArray &data, qint64 *validLength)
+{
+    *validLength = 0;
+    if (data.size() < HEADER_SIZE) {
+        return data.isEmpty();
+    }
+
+    QDataStream header(data);
+    quint32 magic = 0;
+    quint16 version = 0;
+    header >> magic >> version;
+    if (magic != MAGIC || version != VERSION) {
+        return false;
+    }
+
+    const char *raw = data.constData();
+    qint64 pos = HEADER_SIZE;
+    while (pos + 5 <= data.size()) {
+        quint8 type = static_cast<quint8>(raw[pos]);
+        quint32 length = qFromBigEndian<quint32>(raw + pos + 1);
+        if (pos + 5 + qint64(length) + 2 > data.size()) {
+            break; // Truncated record
+        }
+        quint16 storedCrc = qFromBigEndian<quint16>(raw + pos + 5 + length);
+        if (qChecksum(QByteArrayView(raw + pos, 5 + length)) != storedCrc) {
+            break; // Corrupt record, nothing after it can be trusted
+        }
+
+        QByteArray payload = QByteArray::fromRawData(raw + pos + 5, length);
+        QDataStream in(payload);
+        in.setVersion(QDataStream::Qt_6_0);
+        QString key;
+        in >> key;
+
+        if (type == InsertRecord) {
+            CacheEntry entry;
+            in >> entry.url >> entry.localPath >> entry.size >> entry.lastAccess >> entry.contentHash;
+            m_index->insert(key, entry);
+        } else if (type == TouchRecord) {
+            qint64 accessTime = 0;
+            in >> accessTime;
+            m_index->touch(key, accessTime);
+        } else if (type == RemoveRecord) {
+            m_index->remove(key);
+        }
+
+        pos += 5 + length + 2;
+        ++m_recordCount;
+    }
+
+    *validLength = pos;
+    return true;
+}
+
+void CacheJournal::startCompaction()
+{
+    m_compacting = true;
+    m_pendingRecords.clear();
+
+    // Capture the index now; records appended from here on are kept in
+    // m_pendingRecords and added to the compacted file when it is swapped in
+    QStringList keys = m_index->keys();
+    QList<CacheEntry> entries = m_index->entries();
+    QString tempPath = m_path + ".compact";
+    int generation = m_generation;
+
+    m_compactionPool.start([this, keys, entries, tempPath, generation]() {
+        QByteArray data = encodeSnapshot(keys, entries);
+        QFile temp(tempPath);
+        bool success = temp.open(QIODevice::WriteOnly | QIODevice::Truncate) && temp.write(data) == data.size();
+        temp.close();
+
+        QMetaObject::invokeMethod(this, [this, success, generation]() {
+            if (generation == m_generation) {
+                finishCompaction(success);
+            }
+        }, Qt::QueuedConnection);
+    });
+}
+
+void CacheJournal::finishCompaction(bool success)
+{
+    m_compacting = false;
+    QString tempPath = m_path + ".compact";
+
+    QFile temp(tempPath);
+    if (success && temp.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        for (const QByteArray &record : m_pendingRecords) {
+            temp.write(record);
+        }
+        success = temp.flush();
+        temp.close();
+    } else {
+        success = false;
+    }
+
+    if (!success) {
+        qWarning() << "Cache: Journal compaction failed, keeping the full log";
+        QFile::remove(tempPath);
+        m_pendingRecords.clear();
+        return;
+    }
+
+    // rename() replaces the old journal atomically (QFile::rename won't overwrite)
+    m_file.close();
+    if (std::rename(QFile::encodeName(tempPath).constData(), QFile::encodeName(m_path).constData()) != 0) {
+        qWarning() << "Cache: Failed to swap in compacted journal";
+        QFile::remove(tempPath);
+    } else {
+        qDebug() << "Cache: Journal compacted from" << m_recordCount << "to"
+                 << m_index->size() << "records";
+        m_recordCount = m_index->size();
+    }
+    m_pendingRecords.clear();
+    m_file.open(QIODevice::WriteOnly | QIODevice::Append);
+}
+
+QByteArray CacheJournal::encodeRecord(RecordType type, const QByteArray &payload)
+{
+    QByteArray record;
+    record.reserve(5 + payload.size() + 2);
+    record.append(static_cast<char>(type));
+
+    char length[4];
+    qToBigEndian<quint32>(payload.size(), length);
+    record.append(length, 4);
+    record.append(payload);
+
+    char crc[2];
+    qToBigEndian<quint16>(qChecksum(QByteArrayView(record)), crc);
+    record.append(crc, 2);
+    return record;
+}
+
+QByteArray CacheJournal::encodeInsert(const QString &key, const CacheEntry &entry)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << key << entry.url << entry.localPath << entry.size << entry.lastAccess << entry.contentHash;
+    return payload;
+}
+
+QByteArray CacheJournal::encodeSnapshot(const QStringList &keys, const QList<CacheEntry> &entries)
+{
+    QByteArray data;
+    QDataStream header(&data, QIODevice::WriteOnly);
+    header << MAGIC << VERSION;
+
+    // Least recently used first, so replaying restores the LRU order
+    for (int i = 0; i < entries.size(); ++i) {
+        data.append(encodeRecord(InsertRecord, encodeInsert(keys.at(i), entries.at(i))));
+    }
+    return data;
+}
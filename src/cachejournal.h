@@ -0,0 +1,76 @@
+#ifndef CACHEJOURNAL_H
+#define CACHEJOURNAL_H
+
+#include <QObject>
+#include <QFile>
+#include <QList>
+#include <QStringList>
+#include <QThreadPool>
+#include <QByteArray>
+#include "cacheindex.h"
+
+// Persistent form of the media cache index: an append-only binary log of
+// insert/touch/remove records. Each change costs one small append instead
+// of rewriting the whole index. On open the log is replayed into a
+// CacheIndex; a torn or corrupt tail (power loss mid-append) is detected by
+// the per-record checksum and cut off. When the log grows well past the
+// number of live entries it is compacted in the background into one insert
+// record per entry.
+//
+// File layout: "VTCJ" magic, quint16 version, then records of
+//   quint8 type | quint32 payload length | payload | quint16 CRC-16 (ISO 3309)
+class CacheJournal : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit CacheJournal(QObject *parent = nullptr);
+    ~CacheJournal();
+
+    // Replay the journal in dir into index and open it for appending.
+    // Returns false if there was no journal yet (index is left untouched).
+    bool open(const QString &dir, CacheIndex *index);
+    void close();
+    bool isOpen() const { return m_file.isOpen(); }
+
+    void recordInsert(const QString &key, const CacheEntry &entry);
+    void recordTouch(const QString &key, qint64 accessTime);
+    void recordRemove(const QString &key);
+
+    // Replace the journal with the current index contents (e.g. after a
+    // migration or clear()); synchronous
+    void rewrite();
+
+private:
+    enum RecordType : quint8 {
+        InsertRecord = 1,
+        TouchRecord = 2,
+        RemoveRecord = 3
+    };
+
+    void append(RecordType type, const QByteArray &payload);
+    bool replay(const QByteArray &data, qint64 *validLength);
+    void startCompaction();
+    void finishCompaction(bool success);
+
+    static QByteArray encodeRecord(RecordType type, const QByteArray &payload);
+    static QByteArray encodeInsert(const QString &key, const CacheEntry &entry);
+    static QByteArray encodeSnapshot(const QStringList &keys, const QList<CacheEntry> &entries);
+
+    static const quint32 MAGIC = 0x5654434A; // "VTCJ"
+    static const quint16 VERSION = 1;
+    static const int HEADER_SIZE = 6;
+    static constexpr int COMPACT_MIN_RECORDS = 1024; // Never compact logs shorter than this
+    static constexpr int COMPACT_RATIO = 4;          // Compact once records exceed live entries by this factor
+
+    QFile m_file;
+    QString m_path;
+    CacheIndex *m_index = nullptr;
+    int m_recordCount = 0;            // Records in the file since the last compaction
+    bool m_compacting = false;
+    int m_generation = 0;             // Bumped by rewrite()/close() to drop stale compactions
+    QThreadPool m_compactionPool;     // Single background thread for compaction writes
+    QList<QByteArray> m_pendingRecords; // Appended while a compaction was running
+};
+
+#endif // CACHEJOURNAL_H
@@ -0,0 +1,993 @@
+#include "cacheworker.h"
+#include "cachejournal.h"
+#include "mediacache.h"
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+#include <QNetworkReply>
+#include <QUrl>
+#include <QTimer>
+#include <algorithm>
+
+CacheWorker::CacheWorker(QObject *parent)
+    : QObject(parent)
+    , m_journal(new CacheJournal(this))
+    , m_maxSize(4LL * 1024 * 1024 * 1024) // Default 4GB
+    , m_pressureTimer(new QTimer(this))
+    , m_statsTimer(new QTimer(this))
+    , m_publishTimer(new QTimer(this))
+    , m_verifyTimer(new QTimer(this))
+    , m_verifyHash(QCryptographicHash::Sha256)
+{
+    m_pressureTimer->setInterval(PRESSURE_CHECK_MS);
+    connect(m_pressureTimer, &QTimer::timeout, this, &CacheWorker::checkMemoryPressure);
+    m_statsTimer->setSingleShot(true);
+    m_statsTimer->setInterval(STATS_INTERVAL_MS);
+    connect(m_statsTimer, &QTimer::timeout, this, &CacheWorker::publishEvictionStats);
+    m_publishTimer->setSingleShot(true);
+    m_publishTimer->setInterval(0);
+    connect(m_publishTimer, &QTimer::timeout, this, &CacheWorker::flushView);
+    m_verifyTimer->setSingleShot(true);
+    connect(m_verifyTimer, &QTimer::timeout, this, &CacheWorker::verifyStep);
+
+    resetPolicy(EvictionPolicy::PlaylistMode);
+    const EvictionPolicy::Mode modes[] = { EvictionPolicy::LruMode, EvictionPolicy::GdsfMode,
+                                           EvictionPolicy::PlaylistMode };
+    for (EvictionPolicy::Mode mode : modes) {
+        ShadowCache *shadow = new ShadowCache(mode);
+        shadow->setCapacity(m_maxSize);
+        m_shadows.append(shadow);
+    }
+}
+
+CacheWorker::~CacheWorker()
+{
+    // Partial files of unfinished prefetches are kept for resuming next time
+    const QStringList pending = m_downloads.keys();
+    for (const QString &key : pending) {
+        discardDownload(key, false);
+    }
+    delete m_verifyFile;
+    delete m_policy;
+    qDeleteAll(m_shadows);
+}
+
+void CacheWorker::setCacheDir(const QString &path)
+{
+    m_cacheDir = path;
+    finishVerifyFile();
+    m_verifyQueue.clear();
+    m_verifyPassRunning = false;
+    m_ramTier.clear();
+    ensureCacheDir();
+    loadCacheIndex();
+    resetPolicy(m_policy->mode());
+    publishView();
+    flushView(); // Right away: MediaCache relies on it before the worker starts
+    const QSet<QString> requested = m_verifyRequested;
+    for (const QString &key : requested) {
+        answerVerify(key, false); // Asked of the previous directory
+    }
+}
+
+void CacheWorker::setMaxSize(qint64 sizeInBytes)
+{
+    m_maxSize = sizeInBytes;
+    for (ShadowCache *shadow : m_shadows) {
+        shadow->setCapacity(sizeInBytes);
+    }
+
+    // Evict items if we're now over the limit
+    if (m_index.totalSize() > m_maxSize) {
+        while (m_index.totalSize() > m_maxSize && evictVictim()) {
+        }
+        publishView();
+    }
+}
+
+void CacheWorker::setRamBudget(qint64 sizeInBytes)
+{
+    if (m_ramTier.setBudget(sizeInBytes) && m_ramTier.isEnabled()) {
+        m_pressureTimer->start();
+        qDebug() << "Cache: RAM tier of" << sizeInBytes << "bytes";
+    } else {
+        m_pressureTimer->stop();
+    }
+    publishView();
+}
+
+void CacheWorker::checkMemoryPressure()
+{
+    qint64 available = MemoryTier::availableMemory();
+    if (available < 0 || available >= MemoryTier::lowMemoryThreshold()) {
+        return;
+    }
+    qint64 freed = m_ramTier.relieve(MemoryTier::lowMemoryThreshold() - available);
+    if (freed > 0) {
+        qWarning() << "Cache: Low memory (" << available << "bytes available), demoted"
+                   << freed << "bytes from the RAM tier";
+        publishView();
+    }
+}
+
+void CacheWorker::storeFile(const QString &url, const QString &key, const QByteArray &data)
+{
+    QString hash = QString::fromLatin1(QCryptographicHash::hash(data, QCryptographicHash::Sha256).toHex());
+
+    // Check if we already have this exact content cached
+    if (const CacheEntry *existing = m_index.find(key)) {
+        if (existing->contentHash == hash && QFile::exists(existing->localPath)) {
+            // Same content, just update access time
+            touch(key, QDateTime::currentMSecsSinceEpoch());
+            qDebug() << "Cache: Content unchanged for" << url;
+            emit cacheUpdated();
+            return;
+        } else {
+            // Content changed or file missing, remove old entry
+            QFile::remove(existing->localPath);
+            m_ramTier.demote(key);
+            m_index.remove(key);
+            m_journal->recordRemove(key);
+            m_policy->onRemove(key);
+        }
+    }
+
+    // Save the file
+    qint64 dataSize = data.size();
+    QString localPath = m_cacheDir + "/" + key;
+    QFile file(localPath);
+    if (file.open(QIODevice::WriteOnly)) {
+        file.write(data);
+        file.close();
+
+        // Add to cache
+        CacheEntry entry;
+        entry.url = url;
+        entry.localPath = localPath;
+        entry.size = dataSize;
+        entry.lastAccess = QDateTime::currentMSecsSinceEpoch();
+        entry.contentHash = hash;
+        insertEntry(key, entry);
+
+        qDebug() << "Cache: Stored" << url << "(" << dataSize << "bytes )";
+    } else {
+        qWarning() << "Cache: Failed to write file:" << localPath;
+        publishView(); // The old entry may have been dropped
+    }
+}
+
+void CacheWorker::insertEntry(const QString &key, const CacheEntry &entry)
+{
+    // Evict items if needed to make room. Pinned entries stay even if that
+    // takes the cache over its limit: they are needed at a fixed time.
+    while (m_index.totalSize() + entry.size > m_maxSize) {
+        if (!evictVictim()) {
+            qWarning() << "Cache: Over the size limit, remaining entries are pinned";
+            break;
+        }
+    }
+
+    m_index.insert(key, entry);
+    m_journal->recordInsert(key, entry);
+    m_policy->onInsert(key, entry.size);
+    m_knownSizes.insert(key, entry.size);
+    if (m_unsizedMisses.remove(key)) {
+        countAccess(key, false, entry.size);
+    }
+    publishView();
+    emit cacheUpdated();
+}
+
+void CacheWorker::publishView()
+{
+    // Building a view copies the whole index, so every change made in one
+    // pass of the event loop (an eviction run, the insert it made room for,
+    // a RAM tier promotion) goes out as one view
+    m_viewDirty = true;
+    if (!m_publishTimer->isActive()) {
+        m_publishTimer->start();
+    }
+}
+
+void CacheWorker::flushView()
+{
+    if (!m_viewDirty) {
+        return;
+    }
+    m_viewDirty = false;
+    m_publishTimer->stop();
+
+    // Build a fresh view; the GUI thread keeps reading the previous one
+    // until it picks this up, so nothing is ever shared mutably
+    QSharedPointer<CacheView> view(new CacheView);
+    const QStringList keys = m_index.keys();
+    view->paths.reserve(keys.size());
+    view->hashes.reserve(keys.size());
+    for (const QString &key : keys) {
+        const CacheEntry *entry = m_index.find(key);
+        view->paths.insert(key, entry->localPath);
+        view->hashes.insert(key, entry->contentHash);
+    }
+    view->totalSize = m_index.totalSize();
+    view->itemCount = m_index.size();
+    const QStringList ramKeys = m_ramTier.index().keys();
+    for (const QString &key : ramKeys) {
+        view->ramPaths.insert(key, m_ramTier.index().find(key)->localPath);
+    }
+    view->ramSize = m_ramTier.index().totalSize();
+    view->ramCount = m_ramTier.index().size();
+    view->ramBudget = m_ramTier.isEnabled() ? m_ramTier.budget() : 0;
+    view->quarantinedCount = m_quarantinedCount;
+    for (const QString &key : m_pinned) {
+        if (const CacheEntry *entry = m_index.find(key)) {
+            view->pinnedSize += entry->size;
+            view->pinnedCount++;
+        }
+    }
+    emit viewChanged(view);
+}
+
+void CacheWorker::prefetch(const QString &url, const QString &key)
+{
+    if (const CacheEntry *entry = m_index.find(key)) {
+        if (QFile::exists(entry->localPath)) {
+            qDebug() << "Cache: Already cached, skipping prefetch";
+            flushView();
+            emit prefetchComplete(url, true);
+            return;
+        }
+        remove(key);
+    }
+
+    if (m_downloads.contains(key)) {
+        qDebug() << "Cache: Download already in progress, skipping prefetch";
+        return;
+    }
+
+    // Stream to a partial file so memory use doesn't grow with the file size
+    PendingDownload download;
+    download.url = url;
+    download.file = new QFile(partialPath(key));
+    if (!download.file->open(QIODevice::ReadWrite)) {
+        qWarning() << "Cache: Failed to open partial file:" << download.file->fileName();
+        delete download.file;
+        flushView();
+        emit prefetchComplete(url, false);
+        return;
+    }
+    download.hash = new QCryptographicHash(QCryptographicHash::Sha256);
+
+    QNetworkRequest request{QUrl(url)};
+    request.setRawHeader("User-Agent", "VideoTimeline Client Cache");
+
+    // Resume an interrupted download if we know which version of the file it was
+    QFile validatorFile(validatorPath(key));
+    QByteArray validator;
+    if (validatorFile.open(QIODevice::ReadOnly)) {
+        validator = validatorFile.readAll().trimmed();
+    }
+    if (download.file->size() > 0 && !validator.isEmpty()) {
+        // What is already on disk is hashed a chunk at a time alongside
+        // the transfer (hashPartialStep()), not read back in one go here
+        download.resumeOffset = download.file->size();
+        download.file->seek(download.resumeOffset);
+        request.setRawHeader("Range", "bytes=" + QByteArray::number(download.resumeOffset) + "-");
+        request.setRawHeader("If-Range", validator); // Server sends the whole file if it changed
+        qDebug() << "Cache: Resuming" << url << "at" << download.resumeOffset << "bytes";
+    } else {
+        download.file->resize(0);
+    }
+
+    download.timer.start();
+    m_downloads.insert(key, download);
+    if (download.resumeOffset > 0) {
+        QMetaObject::invokeMethod(this, [this, key]() { hashPartialStep(key); }, Qt::QueuedConnection);
+    }
+
+    QNetworkReply *reply = networkManager()->get(request);
+    reply->setReadBufferSize(DOWNLOAD_BUFFER_SIZE);
+    reply->setProperty("prefetch_url", url);
+    reply->setProperty("cache_key", key);
+    connect(reply, &QNetworkReply::metaDataChanged, this, &CacheWorker::onPrefetchMetaDataChanged);
+    connect(reply, &QNetworkReply::readyRead, this, &CacheWorker::onPrefetchReadyRead);
+    connect(reply, &QNetworkReply::finished, this, &CacheWorker::onPrefetchFinished);
+}
+
+void CacheWorker::probeSize(const QString &url)
+{
+    QNetworkRequest request{QUrl(url)};
+    request.setRawHeader("User-Agent", "VideoTimeline Client Cache");
+    QNetworkReply *reply = networkManager()->head(request);
+    connect(reply, &QNetworkReply::finished, this, [this, reply, url]() {
+        qint64 size = -1;
+        if (reply->error() == QNetworkReply::NoError) {
+            QVariant length = reply->header(QNetworkRequest::ContentLengthHeader);
+            if (length.isValid()) {
+                size = length.toLongLong();
+            }
+        }
+        emit sizeProbed(url, size);
+        reply->deleteLater();
+    });
+}
+
+QNetworkAccessManager *CacheWorker::networkManager()
+{
+    // Created on first use rather than in the constructor so it belongs to
+    // the I/O thread. Connections to the server are kept alive and reused.
+    if (!m_networkManager) {
+        m_networkManager = new QNetworkAccessManager(this);
+    }
+    return m_networkManager;
+}
+
+void CacheWorker::hashPartialStep(const QString &key)
+{
+    auto it = m_downloads.find(key);
+    if (it == m_downloads.end()) {
+        return; // Finished or discarded meanwhile
+    }
+    PendingDownload &download = it.value();
+
+    // Read back one chunk of what is on disk but not hashed yet; once this
+    // catches up, onPrefetchReadyRead() hashes new data as it arrives
+    qint64 end = download.file->size();
+    if (!download.hashFailed && download.hashed < end) {
+        qint64 writePosition = download.file->pos();
+        download.file->seek(download.hashed);
+        QByteArray chunk = download.file->read(qMin(HASH_CHUNK_SIZE, end - download.hashed));
+        download.file->seek(writePosition);
+        if (chunk.isEmpty()) {
+            qWarning() << "Cache: Failed to read back partial file:" << download.file->fileName();
+            download.hashFailed = true;
+        } else {
+            download.hash->addData(chunk);
+            download.hashed += chunk.size();
+        }
+    }
+
+    if (!download.hashFailed && download.hashed < end) {
+        QMetaObject::invokeMethod(this, [this, key]() { hashPartialStep(key); }, Qt::QueuedConnection);
+    } else if (download.finished) {
+        completeDownload(key);
+    }
+}
+
+void CacheWorker::discardDownload(const QString &key, bool removePartial)
+{
+    PendingDownload download = m_downloads.take(key);
+    if (download.file) {
+        download.file->close();
+        if (removePartial) {
+            download.file->remove();
+            QFile::remove(validatorPath(key));
+        }
+    }
+    delete download.file;
+    delete download.hash;
+}
+
+void CacheWorker::touch(const QString &key, qint64 accessTime)
+{
+    // Recency only: the published view doesn't change
+    if (const CacheEntry *entry = m_index.find(key)) {
+        m_policy->onAccess(key, entry->size);
+        m_index.touch(key, accessTime);
+        m_journal->recordTouch(key, accessTime);
+    }
+}
+
+void CacheWorker::recordAccess(const QString &key, qint64 accessTime)
+{
+    if (const CacheEntry *entry = m_index.find(key)) {
+        qint64 size = entry->size;
+        QString localPath = entry->localPath;
+        touch(key, accessTime);
+        countAccess(key, true, size);
+
+        // A hit on playlist content is a candidate for the RAM tier
+        if (m_ramTier.contains(key)) {
+            m_ramTier.touch(key, accessTime);
+        } else if (m_ramTier.isEnabled() && m_ramTier.promote(key, localPath, size)) {
+            publishView();
+        }
+    } else if (m_knownSizes.contains(key)) {
+        countAccess(key, false, m_knownSizes.value(key));
+    } else {
+        m_unsizedMisses.insert(key); // Counted once it has been downloaded
+    }
+}
+
+void CacheWorker::countAccess(const QString &key, bool hit, qint64 size)
+{
+    if (hit) {
+        m_counters.hits++;
+        m_counters.byteHits += size;
+    } else {
+        m_counters.misses++;
+        m_counters.byteMisses += size;
+    }
+
+    for (ShadowCache *shadow : m_shadows) {
+        shadow->access(key, size);
+    }
+
+    // Lookups come in bursts while the playlist is prefetched: send the
+    // counters at most once per STATS_INTERVAL_MS
+    if (!m_statsTimer->isActive()) {
+        m_statsTimer->start();
+    }
+}
+
+void CacheWorker::publishEvictionStats()
+{
+    EvictionStats stats;
+    for (ShadowCache *shadow : m_shadows) {
+        stats.shadows.append(shadow->counters());
+    }
+    stats.actual = m_counters;
+    emit evictionStatsChanged(stats);
+}
+
+void CacheWorker::remove(const QString &key)
+{
+    m_ramTier.demote(key);
+    if (m_index.remove(key)) {
+        m_journal->recordRemove(key);
+        m_policy->onRemove(key);
+        publishView();
+    }
+}
+
+void CacheWorker::setEvictionPolicy(int mode)
+{
+    resetPolicy(static_cast<EvictionPolicy::Mode>(mode));
+    qDebug() << "Cache: Eviction policy" << m_counters.policy;
+}
+
+void CacheWorker::resetPolicy(EvictionPolicy::Mode mode)
+{
+    // Replay the index into a fresh policy, oldest first
+    delete m_policy;
+    m_policy = EvictionPolicy::create(mode);
+    m_policy->setPlaylist(m_playlistKeys);
+    m_policy->setPlaylistPosition(m_playlistPosition);
+    const QStringList keys = m_index.keys();
+    for (const QString &key : keys) {
+        qint64 size = m_index.find(key)->size;
+        m_policy->onInsert(key, size);
+        m_knownSizes.insert(key, size);
+    }
+    m_counters.policy = EvictionPolicy::modeName(mode);
+}
+
+void CacheWorker::setPlaylist(const QStringList &keys)
+{
+    m_playlistKeys = keys;
+    m_playlistPosition = 0;
+    m_policy->setPlaylist(keys);
+
+    QHash<QString, int> recurrence;
+    for (const QString &key : keys) {
+        if (!key.isEmpty()) {
+            recurrence[key]++;
+        }
+    }
+    int ramCount = m_ramTier.index().size();
+    m_ramTier.setRecurrence(recurrence);
+    if (m_ramTier.index().size() != ramCount) {
+        publishView();
+    }
+
+    for (ShadowCache *shadow : m_shadows) {
+        shadow->setPlaylist(keys);
+    }
+
+    // Sizes are only needed for keys that can still be looked up; forget
+    // the ones that left both the playlist and the cache
+    const QSet<QString> playlist(keys.constBegin(), keys.constEnd());
+    for (auto it = m_knownSizes.begin(); it != m_knownSizes.end();) {
+        if (playlist.contains(it.key()) || m_index.contains(it.key()) || m_downloads.contains(it.key())) {
+            ++it;
+        } else {
+            it = m_knownSizes.erase(it);
+        }
+    }
+    for (auto it = m_unsizedMisses.begin(); it != m_unsizedMisses.end();) {
+        if (playlist.contains(*it) || m_downloads.contains(*it)) {
+            ++it;
+        } else {
+            it = m_unsizedMisses.erase(it);
+        }
+    }
+}
+
+void CacheWorker::setPlaylistPosition(int index)
+{
+    m_playlistPosition = index;
+    m_policy->setPlaylistPosition(index);
+    for (ShadowCache *shadow : m_shadows) {
+        shadow->setPlaylistPosition(index);
+    }
+}
+
+void CacheWorker::setPinSet(const QString &name, const QStringList &keys)
+{
+    QSet<QString> &set = m_pinSets[name];
+    set.clear();
+    for (const QString &key : keys) {
+        set.insert(key);
+    }
+    rebuildPinned();
+    qDebug() << "Cache: Pinned" << set.size() << "entries as" << name;
+}
+
+void CacheWorker::removePinSet(const QString &name)
+{
+    if (m_pinSets.remove(name) > 0) {
+        rebuildPinned();
+        qDebug() << "Cache: Unpinned" << name;
+    }
+}
+
+void CacheWorker::rebuildPinned()
+{
+    m_pinned.clear();
+    const QList<QSet<QString>> sets = m_pinSets.values();
+    for (const QSet<QString> &set : sets) {
+        m_pinned.unite(set);
+    }
+    publishView();
+}
+
+void CacheWorker::verify(const QString &key)
+{
+    if (!m_index.contains(key) || !checkSize(key)) {
+        flushView();
+        emit verified(key, false);
+        return;
+    }
+    if (m_index.find(key)->contentHash.isEmpty()) {
+        emit verified(key, true); // Nothing to compare with
+        return;
+    }
+
+    // Hashed by the verifier a chunk at a time, ahead of the rest of its
+    // pass, so a large file doesn't hold up the thread; answered when done
+    m_verifyRequested.insert(key);
+    if (m_verifyKey == key) {
+        return;
+    }
+    if (!m_verifyPassRunning) {
+        m_verifyQueue = m_index.keys();
+        m_verifyPassRunning = true;
+    }
+    m_verifyQueue.removeAll(key);
+    m_verifyQueue.prepend(key);
+    if (!m_verifyFile) {
+        m_verifyTimer->start(0);
+    }
+}
+
+void CacheWorker::startVerifier()
+{
+    m_verifyTimer->start(VERIFY_FIRST_PASS_MS);
+}
+
+void CacheWorker::verifyStep()
+{
+    if (!m_verifyPassRunning) {
+        m_verifyQueue = m_index.keys();
+        m_verifyPassRunning = true;
+    }
+
+    if (!m_verifyFile) {
+        // Start on the next entry whose size checks out
+        while (!m_verifyFile && !m_verifyQueue.isEmpty()) {
+            QString key = m_verifyQueue.takeFirst();
+            if (!m_index.contains(key)) {
+                answerVerify(key, false);
+                continue;
+            }
+            if (!checkSize(key)) {
+                continue;
+            }
+            const CacheEntry *entry = m_index.find(key);
+            if (entry->contentHash.isEmpty()) {
+                answerVerify(key, true); // Nothing to compare with
+                continue;
+            }
+            m_verifyFile = new QFile(entry->localPath);
+            if (!m_verifyFile->open(QIODevice::ReadOnly)) {
+                finishVerifyFile();
+                quarantine(key, "unreadable");
+                continue;
+            }
+            m_verifyKey = key;
+            m_verifyExpected = entry->contentHash;
+            m_verifyHash.reset();
+        }
+
+        if (!m_verifyFile) {
+            qDebug() << "Cache: Verification pass complete";
+            m_verifyPassRunning = false;
+            m_verifyTimer->start(VERIFY_PASS_INTERVAL_MS);
+            return;
+        }
+    }
+
+    m_verifyHash.addData(m_verifyFile->read(HASH_CHUNK_SIZE));
+    if (m_verifyFile->atEnd()) {
+        QString key = m_verifyKey;
+        bool ok = QString::fromLatin1(m_verifyHash.result().toHex()) == m_verifyExpected;
+        finishVerifyFile();
+
+        // The entry may have been replaced or dropped while it was being read
+        const CacheEntry *entry = m_index.find(key);
+        bool current = entry && entry->contentHash == m_verifyExpected;
+        if (!ok && current) {
+            quarantine(key, "content hash mismatch");
+        }
+        answerVerify(key, ok && current);
+    }
+    m_verifyTimer->start(VERIFY_STEP_MS);
+}
+
+void CacheWorker::finishVerifyFile()
+{
+    delete m_verifyFile;
+    m_verifyFile = nullptr;
+    m_verifyKey.clear();
+}
+
+void CacheWorker::answerVerify(const QString &key, bool ok)
+{
+    if (m_verifyRequested.remove(key)) {
+        flushView();
+        emit verified(key, ok);
+    }
+}
+
+bool CacheWorker::checkSize(const QString &key)
+{
+    const CacheEntry *entry = m_index.find(key);
+    QFileInfo info(entry->localPath);
+    if (!info.exists()) {
+        quarantine(key, "file missing");
+        return false;
+    }
+    if (info.size() != entry->size) {
+        quarantine(key, QString("size %1, expected %2").arg(info.size()).arg(entry->size));
+        return false;
+    }
+
+    // The RAM tier is a copy of a good file; if it went away, serve from disk
+    if (m_ramTier.contains(key) && !QFile::exists(m_ramTier.index().find(key)->localPath)) {
+        m_ramTier.demote(key);
+        publishView();
+    }
+    return true;
+}
+
+void CacheWorker::quarantine(const QString &key, const QString &reason)
+{
+    const CacheEntry *entry = m_index.find(key);
+    if (!entry) {
+        return;
+    }
+    QString url = entry->url;
+    QString localPath = entry->localPath;
+    qWarning() << "Cache: Quarantined" << url << "-" << reason;
+
+    // Keep the newest few bad files to look at, outside the cache budget
+    if (QFile::exists(localPath)) {
+        QDir dir(quarantineDir());
+        if (dir.exists() || dir.mkpath(".")) {
+            QString target = dir.filePath(key);
+            QFile::remove(target);
+            if (QFile::rename(localPath, target)) {
+                const QFileInfoList files = dir.entryInfoList(QDir::Files, QDir::Time);
+                for (int i = QUARANTINE_KEEP; i < files.size(); ++i) {
+                    QFile::remove(files.at(i).absoluteFilePath());
+                }
+            }
+        }
+        QFile::remove(localPath);
+    }
+
+    if (m_verifyKey == key) {
+        finishVerifyFile();
+    }
+    m_ramTier.demote(key);
+    m_index.remove(key);
+    m_journal->recordRemove(key);
+    m_policy->onRemove(key);
+    m_quarantinedCount++;
+    publishView();
+    emit cacheUpdated();
+    flushView();
+    emit quarantined(url, key);
+    answerVerify(key, false);
+}
+
+void CacheWorker::clear()
+{
+    // Delete all cached files
+    const QList<CacheEntry> entries = m_index.entries();
+    for (const CacheEntry &entry : entries) {
+        QFile::remove(entry.localPath);
+    }
+
+    m_index.clear();
+    m_ramTier.clear();
+    m_journal->rewrite();
+    m_policy->clear();
+    QString policy = m_counters.policy;
+    m_counters = PolicyCounters();
+    m_counters.policy = policy;
+    for (ShadowCache *shadow : m_shadows) {
+        shadow->clear();
+    }
+    m_statsTimer->start();
+    m_unsizedMisses.clear();
+    publishView();
+    emit cacheUpdated();
+
+    qDebug() << "Cache: Cleared all entries";
+}
+
+void CacheWorker::evict()
+{
+    if (evictVictim()) {
+        publishView();
+    }
+}
+
+bool CacheWorker::evictVictim()
+{
+    if (m_index.isEmpty()) {
+        return false;
+    }
+
+    QString key = m_policy->victim(m_index, m_pinned);
+    if (key.isEmpty()) {
+        return false;
+    }
+    CacheEntry entry = *m_index.find(key);
+    QFile::remove(entry.localPath);
+    m_ramTier.demote(key);
+    m_index.remove(key);
+    m_journal->recordRemove(key);
+    m_policy->onRemove(key);
+
+    qDebug() << "Cache: Evicted" << entry.url << "(" << entry.size << "bytes) by"
+             << EvictionPolicy::modeName(m_policy->mode()) << "policy";
+
+    emit cacheUpdated();
+    return true;
+}
+
+void CacheWorker::onPrefetchMetaDataChanged()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+    if (!reply) return;
+
+    QString key = reply->property("cache_key").toString();
+    auto it = m_downloads.find(key);
+    if (it == m_downloads.end()) return;
+    PendingDownload &download = it.value();
+
+    int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (status == 200 && download.resumeOffset > 0) {
+        // Server sent the whole file (it changed, or doesn't do ranges): start over
+        qDebug() << "Cache: Server restarted download of" << download.url;
+        download.file->resize(0);
+        download.file->seek(0);
+        download.hash->reset();
+        download.hashed = 0;
+        download.hashFailed = false;
+        download.resumeOffset = 0;
+    } else if (status == 206) {
+        download.file->seek(download.resumeOffset);
+    }
+
+    // Remember which version of the file the partial data belongs to
+    QByteArray etag = reply->rawHeader("ETag");
+    if (!etag.isEmpty() && (status == 200 || status == 206)) {
+        QFile validatorFile(validatorPath(key));
+        if (validatorFile.open(QIODevice::WriteOnly)) {
+            validatorFile.write(etag);
+        }
+    }
+}
+
+void CacheWorker::onPrefetchReadyRead()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+    if (!reply) return;
+
+    auto it = m_downloads.find(reply->property("cache_key").toString());
+    if (it == m_downloads.end()) return;
+
+    int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (status != 200 && status != 206) {
+        return; // Error body, not file content
+    }
+
+    PendingDownload &download = it.value();
+    QByteArray chunk = reply->readAll();
+    qint64 writePosition = download.file->pos();
+    if (download.file->write(chunk) != chunk.size()) {
+        qWarning() << "Cache: Failed to write partial file:" << download.file->fileName();
+        reply->abort();
+        return;
+    }
+    // Straight into the hash unless it is still catching up on a resume
+    if (download.hashed == writePosition) {
+        download.hash->addData(chunk);
+        download.hashed += chunk.size();
+    }
+    download.bytesReceived += chunk.size();
+}
+
+void CacheWorker::onPrefetchFinished()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+    if (!reply) return;
+
+    QString url = reply->property("prefetch_url").toString();
+    QString key = reply->property("cache_key").toString();
+
+    if (!m_downloads.contains(key)) {
+        reply->deleteLater();
+        return;
+    }
+
+    if (reply->error() == QNetworkReply::NoError) {
+        onPrefetchReadyRead(); // Drain anything still buffered
+        reply->deleteLater();
+
+        PendingDownload &download = m_downloads[key];
+        download.file->flush();
+        download.finished = true;
+        if (!download.hashFailed && download.hashed < download.file->size()) {
+            return; // Completed by hashPartialStep() once the hash has caught up
+        }
+        completeDownload(key);
+        return;
+    }
+
+    // Keep the partial file so the next prefetch can resume, unless the
+    // server says our range no longer makes sense
+    int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    qWarning() << "Cache: Prefetch failed for" << url << ":" << reply->errorString();
+    discardDownload(key, status == 416);
+    flushView();
+    emit prefetchComplete(url, false);
+    reply->deleteLater();
+}
+
+void CacheWorker::completeDownload(const QString &key)
+{
+    PendingDownload &download = m_downloads[key];
+    QString url = download.url;
+    bool success = false;
+
+    if (download.hashFailed) {
+        // The hash would be wrong; start over next time
+        discardDownload(key, true);
+        flushView();
+        emit prefetchComplete(url, false);
+        return;
+    }
+
+    qint64 size = download.file->size();
+    QString contentHash = QString::fromLatin1(download.hash->result().toHex());
+    download.file->close();
+
+    // Move the finished file into place in one step, so a half-written
+    // file is never visible under its cache name
+    QString localPath = m_cacheDir + "/" + key;
+    QFile::remove(localPath);
+    if (download.file->rename(localPath)) {
+        QFile::remove(validatorPath(key));
+
+        CacheEntry entry;
+        entry.url = url;
+        entry.localPath = localPath;
+        entry.size = size;
+        entry.lastAccess = QDateTime::currentMSecsSinceEpoch();
+        entry.contentHash = contentHash;
+        insertEntry(key, entry);
+
+        success = true;
+        qDebug() << "Cache: Prefetch complete for" << url << "(" << size << "bytes )";
+        emit transferMeasured(url, download.bytesReceived, download.timer.elapsed());
+    } else {
+        qWarning() << "Cache: Failed to move downloaded file into place:" << localPath;
+    }
+    discardDownload(key, !success);
+    // MediaCache answers fetches from the view, so it must have the new
+    // entry by the time this arrives
+    flushView();
+    emit prefetchComplete(url, success);
+}
+
+void CacheWorker::loadCacheIndex()
+{
+    // Replay the journal. Entries are trusted without a stat() each; the
+    // background verifier drops any whose file has gone missing
+    m_index.clear();
+    if (m_journal->open(m_cacheDir, &m_index)) {
+        qDebug() << "Cache: Loaded" << m_index.size() << "entries from journal";
+        return;
+    }
+
+    // No journal yet: migrate the JSON index written by older versions
+    QString indexPath = m_cacheDir + "/index.json";
+    QFile file(indexPath);
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        qDebug() << "Cache: No index file found, starting fresh";
+        return;
+    }
+
+    QByteArray data = file.readAll();
+    file.close();
+
+    QJsonDocument doc = QJsonDocument::fromJson(data);
+    if (!doc.isObject()) {
+        qWarning() << "Cache: Invalid index file format";
+        return;
+    }
+
+    QJsonObject root = doc.object();
+    QJsonArray entries = root["entries"].toArray();
+
+    QList<CacheEntry> loaded;
+    for (const QJsonValue &value : entries) {
+        QJsonObject obj = value.toObject();
+
+        CacheEntry entry;
+        entry.url = obj["url"].toString();
+        entry.localPath = obj["localPath"].toString();
+        entry.size = obj["size"].toVariant().toLongLong();
+        entry.lastAccess = obj["lastAccess"].toVariant().toLongLong();
+        entry.contentHash = obj["contentHash"].toString();
+
+        // Only load if file still exists
+        if (QFile::exists(entry.localPath)) {
+            loaded.append(entry);
+        }
+    }
+
+    // Rebuild the LRU list oldest first
+    std::sort(loaded.begin(), loaded.end(), [](const CacheEntry &a, const CacheEntry &b) {
+        return a.lastAccess < b.lastAccess;
+    });
+    for (const CacheEntry &entry : loaded) {
+        m_index.insert(MediaCache::cacheKeyFor(entry.url), entry);
+    }
+    m_journal->rewrite();
+    QFile::remove(indexPath);
+
+    qDebug() << "Cache: Migrated" << m_index.size() << "entries from index.json to the journal";
+}
+
+void CacheWorker::ensureCacheDir()
+{
+    QDir dir;
+    if (!dir.exists(m_cacheDir)) {
+        if (dir.mkpath(m_cacheDir)) {
+            qDebug() << "Cache: Created directory:" << m_cacheDir;
+        } else {
+            qWarning() << "Cache: Failed to create directory:" << m_cacheDir;
+        }
+    }
+}
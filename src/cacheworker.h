@@ -0,0 +1,177 @@
+#ifndef CACHEWORKER_H
+#define CACHEWORKER_H
+
+#include <QObject>
+#include <QString>
+#include <QHash>
+#include <QSet>
+#include <QList>
+#include <QStringList>
+#include <QFile>
+#include <QSharedPointer>
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include "cacheindex.h"
+#include "evictionpolicy.h"
+#include "memorytier.h"
+
+class QNetworkAccessManager;
+class QTimer;
+class CacheJournal;
+
+// Immutable view of the cache index handed to the GUI thread. A new view is
+// published after inserts/removes, once per event loop pass, and always
+// before the signals that report them; readers never lock.
+struct CacheView {
+    QHash<QString, QString> paths; // Cache key -> local file path
+    QHash<QString, QString> ramPaths; // Cache key -> copy in the RAM tier, for the hot subset
+    QHash<QString, QString> hashes; // Cache key -> content hash
+    qint64 totalSize = 0;
+    int itemCount = 0;
+    qint64 pinnedSize = 0; // Of the entries that are pinned
+    int pinnedCount = 0;
+    qint64 ramSize = 0;
+    int ramCount = 0;
+    qint64 ramBudget = 0; // 0 when the RAM tier is off
+    int quarantinedCount = 0; // Entries found bad since startup
+};
+
+// A prefetch being streamed to "<key>.part" in the cache directory
+struct PendingDownload {
+    QString url;
+    QFile *file = nullptr;               // Partial file, written as data arrives
+    QCryptographicHash *hash = nullptr;  // Content hash, fed chunk by chunk
+    qint64 hashed = 0;                   // Bytes of the file fed into hash so far
+    bool hashFailed = false;             // Couldn't read back the bytes from before a resume
+    bool finished = false;               // Transfer done, waiting for hash to catch up
+    qint64 resumeOffset = 0;             // Bytes already on disk when the request was sent
+    qint64 bytesReceived = 0;            // Over the network in this request
+    QElapsedTimer timer;                 // Started when the request was sent
+};
+
+// Owns everything MediaCache does on disk: the index and its journal, file
+// writes and deletes, hashing and streamed downloads. Lives on MediaCache's
+// I/O thread; MediaCache calls its slots with queued invocations and gets
+// results back through signals. What to evict is decided by a pluggable
+// EvictionPolicy; shadow caches run every policy on the same lookups so
+// their hit rates can be compared. Entries in a pin set are never evicted.
+// A MemoryTier keeps RAM copies of the playlist's hottest entries.
+//
+// Lookups on the GUI thread trust the published view without a stat(), so
+// the files are checked here instead: a low-priority verifier walks the
+// cache a chunk at a time, comparing each file's size and content hash
+// with the index. Bad files are moved to a quarantine directory and
+// reported with quarantined() so they can be downloaded again.
+class CacheWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit CacheWorker(QObject *parent = nullptr);
+    ~CacheWorker();
+
+public slots:
+    void setCacheDir(const QString &path); // Also (re)loads the index
+    void setMaxSize(qint64 sizeInBytes);
+    void setRamBudget(qint64 sizeInBytes); // 0 disables the RAM tier
+    void storeFile(const QString &url, const QString &key, const QByteArray &data);
+    void prefetch(const QString &url, const QString &key);
+    void probeSize(const QString &url); // HEAD request, answered by sizeProbed()
+    void touch(const QString &key, qint64 accessTime);
+    void recordAccess(const QString &key, qint64 accessTime); // Demand lookup: touch on hit, count
+    void remove(const QString &key); // Entry whose file went missing
+    void evict(); // One entry, chosen by the policy
+    void clear();
+    void setEvictionPolicy(int mode); // EvictionPolicy::Mode
+    void setPlaylist(const QStringList &keys); // Cache keys in play order
+    void setPlaylistPosition(int index);
+    void setPinSet(const QString &name, const QStringList &keys); // Replaces a set of that name
+    void removePinSet(const QString &name);
+    void verify(const QString &key); // Re-hash next, answered by verified(); quarantines the entry if it doesn't match
+    void startVerifier(); // Call once the worker is on its thread
+
+signals:
+    void viewChanged(QSharedPointer<const CacheView> view);
+    void prefetchComplete(const QString &url, bool success);
+    void transferMeasured(const QString &url, qint64 bytes, qint64 elapsedMs);
+    void sizeProbed(const QString &url, qint64 bytes); // -1 if unknown
+    void evictionStatsChanged(const EvictionStats &stats);
+    void verified(const QString &key, bool ok);
+    void quarantined(const QString &url, const QString &key); // Entry dropped as missing or corrupt
+    void cacheUpdated();
+
+private slots:
+    void onPrefetchMetaDataChanged();
+    void onPrefetchReadyRead();
+    void onPrefetchFinished();
+    void checkMemoryPressure();
+    void publishEvictionStats();
+    void flushView(); // Emit the view now if publishView() left it pending; done before reporting changes
+    void verifyStep();
+
+private:
+    void loadCacheIndex();
+    void ensureCacheDir();
+    void insertEntry(const QString &key, const CacheEntry &entry); // Make room and add
+    bool evictVictim(); // Without publishing a new view; false if everything is pinned
+    void rebuildPinned();
+    bool checkSize(const QString &key); // Quarantines on mismatch, false if it did
+    void quarantine(const QString &key, const QString &reason);
+    void finishVerifyFile();
+    void answerVerify(const QString &key, bool ok); // verified(), if verify() asked for key
+    QString quarantineDir() const { return m_cacheDir + "/quarantine"; }
+    void countAccess(const QString &key, bool hit, qint64 size);
+    void resetPolicy(EvictionPolicy::Mode mode);
+    void publishView(); // Soon, once for everything changed until then
+    QString partialPath(const QString &key) const { return m_cacheDir + "/" + key + ".part"; }
+    QString validatorPath(const QString &key) const { return m_cacheDir + "/" + key + ".part.etag"; }
+    void hashPartialStep(const QString &key); // One chunk of the bytes from before a resume
+    void completeDownload(const QString &key);
+    void discardDownload(const QString &key, bool removePartial);
+    QNetworkAccessManager *networkManager();
+
+    CacheIndex m_index; // URL hash -> CacheEntry, in LRU order
+    CacheJournal *m_journal; // Persists every change to m_index
+    QString m_cacheDir;
+    qint64 m_maxSize;
+    QNetworkAccessManager *m_networkManager = nullptr; // All media transfers share its connections
+    QHash<QString, PendingDownload> m_downloads; // Cache key -> in-flight prefetch
+    
+    EvictionPolicy *m_policy = nullptr;
+    QStringList m_playlistKeys;
+    int m_playlistPosition = 0;
+    PolicyCounters m_counters; // This cache's demand hits/misses
+    QList<ShadowCache*> m_shadows; // One per policy
+    QHash<QString, qint64> m_knownSizes; // Cache key -> size, for entries stored or in the playlist
+    QSet<QString> m_unsizedMisses; // Missed before their size was known; counted on insert
+    QHash<QString, QSet<QString>> m_pinSets; // Name -> cache keys kept out of eviction
+    QSet<QString> m_pinned; // Union of m_pinSets
+    MemoryTier m_ramTier;
+    QTimer *m_pressureTimer; // Runs checkMemoryPressure() while the RAM tier is on
+    QTimer *m_statsTimer; // Pending evictionStatsChanged()
+    QTimer *m_publishTimer; // Pending viewChanged()
+    bool m_viewDirty = false;
+    
+    QTimer *m_verifyTimer; // Paces verifyStep()
+    bool m_verifyPassRunning = false;
+    QStringList m_verifyQueue; // Keys left in the current pass
+    QString m_verifyKey; // Entry being hashed
+    QString m_verifyExpected; // Its content hash when hashing started
+    QSet<QString> m_verifyRequested; // Keys verify() was called for, not answered yet
+    QFile *m_verifyFile = nullptr;
+    QCryptographicHash m_verifyHash;
+    int m_quarantinedCount = 0;
+
+    static const qint64 DOWNLOAD_BUFFER_SIZE = 256 * 1024; // Max bytes buffered per reply
+    static constexpr qint64 HASH_CHUNK_SIZE = 1024 * 1024; // Read size when re-hashing a partial file
+    static const int PRESSURE_CHECK_MS = 5000;
+    static const int STATS_INTERVAL_MS = 1000;
+    static const int VERIFY_STEP_MS = 200; // One HASH_CHUNK_SIZE per step: ~5 MB/s, leaves the disk to playback
+    static const int VERIFY_PASS_INTERVAL_MS = 6 * 60 * 60 * 1000; // Between full passes
+    static const int VERIFY_FIRST_PASS_MS = 2 * 60 * 1000; // After startup, once playback has settled
+    static const int QUARANTINE_KEEP = 5; // Newest bad files kept for inspection
+};
+
+Q_DECLARE_METATYPE(QSharedPointer<const CacheView>)
+
+#endif // CACHEWORKER_H
@@ -0,0 +1,246 @@
+#include "clientsnapshot.h"
+#include "logger.h"
+#include "mediacache.h"
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QTimer>
+
+ClientSnapshot& ClientSnapshot::instance()
+{
+    static ClientSnapshot instance;
+    return instance;
+}
+
+ClientSnapshot::ClientSnapshot()
+{
+    m_startupTimer.start();
+}
+
+ClientSnapshot::~ClientSnapshot()
+{
+    // Nothing is written here: this runs during static destruction, after
+    // QApplication and possibly the Logger are gone. main() flushes instead.
+}
+
+bool ClientSnapshot::load()
+{
+    QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    m_path = cacheDir + "/VideoTimeline/client_snapshot.bin";
+
+    QFile file(m_path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        LOG_DEBUG_CAT("No client snapshot found", "Snapshot");
+        return false;
+    }
+
+    // Map the file so parsing reads straight from the page cache
+    qint64 size = file.size();
+    uchar *mapped = file.map(0, size);
+    QByteArray raw = mapped ? QByteArray::fromRawData(reinterpret_cast<const char*>(mapped), size)
+                            : file.readAll();
+
+    QDataStream in(raw);
+    in.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic = 0;
+    quint16 version = 0;
+    quint32 count = 0;
+    in >> magic >> version >> count;
+
+    QHash<quint8, QByteArray> sections;
+    if (magic == MAGIC && version == VERSION) {
+        for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+            quint8 id = 0;
+            QByteArray payload;
+            in >> id >> payload;
+            sections.insert(id, payload);
+        }
+    }
+    bool valid = magic == MAGIC && version == VERSION && in.status() == QDataStream::Ok;
+
+    if (mapped) {
+        file.unmap(mapped);
+    }
+
+    if (!valid) {
+        LOG_WARNING_CAT("Ignoring unreadable or outdated client snapshot", "Snapshot");
+        return false;
+    }
+
+    m_sections = sections;
+    LOG_DEBUG_CAT(QString("Loaded client snapshot (%1 sections, %2 bytes)").arg(sections.size()).arg(size), "Snapshot");
+    return true;
+}
+
+void ClientSnapshot::flush()
+{
+    if (!m_dirty || m_path.isEmpty()) {
+        return;
+    }
+    m_dirty = false;
+
+    QDir().mkpath(QFileInfo(m_path).absolutePath());
+
+    // QSaveFile renames into place on commit, so a power cut never leaves a torn file
+    QSaveFile file(m_path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        LOG_ERROR_CAT(QString("Failed to write client snapshot: %1").arg(file.errorString()), "Snapshot");
+        return;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << MAGIC << VERSION << static_cast<quint32>(m_sections.size());
+    for (auto it = m_sections.constBegin(); it != m_sections.constEnd(); ++it) {
+        out << it.key() << it.value();
+    }
+
+    if (!file.commit()) {
+        LOG_ERROR_CAT(QString("Failed to commit client snapshot: %1").arg(file.errorString()), "Snapshot");
+    }
+}
+
+void ClientSnapshot::setSection(Section section, const QByteArray &data)
+{
+    auto it = m_sections.constFind(section);
+    if (it != m_sections.constEnd() && it.value() == data) {
+        return; // Unchanged, nothing to write
+    }
+    m_sections.insert(section, data);
+
+    if (!m_dirty) {
+        m_dirty = true;
+        QTimer::singleShot(WRITE_DELAY_MS, this, &ClientSnapshot::flush);
+    }
+}
+
+ScheduleSnapshot ClientSnapshot::schedule() const
+{
+    ScheduleSnapshot schedule;
+    QByteArray data = m_sections.value(ScheduleSection);
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_6_0);
+
+    quint32 count = 0;
+    in >> schedule.schoolStart >> schedule.schoolEnd >> schedule.hostname >> count;
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        ScheduleBlock block;
+        in >> block.startTime >> block.endTime >> block.name >> block.type;
+        schedule.blocks.append(block);
+    }
+    return schedule;
+}
+
+void ClientSnapshot::setSchedule(const ScheduleSnapshot &schedule)
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+
+    out << schedule.schoolStart << schedule.schoolEnd << schedule.hostname
+        << static_cast<quint32>(schedule.blocks.size());
+    for (const ScheduleBlock &block : schedule.blocks) {
+        out << block.startTime << block.endTime << block.name << block.type;
+    }
+    setSection(ScheduleSection, data);
+}
+
+MediaPlaylist ClientSnapshot::playlist() const
+{
+    MediaPlaylist playlist;
+    QByteArray data = m_sections.value(PlaylistSection);
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_6_0);
+
+    quint32 count = 0;
+    in >> playlist.isSpecial >> playlist.specialDate >> playlist.title >> playlist.epochMs >> count;
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        MediaItem item;
+        qint32 duration = 0;
+        in >> item.type >> item.url >> duration >> item.muted >> item.customTime >> item.hasCustomTime;
+        item.duration = duration;
+        item.cacheKey = MediaCache::cacheKeyFor(item.url);
+        playlist.items.append(item);
+    }
+    return playlist;
+}
+
+void ClientSnapshot::setPlaylist(const MediaPlaylist &playlist)
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+
+    out << playlist.isSpecial << playlist.specialDate << playlist.title << playlist.epochMs
+        << static_cast<quint32>(playlist.items.size());
+    for (const MediaItem &item : playlist.items) {
+        out << item.type << item.url << static_cast<qint32>(item.duration) << item.muted
+            << item.customTime << item.hasCustomTime;
+    }
+    setSection(PlaylistSection, data);
+}
+
+QString ClientSnapshot::fontFamily() const
+{
+    QByteArray data = m_sections.value(FontSection);
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_6_0);
+    QString family;
+    in >> family;
+    return family;
+}
+
+int ClientSnapshot::fontPointSize() const
+{
+    QByteArray data = m_sections.value(FontSection);
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_6_0);
+    QString family;
+    qint32 pointSize = 0;
+    in >> family >> pointSize;
+    return pointSize;
+}
+
+void ClientSnapshot::setFont(const QString &family, int pointSize)
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << family << static_cast<qint32>(pointSize);
+    setSection(FontSection, data);
+}
+
+QString ClientSnapshot::lastServer() const
+{
+    QByteArray data = m_sections.value(ServerSection);
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_6_0);
+    QString serverUrl;
+    in >> serverUrl;
+    return serverUrl;
+}
+
+void ClientSnapshot::setLastServer(const QString &serverUrl)
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << serverUrl;
+    setSection(ServerSection, data);
+}
+
+void ClientSnapshot::markStartupPhase(const QString &phase)
+{
+    if (m_phasesLogged.contains(phase)) {
+        return;
+    }
+    m_phasesLogged.append(phase);
+
+    qint64 elapsed = m_startupTimer.elapsed();
+    LOG_INFO_CAT(QString("%1 at %2ms (+%3ms)").arg(phase).arg(elapsed).arg(elapsed - m_lastPhaseMs), "Startup");
+    m_lastPhaseMs = elapsed;
+}
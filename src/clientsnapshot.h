@@ -0,0 +1,84 @@
+#ifndef CLIENTSNAPSHOT_H
+#define CLIENTSNAPSHOT_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include "networkclient.h"
+
+// Last received schedule, as emitted by NetworkClient::scheduleReceived
+struct ScheduleSnapshot {
+    QTime schoolStart;
+    QTime schoolEnd;
+    QList<ScheduleBlock> blocks;
+    QString hostname;
+};
+
+// Compact binary image of everything the client needs to put content on
+// screen before the network answers: the last schedule and playlist (already
+// parsed), the resolved UI font and the last server.
+//
+// The file is a versioned section table written with QDataStream. It is
+// memory-mapped at launch and rewritten (atomically, debounced) when any
+// section changes, so a cold start costs one small read instead of several
+// JSON parses.
+class ClientSnapshot : public QObject
+{
+    Q_OBJECT
+
+public:
+    static ClientSnapshot& instance();
+
+    bool load(); // Map and parse the snapshot file; false if missing or stale
+    void flush(); // Write pending changes now; main() calls it once the event loop has ended
+
+    bool hasSchedule() const { return m_sections.contains(ScheduleSection); }
+    ScheduleSnapshot schedule() const;
+    void setSchedule(const ScheduleSnapshot &schedule);
+
+    bool hasPlaylist() const { return m_sections.contains(PlaylistSection); }
+    MediaPlaylist playlist() const;
+    void setPlaylist(const MediaPlaylist &playlist);
+
+    QString fontFamily() const;
+    int fontPointSize() const;
+    void setFont(const QString &family, int pointSize);
+
+    QString lastServer() const;
+    void setLastServer(const QString &serverUrl);
+
+    // Log time since process start for a startup milestone (once per phase)
+    void markStartupPhase(const QString &phase);
+
+private:
+    ClientSnapshot();
+    ~ClientSnapshot();
+    ClientSnapshot(const ClientSnapshot&) = delete;
+    ClientSnapshot& operator=(const ClientSnapshot&) = delete;
+
+    enum Section : quint8 {
+        ScheduleSection = 1,
+        PlaylistSection = 2,
+        // 3 was the media cache index, now kept in MediaCache's own journal
+        FontSection = 4,
+        ServerSection = 5
+    };
+
+    void setSection(Section section, const QByteArray &data);
+
+    static const quint32 MAGIC = 0x56545342; // "VTSB"
+    static const quint16 VERSION = 1;
+    static const int WRITE_DELAY_MS = 2000; // Coalesce bursts of changes into one write
+
+    QString m_path;
+    QHash<quint8, QByteArray> m_sections; // Section id -> serialized payload
+    bool m_dirty = false;
+    QElapsedTimer m_startupTimer;
+    qint64 m_lastPhaseMs = 0;
+    QStringList m_phasesLogged;
+};
+
+#endif // CLIENTSNAPSHOT_H
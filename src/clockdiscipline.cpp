@@ -0,0 +1,184 @@
+#include "clockdiscipline.h"
+#include <QtMath>
+
+ClockDiscipline::ClockDiscipline()
+{
+    reset();
+}
+
+void ClockDiscipline::reset()
+{
+    m_burst.clear();
+    m_history.clear();
+    m_synced = false;
+    m_offset = 0.0;
+    m_offsetTime = 0;
+    m_drift = 0.0;
+    m_jitter = 0.0;
+    m_slewStartOffset = 0.0;
+    m_slewStart = 0;
+    m_lastDelay = -1;
+    m_pollIntervalSecs = MIN_POLL_SECS;
+}
+
+void ClockDiscipline::addSample(const ClockSample &sample)
+{
+    // Reject obviously broken exchanges (clock went backwards during the request)
+    if (sample.t3 < sample.t0 || sample.t2 < sample.t1) {
+        return;
+    }
+    m_burst.append(sample);
+    m_samplesTotal++;
+}
+
+bool ClockDiscipline::commitBurst(qint64 localMs)
+{
+    if (m_burst.isEmpty()) {
+        return false;
+    }
+
+    // Minimum-RTT filter: the sample with the smallest delay has the tightest
+    // bound on the true offset
+    const ClockSample *best = &m_burst.first();
+    for (const ClockSample &sample : m_burst) {
+        if (sample.delay() < best->delay()) {
+            best = &sample;
+        }
+    }
+    FilteredPoint point { best->t3, best->offset(), best->delay() };
+    m_burst.clear();
+    m_burstsTotal++;
+
+    double predicted = m_synced ? m_offset + m_drift * (point.localMs - m_offsetTime) : point.offset;
+    double residual = point.offset - predicted;
+
+    // Popcorn suppression: a burst whose best sample was still badly delayed
+    // and disagrees with the prediction is more likely congestion than a real change
+    if (m_synced && !m_history.isEmpty()) {
+        qint64 minDelay = m_history.first().delay;
+        for (const FilteredPoint &p : m_history) {
+            minDelay = qMin(minDelay, p.delay);
+        }
+        if (point.delay > 3 * minDelay + 10 && qAbs(residual) > qMax(4.0 * m_jitter, 10.0)) {
+            return false;
+        }
+    }
+
+    m_history.append(point);
+    while (m_history.size() > HISTORY_SIZE) {
+        m_history.removeFirst();
+    }
+
+    double applied = offsetAt(localMs);
+
+    m_offset = point.offset;
+    m_offsetTime = point.localMs;
+    m_lastDelay = point.delay;
+    updateDrift();
+    updateJitter();
+
+    double target = m_offset + m_drift * (localMs - m_offsetTime);
+    if (!m_synced || qAbs(target - applied) > STEP_THRESHOLD_MS) {
+        // Large error (or first lock): step straight to the estimate
+        if (m_synced) {
+            m_stepCount++;
+        }
+        m_slewStartOffset = target;
+    } else {
+        m_slewStartOffset = applied;
+    }
+    m_slewStart = localMs;
+    m_synced = true;
+
+    adjustPollInterval(residual);
+    return true;
+}
+
+double ClockDiscipline::offsetAt(qint64 localMs) const
+{
+    if (!m_synced) {
+        return 0.0;
+    }
+
+    // Both the estimate and the applied offset follow the drift; the remaining
+    // difference is removed at no more than MAX_SLEW_RATE so time never jumps
+    double target = m_offset + m_drift * (localMs - m_offsetTime);
+    double base = m_slewStartOffset + m_drift * (localMs - m_slewStart);
+    double maxCorrection = qMax<qint64>(0, localMs - m_slewStart) * MAX_SLEW_RATE;
+    double error = qBound(-maxCorrection, target - base, maxCorrection);
+    return base + error;
+}
+
+ClockStats ClockDiscipline::stats(qint64 localMs) const
+{
+    ClockStats s;
+    s.synced = m_synced;
+    s.offsetMs = offsetAt(localMs);
+    s.targetOffsetMs = m_synced ? m_offset + m_drift * (localMs - m_offsetTime) : 0.0;
+    s.jitterMs = m_jitter;
+    s.driftPpm = m_drift * 1e6;
+    s.lastDelayMs = m_lastDelay;
+    s.samplesTotal = m_samplesTotal;
+    s.burstsTotal = m_burstsTotal;
+    s.stepCount = m_stepCount;
+    s.pollIntervalSecs = m_pollIntervalSecs;
+    return s;
+}
+
+void ClockDiscipline::updateDrift()
+{
+    if (m_history.size() < 3) {
+        return;
+    }
+    qint64 span = m_history.last().localMs - m_history.first().localMs;
+    if (span < MIN_DRIFT_SPAN_MS) {
+        return;
+    }
+
+    // Least-squares slope of offset against local time (centred to keep precision)
+    double meanX = 0.0, meanY = 0.0;
+    qint64 originX = m_history.first().localMs;
+    for (const FilteredPoint &p : m_history) {
+        meanX += p.localMs - originX;
+        meanY += p.offset;
+    }
+    meanX /= m_history.size();
+    meanY /= m_history.size();
+
+    double num = 0.0, den = 0.0;
+    for (const FilteredPoint &p : m_history) {
+        double dx = (p.localMs - originX) - meanX;
+        num += dx * (p.offset - meanY);
+        den += dx * dx;
+    }
+    if (den > 0.0) {
+        m_drift = qBound(-MAX_DRIFT, num / den, MAX_DRIFT);
+    }
+}
+
+void ClockDiscipline::updateJitter()
+{
+    if (m_history.size() < 2) {
+        m_jitter = 0.0;
+        return;
+    }
+
+    // RMS of the history around the drift line through the latest point
+    double sum = 0.0;
+    for (const FilteredPoint &p : m_history) {
+        double expected = m_offset + m_drift * (p.localMs - m_offsetTime);
+        double d = p.offset - expected;
+        sum += d * d;
+    }
+    m_jitter = qSqrt(sum / (m_history.size() - 1));
+}
+
+void ClockDiscipline::adjustPollInterval(double residual)
+{
+    // Back off while the prediction holds, tighten up when it stops holding
+    if (qAbs(residual) <= qMax(4.0 * m_jitter, 2.0)) {
+        m_pollIntervalSecs = qMin(m_pollIntervalSecs * 2, static_cast<int>(MAX_POLL_SECS));
+    } else if (qAbs(residual) > qMax(8.0 * m_jitter, 20.0)) {
+        m_pollIntervalSecs = MIN_POLL_SECS;
+    }
+}
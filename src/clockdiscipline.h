@@ -0,0 +1,105 @@
+#ifndef CLOCKDISCIPLINE_H
+#define CLOCKDISCIPLINE_H
+
+#include <QtGlobal>
+#include <QList>
+
+// One request/response exchange with the time server, NTP style.
+// t0/t3 are local send/receive times, t1/t2 are the server's receive/transmit
+// times, all in milliseconds since the epoch.
+struct ClockSample {
+    qint64 t0 = 0;
+    qint64 t1 = 0;
+    qint64 t2 = 0;
+    qint64 t3 = 0;
+
+    double offset() const { return ((t1 - t0) + (t2 - t3)) / 2.0; }
+    qint64 delay() const { return qMax<qint64>(0, (t3 - t0) - (t2 - t1)); }
+};
+
+struct ClockStats {
+    bool synced = false;
+    double offsetMs = 0.0;       // Offset currently applied to local time
+    double targetOffsetMs = 0.0; // Filtered estimate the applied offset slews towards
+    double jitterMs = 0.0;       // RMS spread of recent filtered offsets
+    double driftPpm = 0.0;       // Estimated local oscillator frequency error
+    qint64 lastDelayMs = -1;     // Round-trip delay of the last accepted sample
+    int samplesTotal = 0;
+    int burstsTotal = 0;
+    int stepCount = 0;           // Number of times the clock was stepped instead of slewed
+    int pollIntervalSecs = 0;
+};
+
+// Clock discipline engine used by NetworkClient to keep display time in
+// agreement with the server. Samples are collected in short bursts, the
+// minimum-delay sample of each burst is kept (the one least disturbed by
+// queueing), drift is estimated by a least-squares fit over the recent
+// history and corrections are slewed rather than stepped unless the error
+// is large.
+class ClockDiscipline
+{
+public:
+    ClockDiscipline();
+
+    void reset();
+
+    // Burst handling: add samples, then commit to fold the best one into the estimate.
+    void addSample(const ClockSample &sample);
+    bool commitBurst(qint64 localMs);
+    int pendingSamples() const { return m_burst.size(); }
+
+    // Offset to add to local time at the given local time (ms).
+    double offsetAt(qint64 localMs) const;
+    qint64 correctedTime(qint64 localMs) const { return localMs + qRound64(offsetAt(localMs)); }
+
+    bool isSynced() const { return m_synced; }
+    ClockStats stats(qint64 localMs) const;
+
+    // Polling policy
+    int burstSize() const { return m_synced ? BURST_SIZE : INITIAL_BURST_SIZE; }
+    int pollIntervalMs() const { return m_pollIntervalSecs * 1000; }
+
+    static const int INITIAL_BURST_SIZE = 8;
+    static const int BURST_SIZE = 4;
+    static const int MIN_POLL_SECS = 64;
+    static const int MAX_POLL_SECS = 1024;
+
+private:
+    struct FilteredPoint {
+        qint64 localMs;
+        double offset;
+        qint64 delay;
+    };
+
+    void updateDrift();
+    void updateJitter();
+    void adjustPollInterval(double residual);
+
+    QList<ClockSample> m_burst;
+    QList<FilteredPoint> m_history; // Most recent burst winners
+
+    bool m_synced = false;
+    double m_offset = 0.0;     // Filtered offset estimate at m_offsetTime
+    qint64 m_offsetTime = 0;
+    double m_drift = 0.0;      // ms of offset change per ms of local time
+    double m_jitter = 0.0;
+
+    // Slew state: the applied offset at m_slewStart, which then converges
+    // towards the estimate at no more than MAX_SLEW_RATE
+    double m_slewStartOffset = 0.0;
+    qint64 m_slewStart = 0;
+
+    qint64 m_lastDelay = -1;
+    int m_samplesTotal = 0;
+    int m_burstsTotal = 0;
+    int m_stepCount = 0;
+    int m_pollIntervalSecs = MIN_POLL_SECS;
+
+    static const int HISTORY_SIZE = 8;
+    static constexpr double STEP_THRESHOLD_MS = 128.0;
+    static constexpr double MAX_SLEW_RATE = 0.0005; // 500 ppm
+    static constexpr double MAX_DRIFT = 0.0005;     // Clamp drift estimate to +/-500 ppm
+    static const qint64 MIN_DRIFT_SPAN_MS = 60 * 1000;
+};
+
+#endif // CLOCKDISCIPLINE_H
@@ -4,6 +4,7 @@
 #include <QKeyEvent>
 #include <QApplication>
 #include <QScreen>
+#include <QUrl>
 
 DiagnosticsOverlay::DiagnosticsOverlay(QWidget *parent)
     : QWidget(parent)
@@ -83,6 +84,14 @@ void DiagnosticsOverlay::setupUI()
     m_pingLabel = new QLabel("--");
     gridLayout->addWidget(m_pingLabel, row++, 1);
     
+    gridLayout->addWidget(new QLabel("Clock Offset:"), row, 0);
+    m_clockOffsetLabel = new QLabel("--");
+    gridLayout->addWidget(m_clockOffsetLabel, row++, 1);
+    
+    gridLayout->addWidget(new QLabel("Clock Jitter:"), row, 0);
+    m_clockJitterLabel = new QLabel("--");
+    gridLayout->addWidget(m_clockJitterLabel, row++, 1);
+    
     // --- Media Section ---
     row++;
     QLabel *mediaHeader = new QLabel("🎬 Media");
@@ -99,7 +108,7 @@ void DiagnosticsOverlay::setupUI()
     m_codecLabel = new QLabel("--");
     gridLayout->addWidget(m_codecLabel, row++, 1);
     
-    gridLayout->addWidget(new QLabel("HW Decode:"), row, 0);
+    gridLayout->addWidget(new QLabel("Decoder:"), row, 0);
     m_hwDecodeLabel = new QLabel("--");
     gridLayout->addWidget(m_hwDecodeLabel, row++, 1);
     
@@ -115,6 +124,48 @@ void DiagnosticsOverlay::setupUI()
     m_statusLabel = new QLabel("--");
     gridLayout->addWidget(m_statusLabel, row++, 1);
     
+    gridLayout->addWidget(new QLabel("Sync Skew:"), row, 0);
+    m_syncLabel = new QLabel("--");
+    gridLayout->addWidget(m_syncLabel, row++, 1);
+    
+    gridLayout->addWidget(new QLabel("Screen Capture:"), row, 0);
+    m_captureLabel = new QLabel("--");
+    gridLayout->addWidget(m_captureLabel, row++, 1);
+    
+    gridLayout->addWidget(new QLabel("Stream:"), row, 0);
+    m_streamLabel = new QLabel("--");
+    m_streamLabel->setWordWrap(true);
+    gridLayout->addWidget(m_streamLabel, row++, 1);
+    
+    // --- Playback Section ---
+    row++;
+    QLabel *playbackHeader = new QLabel("⏱️ Playback");
+    playbackHeader->setFont(headerFont);
+    playbackHeader->setStyleSheet("color: #FFC107;");
+    gridLayout->addWidget(playbackHeader, row++, 0, 1, 2);
+    
+    gridLayout->addWidget(new QLabel("This Item:"), row, 0);
+    m_itemLabel = new QLabel("--");
+    m_itemLabel->setWordWrap(true);
+    gridLayout->addWidget(m_itemLabel, row++, 1);
+    
+    gridLayout->addWidget(new QLabel("First Frame:"), row, 0);
+    m_firstFrameLabel = new QLabel("--");
+    gridLayout->addWidget(m_firstFrameLabel, row++, 1);
+    
+    gridLayout->addWidget(new QLabel("Fade:"), row, 0);
+    m_fadeLabel = new QLabel("--");
+    gridLayout->addWidget(m_fadeLabel, row++, 1);
+    
+    gridLayout->addWidget(new QLabel("Frame Interval:"), row, 0);
+    m_frameIntervalLabel = new QLabel("--");
+    m_frameIntervalLabel->setWordWrap(true);
+    gridLayout->addWidget(m_frameIntervalLabel, row++, 1);
+    
+    gridLayout->addWidget(new QLabel("Stalls:"), row, 0);
+    m_stallLabel = new QLabel("--");
+    gridLayout->addWidget(m_stallLabel, row++, 1);
+    
     // --- Cache Section ---
     row++;
     QLabel *cacheHeader = new QLabel("💾 Cache");
@@ -138,6 +189,41 @@ void DiagnosticsOverlay::setupUI()
     m_cacheCountLabel = new QLabel("--");
     gridLayout->addWidget(m_cacheCountLabel, row++, 1);
     
+    gridLayout->addWidget(new QLabel("Byte Hit Rate:"), row, 0);
+    m_byteHitRateLabel = new QLabel("--");
+    gridLayout->addWidget(m_byteHitRateLabel, row++, 1);
+    
+    gridLayout->addWidget(new QLabel("Eviction:"), row, 0);
+    m_evictionLabel = new QLabel("--");
+    m_evictionLabel->setWordWrap(true);
+    gridLayout->addWidget(m_evictionLabel, row++, 1);
+    
+    gridLayout->addWidget(new QLabel("Prefetch:"), row, 0);
+    m_prefetchLabel = new QLabel("--");
+    gridLayout->addWidget(m_prefetchLabel, row++, 1);
+    
+    gridLayout->addWidget(new QLabel("Bandwidth:"), row, 0);
+    m_bandwidthLabel = new QLabel("--");
+    gridLayout->addWidget(m_bandwidthLabel, row++, 1);
+    
+    gridLayout->addWidget(new QLabel("Predicted Misses:"), row, 0);
+    m_missLabel = new QLabel("--");
+    m_missLabel->setWordWrap(true);
+    gridLayout->addWidget(m_missLabel, row++, 1);
+    
+    gridLayout->addWidget(new QLabel("RAM Tier:"), row, 0);
+    m_ramTierLabel = new QLabel("--");
+    gridLayout->addWidget(m_ramTierLabel, row++, 1);
+    
+    gridLayout->addWidget(new QLabel("Pinned:"), row, 0);
+    m_pinnedLabel = new QLabel("--");
+    gridLayout->addWidget(m_pinnedLabel, row++, 1);
+    
+    gridLayout->addWidget(new QLabel("Special Events:"), row, 0);
+    m_eventsLabel = new QLabel("--");
+    m_eventsLabel->setWordWrap(true);
+    gridLayout->addWidget(m_eventsLabel, row++, 1);
+    
     // --- System Section ---
     row++;
     QLabel *systemHeader = new QLabel("ℹ️ System");
@@ -213,8 +299,44 @@ void DiagnosticsOverlay::setCacheStats(const CacheStats &stats)
     m_info.cacheHits = stats.hits;
     m_info.cacheMisses = stats.misses;
     m_info.cacheHitRate = stats.hitRate();
+    m_info.ramHitRate = stats.ramHitRate();
+    m_info.diskHitRate = stats.diskHitRate();
+    m_info.ramSize = stats.ramSize;
+    m_info.ramItemCount = stats.ramItemCount;
+    m_info.ramMaxSize = stats.ramMaxSize;
     m_info.cacheSize = stats.totalSize;
     m_info.cacheItemCount = stats.itemCount;
+    m_info.quarantined = stats.quarantined;
+    m_info.cacheByteHitRate = stats.byteHitRate();
+    m_info.pinnedSize = stats.pinnedSize;
+    m_info.pinnedCount = stats.pinnedCount;
+    m_info.evictionPolicy = stats.evictionPolicy;
+    m_info.shadowCounters = stats.shadowCounters;
+}
+
+void DiagnosticsOverlay::setPrefetchStats(const PrefetchStats &stats)
+{
+    m_info.prefetchQueued = stats.queued;
+    m_info.prefetchActive = stats.active;
+    m_info.bandwidthBps = stats.bandwidthBps;
+    m_info.bandwidthMeasured = stats.bandwidthMeasured;
+    m_info.predictedMisses = stats.predictedMisses;
+    m_info.firstMissUrl = stats.firstMissUrl;
+    m_info.firstMissLateMs = stats.firstMissLateMs;
+}
+
+void DiagnosticsOverlay::setEventReadiness(const QList<EventReadiness> &readiness)
+{
+    m_info.eventReadiness = readiness;
+}
+
+void DiagnosticsOverlay::setClockStats(const ClockStats &stats)
+{
+    m_info.clockSynced = stats.synced;
+    m_info.clockOffsetMs = stats.offsetMs;
+    m_info.clockJitterMs = stats.jitterMs;
+    m_info.clockDriftPpm = stats.driftPpm;
+    m_info.clockPollSecs = stats.pollIntervalSecs;
 }
 
 void DiagnosticsOverlay::setMediaStatus(QMediaPlayer::MediaStatus status)
@@ -222,6 +344,33 @@ void DiagnosticsOverlay::setMediaStatus(QMediaPlayer::MediaStatus status)
     m_info.mediaStatus = status;
 }
 
+void DiagnosticsOverlay::setSyncInfo(bool lockstep, qint64 skewMs)
+{
+    m_info.lockstep = lockstep;
+    m_info.syncSkewMs = skewMs;
+}
+
+void DiagnosticsOverlay::setCaptureStats(const CaptureStats &stats)
+{
+    m_info.capture = stats;
+}
+
+void DiagnosticsOverlay::setStreamStats(const StreamStats &stats)
+{
+    m_info.stream = stats;
+}
+
+void DiagnosticsOverlay::setPlaybackStats(const PlaybackStats &stats)
+{
+    m_info.playback = stats;
+}
+
+void DiagnosticsOverlay::setDecodeInfo(const QString &decoderPath, bool overBudget)
+{
+    m_info.decoderPath = decoderPath;
+    m_info.overDecodeBudget = overBudget;
+}
+
 void DiagnosticsOverlay::updateDisplay()
 {
     // Network
@@ -248,15 +397,36 @@ void DiagnosticsOverlay::updateDisplay()
         m_pingLabel->setStyleSheet("");
     }
     
+    if (m_info.clockSynced) {
+        m_clockOffsetLabel->setText(QString("%1%2 ms (drift %3 ppm)")
+            .arg(m_info.clockOffsetMs >= 0 ? "+" : "")
+            .arg(m_info.clockOffsetMs, 0, 'f', 1)
+            .arg(m_info.clockDriftPpm, 0, 'f', 1));
+        m_clockJitterLabel->setText(QString("%1 ms (poll %2s)")
+            .arg(m_info.clockJitterMs, 0, 'f', 2)
+            .arg(m_info.clockPollSecs));
+        m_clockJitterLabel->setStyleSheet(m_info.clockJitterMs < 5.0 ? "color: #4CAF50;" : "color: #FF9800;");
+    } else {
+        m_clockOffsetLabel->setText("Not synced");
+        m_clockJitterLabel->setText("--");
+        m_clockJitterLabel->setStyleSheet("");
+    }
+    
     // Media
     m_sourceLabel->setText(m_info.currentItemSource.isEmpty() ? "None" : m_info.currentItemSource);
     m_codecLabel->setText(m_info.currentCodec.isEmpty() ? "Unknown" : m_info.currentCodec);
     
-    if (m_info.hardwareDecodeEnabled) {
-        m_hwDecodeLabel->setText("✅ Enabled");
+    if (m_info.overDecodeBudget) {
+        m_hwDecodeLabel->setText(QString("⚠️ %1, over this display's decode budget").arg(m_info.decoderPath));
+        m_hwDecodeLabel->setStyleSheet("color: #F44336;");
+    } else if (m_info.decoderPath.isEmpty()) {
+        m_hwDecodeLabel->setText("--");
+        m_hwDecodeLabel->setStyleSheet("");
+    } else if (m_info.hardwareDecodeEnabled) {
+        m_hwDecodeLabel->setText(QString("✅ %1").arg(m_info.decoderPath));
         m_hwDecodeLabel->setStyleSheet("color: #4CAF50;");
     } else {
-        m_hwDecodeLabel->setText("❌ Disabled (Software)");
+        m_hwDecodeLabel->setText(QString("❌ %1").arg(m_info.decoderPath));
         m_hwDecodeLabel->setStyleSheet("color: #FF9800;");
     }
     
@@ -264,11 +434,149 @@ void DiagnosticsOverlay::updateDisplay()
     m_fpsLabel->setText(m_info.fps > 0 ? QString::number(m_info.fps, 'f', 2) : "--");
     m_statusLabel->setText(getMediaStatusString(m_info.mediaStatus));
     
+    if (m_info.lockstep) {
+        QString color;
+        if (qAbs(m_info.syncSkewMs) <= 20) color = "#4CAF50";
+        else if (qAbs(m_info.syncSkewMs) <= 100) color = "#FF9800";
+        else color = "#F44336";
+        m_syncLabel->setText(QString("%1 ms (lockstep)").arg(m_info.syncSkewMs));
+        m_syncLabel->setStyleSheet(QString("color: %1;").arg(color));
+    } else {
+        m_syncLabel->setText("Free-running");
+        m_syncLabel->setStyleSheet("");
+    }
+    
+    const CaptureStats &capture = m_info.capture;
+    if (capture.active) {
+        m_captureLabel->setText(QString("%1/%2 frames changed, every %3 ms, %4 ms latency, %5 ms CPU/frame (%6%)")
+            .arg(capture.framesChanged)
+            .arg(capture.framesCaptured)
+            .arg(capture.intervalMs)
+            .arg(capture.latencyMs, 0, 'f', 1)
+            .arg(capture.cpuMsPerFrame, 0, 'f', 1)
+            .arg(capture.cpuLoad * 100.0, 0, 'f', 1));
+    } else {
+        m_captureLabel->setText("Idle");
+    }
+    
+    const StreamStats &stream = m_info.stream;
+    if (!stream.active) {
+        m_streamLabel->setText("Idle");
+        m_streamLabel->setStyleSheet("");
+    } else if (!stream.connected) {
+        m_streamLabel->setText("Connecting...");
+        m_streamLabel->setStyleSheet("color: #FF9800;");
+    } else {
+        QString color;
+        if (stream.latencyMs <= 150) color = "#4CAF50";
+        else if (stream.latencyMs <= 500) color = "#FF9800";
+        else color = "#F44336";
+        m_streamLabel->setText(QString("%1 ms latency (max %2), %3 fps, decode %4 ms, %5 shown / %6 dropped")
+            .arg(stream.latencyMs, 0, 'f', 0)
+            .arg(stream.maxLatencyMs, 0, 'f', 0)
+            .arg(stream.fps, 0, 'f', 1)
+            .arg(stream.decodeMs, 0, 'f', 1)
+            .arg(stream.framesShown)
+            .arg(stream.framesDropped));
+        m_streamLabel->setStyleSheet(QString("color: %1;").arg(color));
+    }
+    
+    // Playback
+    const PlaybackStats &playback = m_info.playback;
+    if (playback.hasCurrent) {
+        const ItemPlayback &item = playback.current;
+        QString text = QString("%1 from %2, ").arg(item.type, item.source);
+        text += item.firstFrameMs >= 0 ? QString("first frame %1 ms").arg(item.firstFrameMs) : QString("loading");
+        if (item.fadeMs >= 0) {
+            text += QString(", fade %1 ms").arg(item.fadeMs);
+        }
+        if (item.type == "video") {
+            text += QString(", %1 frames (%2 late), %3 stalls").arg(item.frames).arg(item.lateFrames).arg(item.stalls);
+        }
+        m_itemLabel->setText(text);
+    } else {
+        m_itemLabel->setText("--");
+    }
+    m_firstFrameLabel->setText(playback.firstFrame.summary());
+    m_fadeLabel->setText(playback.fade.summary());
+    if (playback.frameInterval.count() > 0) {
+        double lateRatio = playback.frames > 0 ? static_cast<double>(playback.lateFrames) / playback.frames : 0.0;
+        m_frameIntervalLabel->setText(QString("%1, %2% late").arg(playback.frameInterval.summary()).arg(lateRatio * 100.0, 0, 'f', 1));
+        m_frameIntervalLabel->setStyleSheet(lateRatio > 0.05 ? "color: #FF9800;" : "");
+    } else {
+        m_frameIntervalLabel->setText("--");
+        m_frameIntervalLabel->setStyleSheet("");
+    }
+    if (playback.stalls > 0) {
+        m_stallLabel->setText(QString("%1 in %2 items, %3").arg(playback.stalls).arg(playback.items).arg(playback.stall.summary()));
+        m_stallLabel->setStyleSheet("color: #FF9800;");
+    } else {
+        m_stallLabel->setText(QString("None in %1 items").arg(playback.items));
+        m_stallLabel->setStyleSheet("");
+    }
+    
     // Cache
-    m_cacheHitRateLabel->setText(QString("%1%").arg(m_info.cacheHitRate, 0, 'f', 1));
+    m_cacheHitRateLabel->setText(QString("%1% (RAM %2%, disk %3%)")
+        .arg(m_info.cacheHitRate, 0, 'f', 1)
+        .arg(m_info.ramHitRate, 0, 'f', 1)
+        .arg(m_info.diskHitRate, 0, 'f', 1));
     m_cacheHitsLabel->setText(QString("%1 / %2").arg(m_info.cacheHits).arg(m_info.cacheMisses));
     m_cacheSizeLabel->setText(formatSize(m_info.cacheSize));
-    m_cacheCountLabel->setText(QString::number(m_info.cacheItemCount));
+    if (m_info.quarantined > 0) {
+        m_cacheCountLabel->setText(QString("%1 (%2 quarantined)").arg(m_info.cacheItemCount).arg(m_info.quarantined));
+        m_cacheCountLabel->setStyleSheet("color: #FF9800;");
+    } else {
+        m_cacheCountLabel->setText(QString::number(m_info.cacheItemCount));
+        m_cacheCountLabel->setStyleSheet("");
+    }
+    m_byteHitRateLabel->setText(QString("%1%").arg(m_info.cacheByteHitRate, 0, 'f', 1));
+    
+    // Simulated hit / byte hit rate of every policy on the same lookups
+    QStringList simulated;
+    for (const PolicyCounters &counters : m_info.shadowCounters) {
+        simulated << QString("%1 %2/%3%")
+            .arg(counters.policy)
+            .arg(counters.hitRate(), 0, 'f', 0)
+            .arg(counters.byteHitRate(), 0, 'f', 0);
+    }
+    m_evictionLabel->setText(simulated.isEmpty() ? m_info.evictionPolicy
+        : QString("%1 (sim: %2)").arg(m_info.evictionPolicy, simulated.join(", ")));
+    m_prefetchLabel->setText(QString("%1 active, %2 queued").arg(m_info.prefetchActive).arg(m_info.prefetchQueued));
+    m_bandwidthLabel->setText(QString("%1/s%2").arg(formatSize(qRound64(m_info.bandwidthBps)))
+                              .arg(m_info.bandwidthMeasured ? "" : " (assumed)"));
+    if (m_info.predictedMisses > 0) {
+        m_missLabel->setText(QString("%1 (%2 late by %3 s)")
+            .arg(m_info.predictedMisses)
+            .arg(QUrl(m_info.firstMissUrl).fileName())
+            .arg(m_info.firstMissLateMs / 1000.0, 0, 'f', 1));
+        m_missLabel->setStyleSheet("color: #F44336;");
+    } else {
+        m_missLabel->setText("None");
+        m_missLabel->setStyleSheet("color: #4CAF50;");
+    }
+    if (m_info.ramMaxSize > 0) {
+        m_ramTierLabel->setText(QString("%1 / %2 (%3 items)")
+            .arg(formatSize(m_info.ramSize))
+            .arg(formatSize(m_info.ramMaxSize))
+            .arg(m_info.ramItemCount));
+    } else {
+        m_ramTierLabel->setText("Off");
+    }
+    m_pinnedLabel->setText(QString("%1 (%2 items)").arg(formatSize(m_info.pinnedSize)).arg(m_info.pinnedCount));
+    
+    // Staging progress of each upcoming event
+    QStringList events;
+    bool allReady = true;
+    for (const EventReadiness &readiness : m_info.eventReadiness) {
+        events << QString("%1 %2: %3/%4")
+            .arg(readiness.title)
+            .arg(readiness.date.toString("dd.MM"))
+            .arg(readiness.ready)
+            .arg(readiness.items);
+        allReady = allReady && readiness.isReady();
+    }
+    m_eventsLabel->setText(events.isEmpty() ? "None upcoming" : events.join(", "));
+    m_eventsLabel->setStyleSheet(events.isEmpty() ? "" : (allReady ? "color: #4CAF50;" : "color: #FF9800;"));
     
     // System
     m_versionLabel->setText(m_info.appVersion.isEmpty() ? APP_VERSION : m_info.appVersion);
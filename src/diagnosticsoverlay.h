@@ -8,6 +8,12 @@
 #include <QTimer>
 #include <QMediaPlayer>
 #include "mediacache.h"
+#include "clockdiscipline.h"
+#include "prefetchscheduler.h"
+#include "specialeventstager.h"
+#include "screencaptureengine.h"
+#include "streamreceiver.h"
+#include "playbackmetrics.h"
 
 struct DiagnosticsInfo {
     // Network
@@ -16,20 +22,57 @@ struct DiagnosticsInfo {
     int pingMs = -1;
     bool connected = false;
     
+    // Clock
+    bool clockSynced = false;
+    double clockOffsetMs = 0.0;
+    double clockJitterMs = 0.0;
+    double clockDriftPpm = 0.0;
+    int clockPollSecs = 0;
+    
     // Media
     QString currentCodec;
     bool hardwareDecodeEnabled = false;
+    QString decoderPath;
+    bool overDecodeBudget = false;
     QString resolution;
     qreal fps = 0.0;
     QString currentItemSource;
     QMediaPlayer::MediaStatus mediaStatus = QMediaPlayer::NoMedia;
+    bool lockstep = false;
+    qint64 syncSkewMs = 0;
+    CaptureStats capture;
+    StreamStats stream;
+    PlaybackStats playback;
     
     // Cache
     int cacheHits = 0;
     int cacheMisses = 0;
     double cacheHitRate = 0.0;
+    double ramHitRate = 0.0;
+    double diskHitRate = 0.0;
+    qint64 ramSize = 0;
+    int ramItemCount = 0;
+    qint64 ramMaxSize = 0;
     qint64 cacheSize = 0;
     int cacheItemCount = 0;
+    int quarantined = 0;
+    double cacheByteHitRate = 0.0;
+    qint64 pinnedSize = 0;
+    int pinnedCount = 0;
+    QString evictionPolicy;
+    QList<PolicyCounters> shadowCounters;
+    
+    // Prefetch
+    int prefetchQueued = 0;
+    int prefetchActive = 0;
+    double bandwidthBps = 0.0;
+    bool bandwidthMeasured = false;
+    int predictedMisses = 0;
+    QString firstMissUrl;
+    qint64 firstMissLateMs = 0;
+    
+    // Special events
+    QList<EventReadiness> eventReadiness;
     
     // System
     QString appVersion;
@@ -53,7 +96,15 @@ public:
     void setMediaInfo(const QString &codec, bool hwDecode, const QString &resolution, qreal fps);
     void setCurrentSource(const QString &source);
     void setCacheStats(const CacheStats &stats);
+    void setPrefetchStats(const PrefetchStats &stats);
+    void setEventReadiness(const QList<EventReadiness> &readiness);
+    void setClockStats(const ClockStats &stats);
     void setMediaStatus(QMediaPlayer::MediaStatus status);
+    void setSyncInfo(bool lockstep, qint64 skewMs);
+    void setCaptureStats(const CaptureStats &stats);
+    void setStreamStats(const StreamStats &stats);
+    void setPlaybackStats(const PlaybackStats &stats);
+    void setDecodeInfo(const QString &decoderPath, bool overBudget);
 
 protected:
     void keyPressEvent(QKeyEvent *event) override;
@@ -74,6 +125,8 @@ private:
     QLabel *m_hostnameLabel;
     QLabel *m_pingLabel;
     QLabel *m_connectionLabel;
+    QLabel *m_clockOffsetLabel;
+    QLabel *m_clockJitterLabel;
     
     // Media section
     QLabel *m_codecLabel;
@@ -82,6 +135,16 @@ private:
     QLabel *m_fpsLabel;
     QLabel *m_sourceLabel;
     QLabel *m_statusLabel;
+    QLabel *m_syncLabel;
+    QLabel *m_captureLabel;
+    QLabel *m_streamLabel;
+    
+    // Playback section
+    QLabel *m_itemLabel;
+    QLabel *m_firstFrameLabel;
+    QLabel *m_fadeLabel;
+    QLabel *m_frameIntervalLabel;
+    QLabel *m_stallLabel;
     
     // Cache section
     QLabel *m_cacheHitRateLabel;
@@ -89,6 +152,14 @@ private:
     QLabel *m_cacheMissesLabel;
     QLabel *m_cacheSizeLabel;
     QLabel *m_cacheCountLabel;
+    QLabel *m_byteHitRateLabel;
+    QLabel *m_evictionLabel;
+    QLabel *m_prefetchLabel;
+    QLabel *m_bandwidthLabel;
+    QLabel *m_missLabel;
+    QLabel *m_pinnedLabel;
+    QLabel *m_ramTierLabel;
+    QLabel *m_eventsLabel;
     
     // System section
     QLabel *m_versionLabel;
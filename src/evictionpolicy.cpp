@@ -0,0 +1,334 @@
+#include "evictionpolicy.h"
+#include <algorithm>
+
+EvictionPolicy *EvictionPolicy::create(Mode mode)
+{
+    switch (mode) {
+    case LruMode:
+        return new LruPolicy;
+    case GdsfMode:
+        return new GdsfPolicy;
+    case PlaylistMode:
+        break;
+    }
+    return new PlaylistPolicy;
+}
+
+QString EvictionPolicy::modeName(Mode mode)
+{
+    switch (mode) {
+    case LruMode:
+        return "lru";
+    case GdsfMode:
+        return "gdsf";
+    case PlaylistMode:
+        break;
+    }
+    return "playlist";
+}
+
+EvictionPolicy::Mode EvictionPolicy::modeFromString(const QString &name, bool *ok)
+{
+    QString lower = name.trimmed().toLower();
+    if (ok) {
+        *ok = true;
+    }
+    if (lower == "lru") return LruMode;
+    if (lower == "gdsf") return GdsfMode;
+    if (lower != "playlist" && ok) {
+        *ok = false;
+    }
+    return PlaylistMode;
+}
+
+// --- LRU ---
+
+QString LruPolicy::victim(const CacheIndex &index, const QSet<QString> &pinned)
+{
+    // O(1) without pins; with them, only the pinned entries at the old end
+    // are stepped over
+    return index.leastRecentKey(pinned);
+}
+
+// --- GDSF ---
+
+double GdsfPolicy::priorityFor(int frequency, qint64 size) const
+{
+    // Cost is one fetch per miss, so the value of keeping an entry is its
+    // frequency per megabyte it occupies
+    double sizeMb = qMax<qint64>(size, 1) / (1024.0 * 1024.0);
+    return m_inflation + frequency / sizeMb;
+}
+
+void GdsfPolicy::onInsert(const QString &key, qint64 size)
+{
+    Meta &meta = m_meta[key];
+    meta.frequency = 1;
+    meta.priority = priorityFor(meta.frequency, size);
+    requeue(key, meta);
+}
+
+void GdsfPolicy::onAccess(const QString &key, qint64 size)
+{
+    Meta &meta = m_meta[key];
+    meta.frequency++;
+    meta.priority = priorityFor(meta.frequency, size);
+    requeue(key, meta);
+}
+
+void GdsfPolicy::onRemove(const QString &key)
+{
+    auto it = m_meta.find(key);
+    if (it == m_meta.end()) {
+        return;
+    }
+    if (it->queued) {
+        m_queue.erase(it->position);
+    }
+    m_meta.erase(it);
+}
+
+void GdsfPolicy::clear()
+{
+    m_meta.clear();
+    m_queue.clear();
+    m_inflation = 0.0;
+}
+
+void GdsfPolicy::requeue(const QString &key, Meta &meta)
+{
+    if (meta.queued) {
+        m_queue.erase(meta.position);
+        meta.queued = false;
+    }
+    if (!meta.held) {
+        // Equal priorities stay in the order they were queued, so ties go
+        // to the entry used longest ago
+        meta.position = m_queue.emplace(meta.priority, key);
+        meta.queued = true;
+    }
+}
+
+void GdsfPolicy::setHeld(const QString &key, bool held)
+{
+    auto it = m_meta.find(key);
+    if (it == m_meta.end() || it->held == held) {
+        return;
+    }
+    it->held = held;
+    requeue(key, *it);
+}
+
+QString GdsfPolicy::victim(const CacheIndex &index, const QSet<QString> &pinned)
+{
+    Q_UNUSED(index);
+    QString key = lowestPriority(pinned);
+    markEvicted(key);
+    return key;
+}
+
+QString GdsfPolicy::lowestPriority(const QSet<QString> &pinned) const
+{
+    for (auto it = m_queue.begin(); it != m_queue.end(); ++it) {
+        if (!pinned.contains(it->second)) {
+            return it->second;
+        }
+    }
+    return QString();
+}
+
+void GdsfPolicy::markEvicted(const QString &key)
+{
+    if (m_meta.contains(key)) {
+        m_inflation = qMax(m_inflation, m_meta.value(key).priority);
+    }
+}
+
+// --- Playlist (Belady) ---
+
+void PlaylistPolicy::onInsert(const QString &key, qint64 size)
+{
+    m_fallback.onInsert(key, size);
+    m_cached.insert(key);
+    if (m_positions.contains(key)) {
+        m_fallback.setHeld(key, true);
+        schedule(key);
+    }
+}
+
+void PlaylistPolicy::onRemove(const QString &key)
+{
+    m_fallback.onRemove(key);
+    m_cached.remove(key);
+    unschedule(key);
+}
+
+void PlaylistPolicy::clear()
+{
+    m_fallback.clear();
+    m_cached.clear();
+    m_nextUse.clear();
+    m_byNextUse.clear();
+}
+
+void PlaylistPolicy::setPlaylist(const QStringList &keys)
+{
+    m_keys = keys;
+    m_positions.clear();
+    for (int i = 0; i < keys.size(); ++i) {
+        if (!keys.at(i).isEmpty()) {
+            m_positions[keys.at(i)].append(i);
+        }
+    }
+    m_length = keys.size();
+    m_position = 0;
+
+    for (const QString &key : m_cached) {
+        m_fallback.setHeld(key, m_positions.contains(key));
+    }
+    reschedule();
+}
+
+void PlaylistPolicy::setPlaylistPosition(int index)
+{
+    if (index < 0 || index >= m_length || index == m_position) {
+        return;
+    }
+    if (index == (m_position + 1) % m_length) {
+        // Only the item leaving the screen gets a new next showing
+        QString left = m_keys.at(m_position);
+        m_position = index;
+        m_step++;
+        if (m_nextUse.contains(left)) {
+            schedule(left);
+        }
+        return;
+    }
+    m_position = index;
+    reschedule();
+}
+
+int PlaylistPolicy::stepsToNextUse(const QString &key, int from) const
+{
+    auto it = m_positions.constFind(key);
+    if (it == m_positions.constEnd()) {
+        return m_length;
+    }
+    const QList<int> &positions = it.value();
+    auto next = std::lower_bound(positions.begin(), positions.end(), from);
+    if (next != positions.end()) {
+        return *next - from;
+    }
+    return positions.first() + m_length - from; // Wraps around
+}
+
+void PlaylistPolicy::schedule(const QString &key)
+{
+    unschedule(key);
+    qint64 step = m_step + stepsToNextUse(key, m_position);
+    m_nextUse.insert(key, step);
+    m_byNextUse[step] = key;
+}
+
+void PlaylistPolicy::unschedule(const QString &key)
+{
+    auto it = m_nextUse.find(key);
+    if (it != m_nextUse.end()) {
+        m_byNextUse.erase(it.value());
+        m_nextUse.erase(it);
+    }
+}
+
+void PlaylistPolicy::reschedule()
+{
+    m_nextUse.clear();
+    m_byNextUse.clear();
+    for (const QString &key : m_cached) {
+        if (m_positions.contains(key)) {
+            schedule(key);
+        }
+    }
+}
+
+QString PlaylistPolicy::victim(const CacheIndex &index, const QSet<QString> &pinned)
+{
+    Q_UNUSED(index);
+
+    // Anything the playlist won't show again goes first, then the one shown
+    // furthest in the future
+    QString key = m_fallback.lowestPriority(pinned);
+    if (key.isEmpty()) {
+        for (auto it = m_byNextUse.rbegin(); it != m_byNextUse.rend(); ++it) {
+            if (!pinned.contains(it->second)) {
+                key = it->second;
+                break;
+            }
+        }
+    }
+    // Both kinds raise L, so GDSF ages the rest the same whichever went
+    m_fallback.markEvicted(key);
+    return key;
+}
+
+// --- Shadow cache ---
+
+ShadowCache::ShadowCache(EvictionPolicy::Mode mode)
+    : m_policy(EvictionPolicy::create(mode))
+{
+    m_counters.policy = EvictionPolicy::modeName(mode);
+}
+
+ShadowCache::~ShadowCache()
+{
+    delete m_policy;
+}
+
+void ShadowCache::setCapacity(qint64 bytes)
+{
+    m_capacity = bytes;
+    while (m_index.totalSize() > m_capacity && !m_index.isEmpty()) {
+        evict();
+    }
+}
+
+void ShadowCache::access(const QString &key, qint64 size)
+{
+    ++m_clock;
+    if (m_index.contains(key)) {
+        m_counters.hits++;
+        m_counters.byteHits += size;
+        m_index.touch(key, m_clock);
+        m_policy->onAccess(key, size);
+        return;
+    }
+
+    m_counters.misses++;
+    m_counters.byteMisses += size;
+    if (size > m_capacity) {
+        return; // Would never fit
+    }
+    while (m_index.totalSize() + size > m_capacity && !m_index.isEmpty()) {
+        evict();
+    }
+    CacheEntry entry;
+    entry.size = size;
+    entry.lastAccess = m_clock;
+    m_index.insert(key, entry);
+    m_policy->onInsert(key, size);
+}
+
+void ShadowCache::clear()
+{
+    m_index.clear();
+    m_policy->clear();
+    QString policy = m_counters.policy;
+    m_counters = PolicyCounters();
+    m_counters.policy = policy;
+}
+
+void ShadowCache::evict()
+{
+    QString key = m_policy->victim(m_index, QSet<QString>());
+    m_index.remove(key);
+    m_policy->onRemove(key);
+}
@@ -0,0 +1,182 @@
+#ifndef EVICTIONPOLICY_H
+#define EVICTIONPOLICY_H
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QSet>
+#include <QList>
+#include <QMetaType>
+#include <map>
+#include "cacheindex.h"
+
+// Demand hits and misses (lookups when an item goes on screen), by count and by bytes
+struct PolicyCounters {
+    QString policy;
+    int hits = 0;
+    int misses = 0;
+    qint64 byteHits = 0;
+    qint64 byteMisses = 0;
+
+    double hitRate() const {
+        int total = hits + misses;
+        return total > 0 ? (static_cast<double>(hits) / total) * 100.0 : 0.0;
+    }
+    double byteHitRate() const {
+        qint64 total = byteHits + byteMisses;
+        return total > 0 ? (static_cast<double>(byteHits) / total) * 100.0 : 0.0;
+    }
+};
+
+// Counters of the policy in use plus those of the shadow caches
+struct EvictionStats {
+    PolicyCounters actual;
+    QList<PolicyCounters> shadows;
+};
+
+// Decides which MediaCache entry to drop when room is needed. The cache
+// reports every insert, access and removal so a policy can keep whatever
+// bookkeeping it needs; victim() is then asked for a key present in index.
+class EvictionPolicy
+{
+public:
+    enum Mode {
+        LruMode,      // Least recently used
+        GdsfMode,     // Greedy-Dual-Size-Frequency: small, often used files stay
+        PlaylistMode  // Furthest next use in the playlist (Belady), GDSF for the rest
+    };
+
+    static EvictionPolicy *create(Mode mode);
+    static QString modeName(Mode mode);
+    static Mode modeFromString(const QString &name, bool *ok = nullptr);
+
+    virtual ~EvictionPolicy() = default;
+    virtual Mode mode() const = 0;
+
+    virtual void onInsert(const QString &key, qint64 size) { Q_UNUSED(key); Q_UNUSED(size); }
+    virtual void onAccess(const QString &key, qint64 size) { Q_UNUSED(key); Q_UNUSED(size); }
+    virtual void onRemove(const QString &key) { Q_UNUSED(key); }
+    virtual void clear() {}
+
+    // Cache keys of the playlist in play order, and the index now on screen
+    virtual void setPlaylist(const QStringList &keys) { Q_UNUSED(keys); }
+    virtual void setPlaylistPosition(int index) { Q_UNUSED(index); }
+
+    // Entry to evict next, never one in pinned; empty if everything is pinned
+    virtual QString victim(const CacheIndex &index, const QSet<QString> &pinned) = 0;
+};
+
+class LruPolicy : public EvictionPolicy
+{
+public:
+    Mode mode() const override { return LruMode; }
+    QString victim(const CacheIndex &index, const QSet<QString> &pinned) override;
+};
+
+// GDSF: each entry has priority L + frequency / size, where L is the
+// priority of the last evicted entry. Aging through L lets entries that
+// were popular once eventually leave. Entries are kept in priority order,
+// so finding the lowest is O(1) and each access O(log n).
+class GdsfPolicy : public EvictionPolicy
+{
+public:
+    Mode mode() const override { return GdsfMode; }
+    void onInsert(const QString &key, qint64 size) override;
+    void onAccess(const QString &key, qint64 size) override;
+    void onRemove(const QString &key) override;
+    void clear() override;
+    QString victim(const CacheIndex &index, const QSet<QString> &pinned) override;
+
+    // Lowest-priority key that is neither held nor pinned; empty if there is none
+    QString lowestPriority(const QSet<QString> &pinned) const;
+    void markEvicted(const QString &key); // Raise L to the evicted entry's priority
+
+    // A held entry keeps its frequency and priority but is never returned
+    // by lowestPriority() until released
+    void setHeld(const QString &key, bool held);
+
+private:
+    struct Meta {
+        int frequency = 0;
+        double priority = 0.0;
+        bool held = false;
+        bool queued = false; // In m_queue, at position
+        std::multimap<double, QString>::iterator position;
+    };
+    double priorityFor(int frequency, qint64 size) const;
+    void requeue(const QString &key, Meta &meta); // After priority or held changed
+
+    QHash<QString, Meta> m_meta;
+    std::multimap<double, QString> m_queue; // Entries not held, lowest priority first
+    double m_inflation = 0.0; // L
+};
+
+// Belady's optimal policy made practical by knowing the future: in a
+// looping playlist the entry whose next showing is furthest away is the one
+// to drop. Entries that aren't in the playlist go first, lowest GDSF
+// priority first.
+//
+// Cached playlist entries are ordered by the step at which they are shown
+// next, counted from when the playlist was set. Moving on by one item only
+// changes the next showing of the item that just left the screen, so
+// advancing is O(log n); a jump reorders everything.
+class PlaylistPolicy : public EvictionPolicy
+{
+public:
+    Mode mode() const override { return PlaylistMode; }
+    void onInsert(const QString &key, qint64 size) override;
+    void onAccess(const QString &key, qint64 size) override { m_fallback.onAccess(key, size); }
+    void onRemove(const QString &key) override;
+    void clear() override;
+    void setPlaylist(const QStringList &keys) override;
+    void setPlaylistPosition(int index) override;
+    QString victim(const CacheIndex &index, const QSet<QString> &pinned) override;
+
+private:
+    int stepsToNextUse(const QString &key, int from) const; // 0 = shown at from
+    void schedule(const QString &key); // (Re)place a cached playlist entry by its next showing
+    void unschedule(const QString &key);
+    void reschedule(); // All of them, after the playlist or position jumped
+
+    GdsfPolicy m_fallback; // Every entry; those in the playlist are held
+    QSet<QString> m_cached; // Keys the cache holds
+    QStringList m_keys;
+    QHash<QString, QList<int>> m_positions; // Cache key -> playlist indices, ascending
+    int m_length = 0;
+    int m_position = 0;
+    qint64 m_step = 0; // Steps taken since the playlist was set
+    QHash<QString, qint64> m_nextUse; // Cached playlist key -> step of its next showing
+    std::map<qint64, QString> m_byNextUse; // The same, soonest first; steps are unique
+};
+
+// A cache of the same capacity that holds no files, only keys and sizes,
+// run under another policy on the same accesses. Comparing its counters
+// with the real ones shows whether the policy in use is the right one.
+class ShadowCache
+{
+public:
+    explicit ShadowCache(EvictionPolicy::Mode mode);
+    ~ShadowCache();
+    ShadowCache(const ShadowCache&) = delete;
+    ShadowCache& operator=(const ShadowCache&) = delete;
+
+    void setCapacity(qint64 bytes);
+    void access(const QString &key, qint64 size); // Hit or miss, then insert on miss
+    void setPlaylist(const QStringList &keys) { m_policy->setPlaylist(keys); }
+    void setPlaylistPosition(int index) { m_policy->setPlaylistPosition(index); }
+    void clear();
+    const PolicyCounters &counters() const { return m_counters; }
+
+private:
+    void evict();
+
+    EvictionPolicy *m_policy;
+    CacheIndex m_index;
+    qint64 m_capacity = 0;
+    qint64 m_clock = 0; // Stands in for access time
+    PolicyCounters m_counters;
+};
+
+Q_DECLARE_METATYPE(EvictionStats)
+
+#endif // EVICTIONPOLICY_H
@@ -0,0 +1,272 @@
+#include "imagedecodepool.h"
+#include "memorytier.h"
+#include "simdkernels.h"
+#include <QImageReader>
+#include <QMetaObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QDebug>
+
+// Held by whichever worker is decoding an oversized image in full
+static QMutex s_largeDecodeMutex;
+
+ImageDecodePool::ImageDecodePool(QObject *parent)
+    : QObject(parent)
+{
+    m_pool.setMaxThreadCount(MAX_THREADS);
+}
+
+ImageDecodePool::~ImageDecodePool()
+{
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+void ImageDecodePool::setTargetSize(const QSize &size)
+{
+    if (size == m_targetSize) {
+        return;
+    }
+    m_targetSize = size;
+    m_generation++;
+    m_frames.clear();
+    m_recent.clear();
+    m_used = 0;
+    updateRecentCost();
+    m_overBudget.clear();
+    m_pool.clear(); // Not started yet; resubmitted below at the new size
+    for (auto it = m_wanted.constBegin(); it != m_wanted.constEnd(); ++it) {
+        submit(it.key(), it.value());
+    }
+}
+
+void ImageDecodePool::setWallConfig(const WallConfig &config)
+{
+    m_wall = config;
+    QSize size = m_targetSize;
+    m_targetSize = QSize();
+    setTargetSize(size);
+}
+
+void ImageDecodePool::setMemoryBudget(qint64 bytes)
+{
+    m_budget = bytes;
+    makeRoom(QString(), 0);
+    updateRecentCost();
+}
+
+qint64 ImageDecodePool::defaultMemoryBudget()
+{
+    qint64 total = MemoryTier::totalMemory();
+    if (total <= 0) {
+        return DEFAULT_BUDGET;
+    }
+    return qBound(32LL * 1024 * 1024, total / 16, 256LL * 1024 * 1024);
+}
+
+void ImageDecodePool::request(const QString &key, const QString &path, const QString &version)
+{
+    Source source;
+    source.path = path;
+    source.version = version;
+    if (m_wanted.value(key).version != version) {
+        m_pending.remove(key); // Whatever is in flight is of the old content
+        m_overBudget.remove(key);
+    }
+    m_wanted.insert(key, source);
+
+    auto it = m_frames.constFind(key);
+    if (it != m_frames.constEnd()) {
+        if (it->version == version) {
+            return;
+        }
+        dropFrame(key, false); // Content changed
+    }
+    if (m_pending.value(key, -1) == m_generation) {
+        return;
+    }
+
+    // Seen before at this size: no decode at all
+    if (Frame *recent = m_recent.object(recentKey(key, version))) {
+        Frame frame = *recent;
+        m_recent.remove(recentKey(key, version));
+        if (!makeRoom(key, frame.bytes) && rank(key) > 0) {
+            m_overBudget.insert(key);
+            return;
+        }
+        insertFrame(key, frame);
+        emit decoded(key, true);
+        return;
+    }
+
+    if (m_overBudget.contains(key) && rank(key) > 0) {
+        return; // Would be dropped again
+    }
+    submit(key, source);
+}
+
+void ImageDecodePool::retain(const QStringList &keys)
+{
+    m_order = keys;
+    const QStringList wanted = m_wanted.keys();
+    for (const QString &key : wanted) {
+        if (!keys.contains(key)) {
+            m_wanted.remove(key);
+        }
+    }
+    const QStringList ready = m_frames.keys();
+    for (const QString &key : ready) {
+        if (!keys.contains(key)) {
+            dropFrame(key, true);
+        }
+    }
+}
+
+void ImageDecodePool::submit(const QString &key, const Source &source)
+{
+    if (m_targetSize.isEmpty()) {
+        return; // Submitted once setTargetSize() is called
+    }
+    m_pending.insert(key, m_generation);
+
+    int generation = m_generation;
+    QString path = source.path;
+    QString version = source.version;
+    QSize size = m_targetSize;
+    WallConfig wall = m_wall;
+    m_pool.start([this, key, path, version, generation, size, wall]() {
+        QImageReader reader(path);
+        #if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+            reader.setAllocationLimit(PER_IMAGE_LIMIT_MB);
+        #endif
+
+        // Ask for no more pixels than the display (or the whole wall) shows
+        QSize sourceSize = reader.size();
+        QSize fitted = wall.isEnabled() ? wall.wallSize(size) : size;
+        bool downscale = sourceSize.isValid() &&
+                         (sourceSize.width() > fitted.width() || sourceSize.height() > fitted.height());
+        if (downscale) {
+            reader.setScaledSize(sourceSize.scaled(fitted, Qt::KeepAspectRatio));
+        }
+
+        // Only JPEG decodes straight at the smaller size. Other handlers,
+        // PNG among them, may accept a scaled size but decode in full and
+        // scale afterwards, so it's the full size that counts for them.
+        QByteArray format = reader.format();
+        bool decodedSmall = downscale && (format == "jpeg" || format == "jpg");
+        qint64 fullBytes = sourceSize.isValid() ? static_cast<qint64>(sourceSize.width()) * sourceSize.height() * 4 : 0;
+        QMutex *largeDecode = nullptr;
+        if (!decodedSmall && fullBytes > LARGE_DECODE_BYTES) {
+            largeDecode = &s_largeDecodeMutex;
+        }
+
+        QImage image;
+        {
+            QMutexLocker locker(largeDecode); // No-op when null
+            image = reader.read();
+        }
+        if (!sourceSize.isValid()) {
+            sourceSize = image.size();
+        }
+        if (image.isNull()) {
+            qWarning() << "Failed to decode image" << path << ":" << reader.errorString();
+        } else {
+            image = scaleToFit(image, size, wall);
+        }
+        // Back to the GUI thread, where QPixmaps can be made
+        QMetaObject::invokeMethod(this, [this, key, version, generation, image, sourceSize]() {
+            onJobFinished(key, version, generation, image, sourceSize);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void ImageDecodePool::onJobFinished(const QString &key, const QString &version, int generation,
+                                    const QImage &image, const QSize &sourceSize)
+{
+    if (m_pending.value(key, -1) == generation) {
+        m_pending.remove(key);
+    }
+    auto wanted = m_wanted.constFind(key);
+    if (generation != m_generation || wanted == m_wanted.constEnd() || wanted->version != version) {
+        return; // Scaled for a size no longer current, or no longer needed
+    }
+
+    if (image.isNull()) {
+        m_wanted.remove(key); // Not retried until requested again
+        emit decoded(key, false);
+        return;
+    }
+
+    Frame frame;
+    frame.bytes = image.sizeInBytes();
+    if (!makeRoom(key, frame.bytes) && rank(key) > 0) {
+        // Decoded again when its turn comes, with everything else dropped
+        qDebug() << "Image frame" << key << "over the decoded image budget, dropped for now";
+        m_overBudget.insert(key);
+        return;
+    }
+    m_overBudget.remove(key);
+    frame.pixmap = QPixmap::fromImage(image);
+    frame.sourceSize = sourceSize;
+    frame.version = version;
+    insertFrame(key, frame);
+    emit decoded(key, true);
+}
+
+int ImageDecodePool::rank(const QString &key) const
+{
+    int index = m_order.indexOf(key);
+    return index < 0 ? 0 : index;
+}
+
+bool ImageDecodePool::makeRoom(const QString &key, qint64 bytes)
+{
+    // Needed furthest in the future goes first
+    int keyRank = key.isEmpty() ? -1 : rank(key);
+    for (int i = m_order.size() - 1; i > keyRank && m_used + bytes > m_budget; --i) {
+        dropFrame(m_order.at(i), true);
+    }
+    return m_used + bytes <= m_budget;
+}
+
+void ImageDecodePool::insertFrame(const QString &key, const Frame &frame)
+{
+    m_frames.insert(key, frame);
+    m_used += frame.bytes;
+    updateRecentCost();
+}
+
+void ImageDecodePool::dropFrame(const QString &key, bool keepRecent)
+{
+    auto it = m_frames.find(key);
+    if (it == m_frames.end()) {
+        return;
+    }
+    m_used -= it->bytes;
+    updateRecentCost();
+    if (keepRecent) {
+        // Deleted right away by QCache if it doesn't fit
+        m_recent.insert(recentKey(key, it->version), new Frame(*it), costOf(it->bytes));
+    }
+    m_frames.erase(it);
+}
+
+QString ImageDecodePool::recentKey(const QString &key, const QString &version) const
+{
+    return QString("%1|%2|%3x%4").arg(key, version).arg(m_targetSize.width()).arg(m_targetSize.height());
+}
+
+void ImageDecodePool::updateRecentCost()
+{
+    // Whatever the frames in use leave of the budget
+    m_recent.setMaxCost(costOf(qMax<qint64>(0, m_budget - m_used)));
+}
+
+QImage ImageDecodePool::scaleToFit(const QImage &image, const QSize &size, const WallConfig &wall)
+{
+    // In wall mode the image spans all displays; keep only our tile of it
+    if (wall.isEnabled()) {
+        return renderWallTile(image, wall, size);
+    }
+    return SimdKernels::scaledToFit(image, size);
+}
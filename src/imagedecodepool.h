@@ -0,0 +1,116 @@
+#ifndef IMAGEDECODEPOOL_H
+#define IMAGEDECODEPOOL_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QSet>
+#include <QCache>
+#include <QImage>
+#include <QPixmap>
+#include <QSize>
+#include <QThreadPool>
+#include "videowall.h"
+
+// Decodes images with QImageReader and scales them to the display size on
+// worker threads, so that showing an image is a setPixmap() of a frame that
+// is already done instead of a decode and a smooth scale on the GUI thread
+// in the middle of a fade. MediaPlayer requests the current image and the
+// next few; frames of anything else are dropped with retain(). Changing the
+// target size (a resize) invalidates every frame and decodes them again.
+//
+// Oversized images never exist in full for long: the reader is asked for
+// the display size up front, which JPEG decodes directly at (DCT scaling).
+// Other formats are decoded in full even when their reader takes a scaled
+// size (PNG does, and scales afterwards): any of those over
+// LARGE_DECODE_BYTES is decoded one at a time, and refused above
+// PER_IMAGE_LIMIT_MB. The frames held are kept within a
+// memory budget by dropping the ones needed furthest in the future.
+//
+// Frames dropped that way, or because playback moved past them, go to a
+// QCache keyed by (key, content version, target size) that gets whatever the
+// budget leaves over. A looping slideshow that fits finds every image there
+// on the next pass and is never decoded again. A new content version (the
+// file changed) or target size simply never matches the old entries.
+class ImageDecodePool : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ImageDecodePool(QObject *parent = nullptr);
+    ~ImageDecodePool(); // Waits for running decodes
+
+    // Size frames are scaled to fit; a different size re-decodes what is wanted
+    void setTargetSize(const QSize &size);
+    QSize targetSize() const { return m_targetSize; }
+    void setWallConfig(const WallConfig &config); // Frames become this display's tile
+
+    // Memory the frames held may use; the current image is kept regardless
+    void setMemoryBudget(qint64 bytes);
+    qint64 memoryBudget() const { return m_budget; }
+    qint64 memoryUsed() const { return m_used + m_recent.totalCost() * 1024LL; }
+    static qint64 defaultMemoryBudget(); // A sixteenth of RAM, 32-256 MB
+
+    // Decode path in the background unless its frame is ready or on its way.
+    // decoded() is emitted when it is done, right away if it was cached.
+    // version identifies the content, e.g. a hash; a new one re-decodes.
+    void request(const QString &key, const QString &path, const QString &version);
+    // Forget frames and requests for anything not in keys, which are in
+    // order of need (the current image first)
+    void retain(const QStringList &keys);
+
+    bool isReady(const QString &key) const { return m_frames.contains(key); }
+    QPixmap frame(const QString &key) const { return m_frames.value(key).pixmap; }
+    QSize sourceSize(const QString &key) const { return m_frames.value(key).sourceSize; }
+
+    // Fit image into size, or cut out the wall tile; safe on any thread
+    static QImage scaleToFit(const QImage &image, const QSize &size, const WallConfig &wall);
+
+signals:
+    void decoded(const QString &key, bool ok);
+
+private:
+    struct Frame {
+        QPixmap pixmap;
+        QSize sourceSize; // Before scaling
+        QString version;
+        qint64 bytes = 0;
+    };
+
+    struct Source {
+        QString path;
+        QString version;
+    };
+
+    void submit(const QString &key, const Source &source);
+    void onJobFinished(const QString &key, const QString &version, int generation,
+                       const QImage &image, const QSize &sourceSize);
+    int rank(const QString &key) const; // Position in the retain() order, 0 if not in it
+    bool makeRoom(const QString &key, qint64 bytes); // Drop frames ranked below key
+    void insertFrame(const QString &key, const Frame &frame);
+    void dropFrame(const QString &key, bool keepRecent); // keepRecent: offer it to m_recent
+    QString recentKey(const QString &key, const QString &version) const;
+    void updateRecentCost();
+    static int costOf(qint64 bytes) { return static_cast<int>(bytes / 1024); } // QCache cost is in KB
+
+    QThreadPool m_pool;
+    QHash<QString, Frame> m_frames;
+    QHash<QString, Source> m_wanted;  // Everything requested since the last retain()
+    QHash<QString, int> m_pending;    // Key -> generation of the decode in flight
+    QStringList m_order;              // Keys given to the last retain()
+    QSet<QString> m_overBudget;       // Didn't fit; decoded again once they're next
+    qint64 m_budget = DEFAULT_BUDGET;
+    qint64 m_used = 0;                // By m_frames
+    QCache<QString, Frame> m_recent;  // Frames no longer in use, by recentKey()
+    int m_generation = 0;             // Bumped when the target size or wall changes
+    QSize m_targetSize;
+    WallConfig m_wall;
+
+    static const int MAX_THREADS = 2; // Leave cores to video decode and the GUI
+    static const int PER_IMAGE_LIMIT_MB = 256; // Largest full-size decode allowed
+    static const qint64 LARGE_DECODE_BYTES = 64LL * 1024 * 1024; // Above this, one at a time
+    static const qint64 DEFAULT_BUDGET = 64LL * 1024 * 1024;
+};
+
+#endif // IMAGEDECODEPOOL_H
@@ -1,12 +1,18 @@
 #include "mainwindow.h"
 #include "logger.h"
+#include "clientsnapshot.h"
+#include "simdkernels.h"
+#include "screencaptureengine.h"
 #include <QApplication>
 #include <QStyleFactory>
 #include <QFont>
 #include <QFontDatabase>
+#include <QFontInfo>
 #include <QCommandLineParser>
 #include <QCommandLineOption>
 #include <QTextStream>
+#include <QTimer>
+#include <QScreen>
 #include <QDebug> // Include QDebug for debug output
 
 #ifndef QT_STRINGIFY
@@ -53,8 +59,36 @@ void customMessageHandler(QtMsgType type, const QMessageLogContext &context, con
     fprintf(stderr, "%s\n", msg.toLocal8Bit().constData());
 }
 
+// Pick the preferred UI font available on this system. Only used when the
+// snapshot has no font from a previous run, since listing families is slow.
+static QString selectAppFont(const QApplication &a, QFont *appFont)
+{
+    QFontDatabase fontDb;
+    QString selectedFontName;
+
+    // Try SF Pro Display first (Apple font)
+    if (fontDb.families().contains("SF Pro Display")) {
+        *appFont = QFont("SF Pro Display", 16, QFont::Normal);
+        selectedFontName = "SF Pro Display";
+    } else if (fontDb.families().contains("Inter")) {
+        *appFont = QFont("Inter", 14, QFont::Normal);
+        selectedFontName = "Inter";
+    } else if (fontDb.families().contains("Roboto")) {
+        *appFont = QFont("Roboto", 14, QFont::Normal);
+        selectedFontName = "Roboto";
+    } else {
+        *appFont = a.font();
+        appFont->setPointSize(14);
+        selectedFontName = appFont->family() + " (system default)";
+    }
+    return selectedFontName;
+}
+
 int main(int argc, char *argv[])
 {
+    // Created first so startup phases are timed from process start
+    ClientSnapshot &snapshot = ClientSnapshot::instance();
+
     QApplication a(argc, argv);
 
     // Set application properties
@@ -91,6 +125,12 @@ int main(int argc, char *argv[])
     QCommandLineOption cacheSizeOption(QStringList() << "cache-size", "Set media cache size in GB (2-8, default: 4).", "size");
     parser.addOption(cacheSizeOption);
     
+    QCommandLineOption ramCacheOption(QStringList() << "ram-cache", "Set in-memory cache tier size in MB (0 disables, default: 1/8 of RAM up to 512).", "size");
+    parser.addOption(ramCacheOption);
+    
+    QCommandLineOption imageMemoryOption(QStringList() << "image-memory", "Set memory for decoded images in MB (min 16, default: 1/16 of RAM, 32-256).", "size");
+    parser.addOption(imageMemoryOption);
+    
     QCommandLineOption specialEventDateOption(QStringList() << "date", "Date for special event in DD:MM:YYYY format (e.g., 10:11:2025). Use 00:00:0000 to trigger every year.", "date");
     parser.addOption(specialEventDateOption);
     
@@ -112,6 +152,18 @@ int main(int argc, char *argv[])
     QCommandLineOption quietHwAccelOption(QStringList() << "quiet-hwaccel", "Suppress hardware acceleration fallback warnings.");
     parser.addOption(quietHwAccelOption);
 
+    QCommandLineOption wallOption(QStringList() << "wall", "Run as one tile of a video wall with the given layout (e.g., 2x2). Requires --tile.", "layout");
+    parser.addOption(wallOption);
+
+    QCommandLineOption tileOption(QStringList() << "tile", "Position of this display in the video wall as column,row from the top left (e.g., 1,0).", "position");
+    parser.addOption(tileOption);
+
+    QCommandLineOption benchKernelsOption(QStringList() << "bench-kernels", "Benchmark the image scaling and blending kernels against Qt's, then exit.");
+    parser.addOption(benchKernelsOption);
+
+    QCommandLineOption benchCaptureOption(QStringList() << "bench-capture", "Run screen capture for the given number of seconds (e.g., under xvfb-run), print its statistics, then exit.", "seconds");
+    parser.addOption(benchCaptureOption);
+
     parser.process(a);
     
     // If --version or -v was passed, print info and exit gracefully
@@ -133,29 +185,70 @@ int main(int argc, char *argv[])
         return 0;
     }
 
+    if (parser.isSet(benchKernelsOption)) {
+        QTextStream out(stdout);
+        out << TTY::Cyan << "[KERNELS] " << TTY::Reset << "CPU kernels available: ";
+        const QList<SimdKernels::Isa> isas = SimdKernels::supportedIsas();
+        for (SimdKernels::Isa isa : isas) {
+            out << SimdKernels::isaName(isa) << " ";
+        }
+        out << "\n";
+        SimdKernels::runBenchmark(out);
+        return 0;
+    }
+
+    if (parser.isSet(benchCaptureOption)) {
+        QTextStream out(stdout);
+        int seconds = qBound(1, parser.value(benchCaptureOption).toInt(), 600);
+        QSize target = a.primaryScreen() ? a.primaryScreen()->size() : QSize(1920, 1080);
+        out << TTY::Cyan << "[CAPTURE] " << TTY::Reset << "Capturing at " << target.width() << "x" << target.height()
+            << " for " << seconds << " s\n";
+        out.flush();
+
+        ScreenCaptureEngine engine;
+        // Queued: the first capture, and so a failure, already happens in start()
+        QObject::connect(&engine, &ScreenCaptureEngine::captureFailed, &a, [&a]() {
+            a.exit(1);
+        }, Qt::QueuedConnection);
+        engine.start(target);
+        QTimer::singleShot(seconds * 1000, &a, &QApplication::quit);
+        int result = a.exec();
+
+        CaptureStats stats = engine.stats();
+        engine.stop();
+        if (result != 0) {
+            out << TTY::Yellow << "[CAPTURE] " << TTY::Reset << "Screen capture failed, see the log\n";
+            return result;
+        }
+        out << TTY::Cyan << "[CAPTURE] " << TTY::Reset << stats.framesCaptured << " captures, "
+            << stats.framesChanged << " changed frames delivered, interval now " << stats.intervalMs << " ms\n";
+        out << TTY::Cyan << "[CAPTURE] " << TTY::Reset << "Latency " << QString::number(stats.latencyMs, 'f', 2)
+            << " ms, CPU " << QString::number(stats.cpuMsPerFrame, 'f', 2) << " ms per capture, "
+            << QString::number(stats.cpuLoad * 100.0, 'f', 2) << "% of one core\n";
+        return 0;
+    }
+
     a.setStyle(QStyleFactory::create("Fusion"));
 
-    QFontDatabase fontDb;
+    snapshot.load();
+    snapshot.markStartupPhase("Snapshot loaded");
+
     QFont appFont;
     QString selectedFontName;
 
-    // Try SF Pro Display first (Apple font)
-    if (fontDb.families().contains("SF Pro Display")) {
-        appFont = QFont("SF Pro Display", 16, QFont::Normal);
-        selectedFontName = "SF Pro Display";
-    } else if (fontDb.families().contains("Inter")) {
-        appFont = QFont("Inter", 14, QFont::Normal);
-        selectedFontName = "Inter";
-    } else if (fontDb.families().contains("Roboto")) {
-        appFont = QFont("Roboto", 14, QFont::Normal);
-        selectedFontName = "Roboto";
+    // Reuse the font picked on the last run; QFontInfo resolves just that one
+    // family instead of enumerating the whole font database
+    QString cachedFamily = snapshot.fontFamily();
+    if (!cachedFamily.isEmpty() && QFontInfo(QFont(cachedFamily)).family() == cachedFamily) {
+        appFont = QFont(cachedFamily, snapshot.fontPointSize(), QFont::Normal);
+        selectedFontName = cachedFamily;
     } else {
-        appFont = a.font();
-        appFont.setPointSize(14);
-        selectedFontName = appFont.family() + " (system default)";
+        selectedFontName = selectAppFont(a, &appFont);
+        snapshot.setFont(appFont.family(), appFont.pointSize());
     }
 
     a.setFont(appFont);
+    snapshot.markStartupPhase("Font resolved");
     
     // Log font selection with TTY colors for visibility
     QTextStream out(stdout);
@@ -193,6 +286,38 @@ int main(int argc, char *argv[])
         }
         out.flush();
     }
+    
+    // Parse RAM tier size (-1 = automatic)
+    qint64 ramCacheSize = -1;
+    if (parser.isSet(ramCacheOption)) {
+        bool ok = false;
+        int sizeMB = parser.value(ramCacheOption).toInt(&ok);
+        if (ok && sizeMB >= 0) {
+            ramCacheSize = static_cast<qint64>(sizeMB) * 1024 * 1024;
+            out << TTY::Cyan << "[CACHE] " << TTY::Reset 
+                << "RAM cache tier set to: " << TTY::Green << sizeMB << "MB" << TTY::Reset << "\n";
+        } else {
+            out << TTY::Yellow << "[CACHE] " << TTY::Reset 
+                << "Invalid RAM cache size, using default\n";
+        }
+        out.flush();
+    }
+    
+    // Parse decoded image budget (-1 = automatic)
+    qint64 imageMemory = -1;
+    if (parser.isSet(imageMemoryOption)) {
+        bool ok = false;
+        int sizeMB = parser.value(imageMemoryOption).toInt(&ok);
+        if (ok && sizeMB >= 16) {
+            imageMemory = static_cast<qint64>(sizeMB) * 1024 * 1024;
+            out << TTY::Cyan << "[CACHE] " << TTY::Reset 
+                << "Decoded image memory set to: " << TTY::Green << sizeMB << "MB" << TTY::Reset << "\n";
+        } else {
+            out << TTY::Yellow << "[CACHE] " << TTY::Reset 
+                << "Invalid image memory (must be at least 16 MB), using default\n";
+        }
+        out.flush();
+    }
 
     // Configure hardware acceleration
     if (parser.isSet(noHwAccelOption)) {
@@ -236,6 +361,20 @@ int main(int argc, char *argv[])
     int specialEventDuration = parser.value(specialEventDurationOption).toInt();
     if (specialEventDuration == 0) specialEventDuration = 180; // Default 3 minutes
     
+    // Parse video wall layout
+    WallConfig wallConfig;
+    if (parser.isSet(wallOption) || parser.isSet(tileOption)) {
+        QString wallError;
+        if (!WallConfig::parse(parser.value(wallOption), parser.value(tileOption), &wallConfig, &wallError)) {
+            out << TTY::Yellow << "[WALL] " << TTY::Reset << wallError << "\n";
+            out.flush();
+            return 1;
+        }
+        out << TTY::Cyan << "[WALL] " << TTY::Reset
+            << "Video wall " << TTY::Green << wallConfig.toString() << TTY::Reset << "\n";
+        out.flush();
+    }
+    
     LOG_INFO(QString("Starting VideoTimeline v%1 (Build: %2)").arg(appVersion).arg(appBuildId));
     
     // Note: --date and --time are dual-purpose parameters:
@@ -245,8 +384,14 @@ int main(int argc, char *argv[])
     QString effectiveTestTime = !specialEventTime.isEmpty() ? specialEventTime : testTimeStr;
     
     MainWindow w(parser.isSet(autoOption), networkRange, forcedDpi, specialEventDate, effectiveTestTime, cacheSize,
-                 specialEventDate, specialEventTime, specialEventImage, specialEventTitle, specialEventDuration);
+                 ramCacheSize, imageMemory, specialEventDate, specialEventTime, specialEventImage, specialEventTitle, specialEventDuration,
+                 wallConfig);
     w.showFullScreen();
+    snapshot.markStartupPhase("Window shown");
 
-    return a.exec();
+    int result = a.exec();
+    // Changes the debounce timer hasn't written yet, while the application
+    // and the logger are still alive
+    snapshot.flush();
+    return result;
 }
@@ -7,7 +7,9 @@
 #include "mediacache.h"
 #include "mediaplayer.h"
 #include "specialevents.h"
+#include "specialeventstager.h"
 #include "logger.h"
+#include "clientsnapshot.h"
 #include "md3colors.h"
 #include <QVBoxLayout>
 #include <QWidget>
@@ -16,16 +18,18 @@
 #include <QResizeEvent>
 #include <QEvent>
 #include <QKeyEvent>
+#include <QStandardPaths>
 #include <iostream>
 
 static qreal s_forcedDpi = 0.0;
 
 MainWindow::MainWindow(bool autoDiscover, const QString &networkRange, qreal forcedDpi, 
                        const QString &testDateStr, const QString &testTimeStr, qint64 cacheSize,
+                       qint64 ramCacheSize, qint64 imageMemory,
                        const QString &specialEventDate, const QString &specialEventTime, 
                        const QString &specialEventImage, const QString &specialEventTitle, 
-                       int specialEventDuration, QWidget *parent)
-    : QMainWindow(parent), m_forcedDpi(forcedDpi)
+                       int specialEventDuration, const WallConfig &wall, QWidget *parent)
+    : QMainWindow(parent), m_forcedDpi(forcedDpi), m_wallMode(wall.isEnabled())
 {
     // Set the global forced DPI for all widgets to use
     s_forcedDpi = forcedDpi;
@@ -80,6 +84,12 @@ MainWindow::MainWindow(bool autoDiscover, const QString &networkRange, qreal for
     m_mediaCache = new MediaCache(this);
     m_mediaCache->setMaxSize(cacheSize);
     LOG_INFO_CAT(QString("Media cache initialized with max size: %1 GB").arg(cacheSize / (1024.0 * 1024.0 * 1024.0)), "Main");
+    if (ramCacheSize < 0) {
+        ramCacheSize = MediaCache::defaultRamCacheSize();
+    }
+    m_mediaCache->setRamCacheSize(ramCacheSize);
+    LOG_INFO_CAT(QString("RAM cache tier: %1 MB").arg(ramCacheSize / (1024 * 1024)), "Main");
+    ClientSnapshot::instance().markStartupPhase("Cache index loaded");
     
     // Initialize network client and discover server if requested
     m_networkClient = new NetworkClient(this);
@@ -107,9 +117,11 @@ MainWindow::MainWindow(bool autoDiscover, const QString &networkRange, qreal for
         // Auto-discover using default algorithm
         m_networkClient->discoverAndSetServer();
     }
+    ClientSnapshot::instance().markStartupPhase("Server resolved");
     
     // Initialize special events system
     m_specialEvents = new SpecialEvents(this);
+    m_eventStager = new SpecialEventStager(m_mediaCache, m_specialEvents, this);
     
     // Add custom event from command line if provided
     if (!specialEventDate.isEmpty() && !specialEventTime.isEmpty() && !specialEventImage.isEmpty()) {
@@ -152,7 +164,15 @@ MainWindow::MainWindow(bool autoDiscover, const QString &networkRange, qreal for
     
     // Create UI widgets
     m_statusBar = new StatusBar(this);
-    m_videoWidget = new VideoWidget(m_mediaCache, this);
+    m_videoWidget = new VideoWidget(m_mediaCache, wall, this);
+    if (imageMemory < 0) {
+        imageMemory = ImageDecodePool::defaultMemoryBudget();
+    }
+    m_videoWidget->getMediaPlayer()->setImageMemoryBudget(imageMemory);
+    LOG_INFO_CAT(QString("Decoded image memory: %1 MB").arg(imageMemory / (1024 * 1024)), "Main");
+    // Rewritten at every item change for collection off the device
+    m_videoWidget->getMediaPlayer()->setMetricsFile(
+        QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/VideoTimeline/playback_metrics.json");
     m_timelineWidget = new TimelineWidget(m_networkClient, this);
     
     // Create activity overlay as child of MainWindow (not centralWidget!)
@@ -165,6 +185,14 @@ MainWindow::MainWindow(bool autoDiscover, const QString &networkRange, qreal for
     m_activityOverlay->raise();
     m_activityOverlay->show();
     
+    // A wall tile is part of one big picture, so it shows video only
+    if (m_wallMode) {
+        m_statusBar->hide();
+        m_timelineWidget->hide();
+        m_activityOverlay->hide();
+        LOG_INFO_CAT(QString("Video wall mode: %1").arg(wall.toString()), "Main");
+    }
+    
     LOG_INFO_CAT("UI components initialized", "Main");
 
     // Add widgets to layout (activity overlay and diagnostics overlay not in layout - they're floating)
@@ -191,9 +219,13 @@ MainWindow::MainWindow(bool autoDiscover, const QString &networkRange, qreal for
     if (m_videoWidget->getMediaPlayer()) {
         connect(m_videoWidget->getMediaPlayer(), &MediaPlayer::codecDetected,
                 m_statusBar, &StatusBar::setCodecInfo);
-    // Listen for playlist finished events to restore UI after special playlists
-    connect(m_videoWidget->getMediaPlayer(), &MediaPlayer::playlistFinished,
-        this, &MainWindow::onPlaylistFinished);
+        connect(m_videoWidget->getMediaPlayer(), &MediaPlayer::decodeReport,
+                m_networkClient, &NetworkClient::postDecodeReport);
+        // Listen for playlist finished events to restore UI after special playlists
+        connect(m_videoWidget->getMediaPlayer(), &MediaPlayer::playlistFinished,
+                this, &MainWindow::onPlaylistFinished);
+        // Playlists carrying an epoch are played in lockstep on the synced clock
+        m_videoWidget->getMediaPlayer()->setTimeSource(m_networkClient);
     }
     
     // Connect status bar signals
@@ -227,8 +259,10 @@ MainWindow::MainWindow(bool autoDiscover, const QString &networkRange, qreal for
     connect(m_videoWidget, &VideoWidget::mediaChanged,
             this, &MainWindow::onMediaChanged);
 
-    // Setup update timer
+    // Setup update timer (single-shot, re-armed on each synced second boundary)
     m_updateTimer = new QTimer(this);
+    m_updateTimer->setSingleShot(true);
+    m_updateTimer->setTimerType(Qt::PreciseTimer);
     connect(m_updateTimer, &QTimer::timeout, this, &MainWindow::updateUIState);
     m_updateTimer->start(1000);
     
@@ -237,8 +271,9 @@ MainWindow::MainWindow(bool autoDiscover, const QString &networkRange, qreal for
     connect(m_diagnosticsTimer, &QTimer::timeout, this, &MainWindow::updateDiagnostics);
     m_diagnosticsTimer->start(1000); // Update diagnostics every second
 
-    // Start network polling
+    // Start network polling (cached schedule/playlist are applied immediately)
     m_networkClient->startPeriodicFetch();
+    ClientSnapshot::instance().markStartupPhase("Cached content applied");
     
     // Configure window
     setCentralWidget(centralWidget);
@@ -271,16 +306,29 @@ void MainWindow::updateUIState()
 {
     // Check for special events using synchronized time from server/internet
     QDateTime currentDateTime = m_networkClient->getCurrentDateTime();
+    
+    // Fire the next update just after the next synced second so bell-time
+    // transitions flip on every display at the same moment
+    int msToNextSecond = 1000 - static_cast<int>(currentDateTime.toMSecsSinceEpoch() % 1000);
+    m_updateTimer->start(msToNextSecond + 5);
+    
     if (m_specialEvents) {
         m_specialEvents->checkForEvents(currentDateTime);
     }
     
+    // Stage media for upcoming special events, downloading only outside school hours
+    if (m_eventStager) {
+        QTime now = m_testTime.isValid() ? m_testTime : currentDateTime.time();
+        bool offHours = m_scheduleLoaded && (now < m_schoolStartTime || now > m_schoolEndTime);
+        m_eventStager->update(currentDateTime, offHours);
+    }
+    
     if (!m_scheduleLoaded) {
         m_timelineWidget->updateCurrentTime(QTime());
         return;
     }
 
-    QTime currentTime = m_testTime.isValid() ? m_testTime : QTime::currentTime();
+    QTime currentTime = m_testTime.isValid() ? m_testTime : currentDateTime.time();
 
     if (currentTime < m_schoolStartTime || currentTime > m_schoolEndTime) {
         m_timelineWidget->updateCurrentTime(QTime());
@@ -330,6 +378,9 @@ void MainWindow::positionActivityOverlay()
         std::cout << "positionActivityOverlay: overlay or videoWidget is null" << std::endl;
         return;
     }
+    if (m_wallMode) {
+        return;
+    }
 
     // Don't show overlay if a special event is active
     if (m_specialEvents && m_specialEvents->isEventActive()) {
@@ -376,9 +427,13 @@ bool MainWindow::eventFilter(QObject *obj, QEvent *event)
 void MainWindow::onMediaChanged(const MediaItem &item)
 {
     Q_UNUSED(item);
+    ClientSnapshot::instance().markStartupPhase("First media shown");
     std::cout << "MainWindow: Media changed, re-raising activity overlay" << std::endl;
     
-    // Don't show/raise overlay if a special event is active
+    // Don't show/raise overlay if a special event is active or on a wall tile
+    if (m_wallMode) {
+        return;
+    }
     if (m_specialEvents && m_specialEvents->isEventActive()) {
         std::cout << "MainWindow: Special event active, keeping overlay hidden" << std::endl;
         return;
@@ -422,11 +477,23 @@ void MainWindow::updateDiagnostics()
         m_networkClient->getLastPing(),
         m_networkClient->isConnected()
     );
+    m_diagnosticsOverlay->setClockStats(m_networkClient->getClockStats());
+    if (MediaPlayer *player = m_videoWidget->getMediaPlayer()) {
+        m_diagnosticsOverlay->setSyncInfo(player->isLockstepActive(), player->getSyncSkewMs());
+        m_diagnosticsOverlay->setPrefetchStats(player->getPrefetchStats());
+        m_diagnosticsOverlay->setCaptureStats(player->getCaptureStats());
+        m_diagnosticsOverlay->setStreamStats(player->getStreamStats());
+        m_diagnosticsOverlay->setPlaybackStats(player->getPlaybackStats());
+        m_diagnosticsOverlay->setDecodeInfo(player->getDecoderPath(), player->isOverDecodeBudget());
+    }
     
     // Update cache stats
     if (m_mediaCache) {
         m_diagnosticsOverlay->setCacheStats(m_mediaCache->getStats());
     }
+    if (m_eventStager) {
+        m_diagnosticsOverlay->setEventReadiness(m_eventStager->readiness());
+    }
     
     // Update media info from video widget
     // Note: VideoWidget would need to expose these methods
@@ -498,6 +565,10 @@ void MainWindow::onPlaylistReceived(const MediaPlaylist &playlist)
         m_videoWidget->onPlaylistReceived(playlist);
     }
     
+    if (m_wallMode) {
+        return; // No UI chrome to show or hide
+    }
+    
     // If the playlist is marked special, hide certain UI elements
     if (playlist.isSpecial) {
         LOG_INFO_CAT("Special playlist received - hiding activity overlay and timeline (statusbar remains visible)", "Main");
@@ -516,6 +587,9 @@ void MainWindow::onPlaylistReceived(const MediaPlaylist &playlist)
 void MainWindow::onPlaylistFinished()
 {
     LOG_INFO_CAT("Playlist finished - restoring UI", "Main");
+    if (m_wallMode) {
+        return;
+    }
     if (m_statusBar) m_statusBar->show();
     if (m_activityOverlay) m_activityOverlay->show();
     if (m_timelineWidget) m_timelineWidget->show();
@@ -7,6 +7,7 @@
 #include "md3colors.h"
 #include "networkclient.h"
 #include "specialevents.h"
+#include "videowall.h"
 
 class VideoWidget;
 class TimelineWidget;
@@ -15,6 +16,7 @@ class ActivityOverlay;
 class DiagnosticsOverlay;
 class MediaCache;
 class MediaPlayer;
+class SpecialEventStager;
 
 class MainWindow : public QMainWindow
 {
@@ -23,9 +25,10 @@ class MainWindow : public QMainWindow
 public:
     MainWindow(bool autoDiscover = false, const QString &networkRange = QString(), qreal forcedDpi = 0.0, 
                const QString &testDateStr = QString(), const QString &testTimeStr = QString(), qint64 cacheSize = 4LL * 1024 * 1024 * 1024,
+               qint64 ramCacheSize = -1, qint64 imageMemory = -1,
                const QString &specialEventDate = QString(), const QString &specialEventTime = QString(), 
                const QString &specialEventImage = QString(), const QString &specialEventTitle = QString(), 
-               int specialEventDuration = 180, QWidget *parent = nullptr);
+               int specialEventDuration = 180, const WallConfig &wall = WallConfig(), QWidget *parent = nullptr);
     ~MainWindow();
     
     static qreal getDpiForScreen(QWidget *widget = nullptr);
@@ -57,6 +60,7 @@ private:
     NetworkClient *m_networkClient;
     MediaCache *m_mediaCache;
     SpecialEvents *m_specialEvents;
+    SpecialEventStager *m_eventStager = nullptr; // Downloads upcoming event media off-hours
     QTimer *m_updateTimer;
     QTimer *m_diagnosticsTimer;
     QTime m_schoolStartTime;
@@ -65,5 +69,6 @@ private:
     qreal m_forcedDpi = 0.0;
     QTime m_testTime;
     QDate m_testDate;
+    bool m_wallMode = false; // Video wall tile: video only, no timeline/status chrome
 };
 #endif // MAINWINDOW_H
@@ -1,367 +1,274 @@
 #include "mediacache.h"
 #include <QStandardPaths>
-#include <QJsonDocument>
-#include <QJsonObject>
-#include <QJsonArray>
 #include <QDateTime>
 #include <QDebug>
-#include <QNetworkRequest>
-#include <QUrl>
+#include <QThread>
+#include <QCryptographicHash>
 
 MediaCache::MediaCache(QObject *parent)
     : QObject(parent)
+    , m_ioThread(new QThread(this))
+    , m_worker(new CacheWorker)
+    , m_view(new CacheView)
     , m_maxSize(4LL * 1024 * 1024 * 1024) // Default 4GB
-    , m_networkManager(new QNetworkAccessManager(this))
 {
+    qRegisterMetaType<QSharedPointer<const CacheView>>();
+    qRegisterMetaType<EvictionStats>();
+    
     // Set cache directory to user's cache location
     QString defaultCacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
     m_cacheDir = defaultCacheDir + "/VideoTimeline/media";
     
-    ensureCacheDir();
-    loadCacheIndex();
+    connect(m_worker, &CacheWorker::viewChanged, this, &MediaCache::onViewChanged);
+    connect(m_worker, &CacheWorker::prefetchComplete, this, &MediaCache::onTransferComplete);
+    connect(m_worker, &CacheWorker::sizeProbed, this, &MediaCache::sizeProbed);
+    connect(m_worker, &CacheWorker::evictionStatsChanged, this, &MediaCache::onEvictionStatsChanged);
+    connect(m_worker, &CacheWorker::transferMeasured, this, &MediaCache::transferMeasured);
+    connect(m_worker, &CacheWorker::verified, this, &MediaCache::verified);
+    connect(m_worker, &CacheWorker::quarantined, this, &MediaCache::onQuarantined);
+    connect(m_worker, &CacheWorker::cacheUpdated, this, &MediaCache::cacheUpdated);
+    
+    // Load the index before handing the worker over, so lookups made during
+    // startup already see what's on disk
+    m_worker->setMaxSize(m_maxSize);
+    m_worker->setCacheDir(m_cacheDir);
+    
+    m_worker->moveToThread(m_ioThread);
+    connect(m_ioThread, &QThread::finished, m_worker, &QObject::deleteLater);
+    m_ioThread->setObjectName("MediaCacheIO");
+    m_ioThread->start(QThread::LowPriority);
+    QMetaObject::invokeMethod(m_worker, "startVerifier", Qt::QueuedConnection);
     
-    // Update stats
     m_stats.maxSize = m_maxSize;
-    m_stats.totalSize = calculateCurrentSize();
-    m_stats.itemCount = m_cache.size();
 }
 
 MediaCache::~MediaCache()
 {
-    saveCacheIndex();
+    // Finishes queued work; the worker is deleted on its own thread on the way out
+    m_ioThread->quit();
+    m_ioThread->wait();
 }
 
 void MediaCache::setMaxSize(qint64 sizeInBytes)
 {
-    QMutexLocker locker(&m_mutex);
     m_maxSize = sizeInBytes;
     m_stats.maxSize = sizeInBytes;
     
-    // Evict items if we're now over the limit
-    if (calculateCurrentSize() > m_maxSize) {
-        evictLRU();
+    // Evicts on the worker if we're now over the limit
+    QMetaObject::invokeMethod(m_worker, "setMaxSize", Qt::QueuedConnection, Q_ARG(qint64, sizeInBytes));
+}
+
+void MediaCache::setRamCacheSize(qint64 sizeInBytes)
+{
+    QMetaObject::invokeMethod(m_worker, "setRamBudget", Qt::QueuedConnection, Q_ARG(qint64, sizeInBytes));
+}
+
+qint64 MediaCache::defaultRamCacheSize()
+{
+    qint64 total = MemoryTier::totalMemory();
+    if (total <= 0) {
+        return 0; // Can't tell how much there is to spare
     }
+    return qMin(total / 8, 512LL * 1024 * 1024);
 }
 
 void MediaCache::setCacheDir(const QString &path)
 {
-    QMutexLocker locker(&m_mutex);
-    
-    // Save current index before changing directory
-    saveCacheIndex();
-    
     m_cacheDir = path;
-    ensureCacheDir();
-    loadCacheIndex();
+    QMetaObject::invokeMethod(m_worker, "setCacheDir", Qt::QueuedConnection, Q_ARG(QString, path));
 }
 
-QString MediaCache::getCachedPath(const QString &url)
+QString MediaCache::getCachedPath(const QString &url, const QString &cacheKey)
 {
-    QMutexLocker locker(&m_mutex);
-    
-    QString key = generateCacheKey(url);
-    
-    if (m_cache.contains(key)) {
-        CacheEntry &entry = m_cache[key];
-        
-        // Check if file still exists
-        if (QFile::exists(entry.localPath)) {
-            // Update access time
-            entry.lastAccess = QDateTime::currentMSecsSinceEpoch();
-            recordHit();
-            emit cacheUpdated();
-            return entry.localPath;
-        } else {
-            // File was deleted, remove from cache
-            m_cache.remove(key);
-            m_stats.itemCount = m_cache.size();
-        }
+    QString key = cacheKey.isEmpty() ? cacheKeyFor(url) : cacheKey;
+    QString localPath = m_view->paths.value(key);
+    
+    // The worker moves it to the front of the LRU list and counts the hit or
+    // miss. Files aren't stat()ed here: the worker's verifier checks them in
+    // the background and drops bad ones from the view.
+    QMetaObject::invokeMethod(m_worker, "recordAccess", Qt::QueuedConnection,
+                              Q_ARG(QString, key), Q_ARG(qint64, QDateTime::currentMSecsSinceEpoch()));
+    if (localPath.isEmpty()) {
+        recordMiss();
+        return QString();
     }
     
-    recordMiss();
-    return QString();
+    // Served from the RAM tier when it holds a copy, sparing the disk
+    QString ramPath = m_view->ramPaths.value(key);
+    if (!ramPath.isEmpty()) {
+        m_stats.ramHits++;
+        localPath = ramPath;
+    }
+    recordHit();
+    emit cacheUpdated();
+    return localPath;
+}
+
+QString MediaCache::peekCachedPath(const QString &url, const QString &cacheKey) const
+{
+    QString key = cacheKey.isEmpty() ? cacheKeyFor(url) : cacheKey;
+    QString ramPath = m_view->ramPaths.value(key);
+    return ramPath.isEmpty() ? m_view->paths.value(key) : ramPath;
 }
 
 void MediaCache::cacheFile(const QString &url, const QByteArray &data)
 {
-    QMutexLocker locker(&m_mutex);
-    
-    QString key = generateCacheKey(url);
-    QString hash = generateContentHash(data);
-    
-    // Check if we already have this exact content cached
-    if (m_cache.contains(key)) {
-        CacheEntry &existing = m_cache[key];
-        if (existing.contentHash == hash && QFile::exists(existing.localPath)) {
-            // Same content, just update access time
-            existing.lastAccess = QDateTime::currentMSecsSinceEpoch();
-            qDebug() << "Cache: Content unchanged for" << url;
-            emit cacheUpdated();
-            return;
-        } else {
-            // Content changed or file missing, remove old entry
-            QFile::remove(existing.localPath);
-            m_cache.remove(key);
-        }
-    }
-    
-    // Evict items if needed to make room
-    qint64 dataSize = data.size();
-    while (calculateCurrentSize() + dataSize > m_maxSize && !m_cache.isEmpty()) {
-        evictLRU();
-    }
-    
-    // Save the file
-    QString localPath = m_cacheDir + "/" + key;
-    QFile file(localPath);
-    if (file.open(QIODevice::WriteOnly)) {
-        file.write(data);
-        file.close();
-        
-        // Add to cache
-        CacheEntry entry;
-        entry.url = url;
-        entry.localPath = localPath;
-        entry.size = dataSize;
-        entry.lastAccess = QDateTime::currentMSecsSinceEpoch();
-        entry.contentHash = hash;
-        
-        m_cache[key] = entry;
-        
-        // Update stats
-        m_stats.totalSize = calculateCurrentSize();
-        m_stats.itemCount = m_cache.size();
-        
-        qDebug() << "Cache: Stored" << url << "(" << dataSize << "bytes )";
-        emit cacheUpdated();
-        saveCacheIndex();
-    } else {
-        qWarning() << "Cache: Failed to write file:" << localPath;
-    }
+    // Hashing and writing happen on the worker; the view updates when it's done
+    QMetaObject::invokeMethod(m_worker, "storeFile", Qt::QueuedConnection,
+                              Q_ARG(QString, url), Q_ARG(QString, cacheKeyFor(url)),
+                              Q_ARG(QByteArray, data));
 }
 
-void MediaCache::prefetchUrl(const QString &url)
+void MediaCache::prefetchUrl(const QString &url, const QString &cacheKey)
 {
     qDebug() << "Cache: Prefetching" << url;
     
     // Check if already cached
-    if (isCached(url)) {
+    if (isCached(url, cacheKey)) {
         qDebug() << "Cache: Already cached, skipping prefetch";
         emit prefetchComplete(url, true);
         return;
     }
     
-    QNetworkRequest request{QUrl(url)};
-    request.setRawHeader("User-Agent", "VideoTimeline Client Cache");
-    
-    QNetworkReply *reply = m_networkManager->get(request);
-    reply->setProperty("prefetch_url", url);
-    connect(reply, &QNetworkReply::finished, this, &MediaCache::onPrefetchFinished);
+    startTransfer(url, cacheKey.isEmpty() ? cacheKeyFor(url) : cacheKey);
 }
 
-bool MediaCache::isCached(const QString &url) const
+void MediaCache::fetch(const QString &url, const QString &cacheKey)
 {
-    QMutexLocker locker(const_cast<QMutex*>(&m_mutex));
-    QString key = generateCacheKey(url);
-    
-    if (m_cache.contains(key)) {
-        const CacheEntry &entry = m_cache[key];
-        return QFile::exists(entry.localPath);
+    m_fetchWaiters.insert(url);
+    startTransfer(url, cacheKey.isEmpty() ? cacheKeyFor(url) : cacheKey);
+}
+
+void MediaCache::startTransfer(const QString &url, const QString &key)
+{
+    // One transfer per URL, however many prefetches and fetches ask for it
+    if (m_inFlight.contains(url)) {
+        qDebug() << "Cache: Joining download already in flight for" << url;
+        return;
     }
-    
-    return false;
+    m_inFlight.insert(url, key);
+    QMetaObject::invokeMethod(m_worker, "prefetch", Qt::QueuedConnection,
+                              Q_ARG(QString, url), Q_ARG(QString, key));
 }
 
-void MediaCache::clear()
+void MediaCache::probeSize(const QString &url)
 {
-    QMutexLocker locker(&m_mutex);
-    
-    // Delete all cached files
-    for (const CacheEntry &entry : m_cache) {
-        QFile::remove(entry.localPath);
+    QMetaObject::invokeMethod(m_worker, "probeSize", Qt::QueuedConnection, Q_ARG(QString, url));
+}
+
+void MediaCache::onTransferComplete(const QString &url, bool success)
+{
+    // The worker publishes the new view before reporting, so it's already here
+    QString key = m_inFlight.take(url);
+    if (m_fetchWaiters.remove(url)) {
+        QString localPath = success ? m_view->paths.value(key.isEmpty() ? cacheKeyFor(url) : key) : QString();
+        emit fetchFinished(url, localPath);
     }
-    
-    m_cache.clear();
+    emit prefetchComplete(url, success);
+}
+
+bool MediaCache::isCached(const QString &url, const QString &cacheKey) const
+{
+    return m_view->paths.contains(cacheKey.isEmpty() ? cacheKeyFor(url) : cacheKey);
+}
+
+QString MediaCache::contentHash(const QString &url, const QString &cacheKey) const
+{
+    return m_view->hashes.value(cacheKey.isEmpty() ? cacheKeyFor(url) : cacheKey);
+}
+
+void MediaCache::clear()
+{
+    QMetaObject::invokeMethod(m_worker, "clear", Qt::QueuedConnection);
     
     // Update stats
-    m_stats.totalSize = 0;
-    m_stats.itemCount = 0;
     m_stats.hits = 0;
     m_stats.misses = 0;
-    
-    saveCacheIndex();
-    emit cacheUpdated();
-    
-    qDebug() << "Cache: Cleared all entries";
+    m_stats.ramHits = 0;
 }
 
 void MediaCache::evictLRU()
 {
-    if (m_cache.isEmpty()) {
-        return;
-    }
-    
-    // Find the least recently used entry
-    QString oldestKey;
-    qint64 oldestTime = QDateTime::currentMSecsSinceEpoch();
-    
-    for (auto it = m_cache.begin(); it != m_cache.end(); ++it) {
-        if (it.value().lastAccess < oldestTime) {
-            oldestTime = it.value().lastAccess;
-            oldestKey = it.key();
-        }
-    }
-    
-    // Remove the oldest entry
-    if (!oldestKey.isEmpty()) {
-        CacheEntry entry = m_cache[oldestKey];
-        QFile::remove(entry.localPath);
-        m_cache.remove(oldestKey);
-        
-        qDebug() << "Cache: Evicted LRU item:" << entry.url << "(" << entry.size << "bytes)";
-        
-        // Update stats
-        m_stats.totalSize = calculateCurrentSize();
-        m_stats.itemCount = m_cache.size();
-        emit cacheUpdated();
-    }
+    QMetaObject::invokeMethod(m_worker, "evict", Qt::QueuedConnection);
 }
 
-void MediaCache::updateAccess(const QString &url)
+void MediaCache::setEvictionPolicy(EvictionPolicy::Mode mode)
 {
-    QMutexLocker locker(&m_mutex);
-    QString key = generateCacheKey(url);
-    
-    if (m_cache.contains(key)) {
-        m_cache[key].lastAccess = QDateTime::currentMSecsSinceEpoch();
-    }
+    m_evictionMode = mode;
+    QMetaObject::invokeMethod(m_worker, "setEvictionPolicy", Qt::QueuedConnection, Q_ARG(int, mode));
 }
 
-void MediaCache::onPrefetchFinished()
+void MediaCache::setPlaylist(const QStringList &cacheKeys)
 {
-    QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
-    if (!reply) return;
-    
-    QString url = reply->property("prefetch_url").toString();
-    bool success = false;
-    
-    if (reply->error() == QNetworkReply::NoError) {
-        QByteArray data = reply->readAll();
-        cacheFile(url, data);
-        success = true;
-        qDebug() << "Cache: Prefetch complete for" << url;
-    } else {
-        qWarning() << "Cache: Prefetch failed for" << url << ":" << reply->errorString();
-    }
-    
-    emit prefetchComplete(url, success);
-    reply->deleteLater();
+    QMetaObject::invokeMethod(m_worker, "setPlaylist", Qt::QueuedConnection, Q_ARG(QStringList, cacheKeys));
 }
 
-QString MediaCache::generateCacheKey(const QString &url) const
+void MediaCache::setPlaylistPosition(int index)
 {
-    // Generate a hash-based filename from the URL
-    QByteArray hash = QCryptographicHash::hash(url.toUtf8(), QCryptographicHash::Sha256);
-    return hash.toHex();
+    QMetaObject::invokeMethod(m_worker, "setPlaylistPosition", Qt::QueuedConnection, Q_ARG(int, index));
 }
 
-QString MediaCache::generateContentHash(const QByteArray &data) const
+void MediaCache::pin(const QString &setName, const QStringList &cacheKeys)
 {
-    QByteArray hash = QCryptographicHash::hash(data, QCryptographicHash::Sha256);
-    return hash.toHex();
+    QMetaObject::invokeMethod(m_worker, "setPinSet", Qt::QueuedConnection,
+                              Q_ARG(QString, setName), Q_ARG(QStringList, cacheKeys));
 }
 
-void MediaCache::loadCacheIndex()
+void MediaCache::unpin(const QString &setName)
 {
-    QString indexPath = m_cacheDir + "/index.json";
-    QFile file(indexPath);
-    
-    if (!file.open(QIODevice::ReadOnly)) {
-        qDebug() << "Cache: No index file found, starting fresh";
-        return;
-    }
-    
-    QByteArray data = file.readAll();
-    file.close();
-    
-    QJsonDocument doc = QJsonDocument::fromJson(data);
-    if (!doc.isObject()) {
-        qWarning() << "Cache: Invalid index file format";
-        return;
-    }
-    
-    QJsonObject root = doc.object();
-    QJsonArray entries = root["entries"].toArray();
-    
-    m_cache.clear();
-    
-    for (const QJsonValue &value : entries) {
-        QJsonObject obj = value.toObject();
-        
-        CacheEntry entry;
-        entry.url = obj["url"].toString();
-        entry.localPath = obj["localPath"].toString();
-        entry.size = obj["size"].toVariant().toLongLong();
-        entry.lastAccess = obj["lastAccess"].toVariant().toLongLong();
-        entry.contentHash = obj["contentHash"].toString();
-        
-        // Only load if file still exists
-        if (QFile::exists(entry.localPath)) {
-            QString key = generateCacheKey(entry.url);
-            m_cache[key] = entry;
-        }
-    }
-    
-    qDebug() << "Cache: Loaded" << m_cache.size() << "entries from index";
+    QMetaObject::invokeMethod(m_worker, "removePinSet", Qt::QueuedConnection, Q_ARG(QString, setName));
 }
 
-void MediaCache::saveCacheIndex()
+void MediaCache::verify(const QString &cacheKey)
 {
-    QString indexPath = m_cacheDir + "/index.json";
-    
-    QJsonArray entries;
-    for (const CacheEntry &entry : m_cache) {
-        QJsonObject obj;
-        obj["url"] = entry.url;
-        obj["localPath"] = entry.localPath;
-        obj["size"] = QJsonValue::fromVariant(entry.size);
-        obj["lastAccess"] = QJsonValue::fromVariant(entry.lastAccess);
-        obj["contentHash"] = entry.contentHash;
-        entries.append(obj);
-    }
-    
-    QJsonObject root;
-    root["entries"] = entries;
-    root["maxSize"] = QJsonValue::fromVariant(m_maxSize);
-    
-    QJsonDocument doc(root);
-    
-    QFile file(indexPath);
-    if (file.open(QIODevice::WriteOnly)) {
-        file.write(doc.toJson());
-        file.close();
-    } else {
-        qWarning() << "Cache: Failed to save index file";
-    }
+    QMetaObject::invokeMethod(m_worker, "verify", Qt::QueuedConnection, Q_ARG(QString, cacheKey));
 }
 
-void MediaCache::ensureCacheDir()
+void MediaCache::updateAccess(const QString &url)
 {
-    QDir dir;
-    if (!dir.exists(m_cacheDir)) {
-        if (dir.mkpath(m_cacheDir)) {
-            qDebug() << "Cache: Created directory:" << m_cacheDir;
-        } else {
-            qWarning() << "Cache: Failed to create directory:" << m_cacheDir;
-        }
-    }
+    QMetaObject::invokeMethod(m_worker, "touch", Qt::QueuedConnection,
+                              Q_ARG(QString, cacheKeyFor(url)),
+                              Q_ARG(qint64, QDateTime::currentMSecsSinceEpoch()));
 }
 
-qint64 MediaCache::calculateCurrentSize() const
+CacheStats MediaCache::getStats() const
 {
-    qint64 total = 0;
-    for (const CacheEntry &entry : m_cache) {
-        total += entry.size;
-    }
-    return total;
+    CacheStats stats = m_stats;
+    stats.totalSize = m_view->totalSize;
+    stats.itemCount = m_view->itemCount;
+    stats.pinnedSize = m_view->pinnedSize;
+    stats.pinnedCount = m_view->pinnedCount;
+    stats.ramSize = m_view->ramSize;
+    stats.ramItemCount = m_view->ramCount;
+    stats.ramMaxSize = m_view->ramBudget;
+    stats.quarantined = m_view->quarantinedCount;
+    stats.byteHits = m_evictionStats.actual.byteHits;
+    stats.byteMisses = m_evictionStats.actual.byteMisses;
+    stats.evictionPolicy = EvictionPolicy::modeName(m_evictionMode);
+    stats.shadowCounters = m_evictionStats.shadows;
+    return stats;
+}
+
+void MediaCache::onViewChanged(QSharedPointer<const CacheView> view)
+{
+    m_view = view;
+}
+
+void MediaCache::onQuarantined(const QString &url, const QString &key)
+{
+    // Replace the bad copy; the view no longer has it, so lookups miss meanwhile
+    qDebug() << "Cache: Downloading a fresh copy of" << url;
+    startTransfer(url, key);
+}
+
+void MediaCache::onEvictionStatsChanged(const EvictionStats &stats)
+{
+    m_evictionStats = stats;
+}
+
+QString MediaCache::cacheKeyFor(const QString &url)
+{
+    // Generate a hash-based filename from the URL
+    QByteArray hash = QCryptographicHash::hash(url.toUtf8(), QCryptographicHash::Sha256);
+    return hash.toHex();
 }
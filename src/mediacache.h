@@ -5,34 +5,54 @@
 #include <QString>
 #include <QHash>
 #include <QQueue>
-#include <QFile>
-#include <QDir>
-#include <QMutex>
-#include <QCryptographicHash>
-#include <QNetworkAccessManager>
-#include <QNetworkReply>
+#include <QSharedPointer>
+#include <QSet>
+#include "cacheworker.h"
 
-struct CacheEntry {
-    QString url;           // Original URL
-    QString localPath;     // Path to cached file
-    qint64 size;          // File size in bytes
-    qint64 lastAccess;    // Timestamp of last access
-    QString contentHash;   // Hash of the content for change detection
-};
+class QThread;
 
 struct CacheStats {
     int hits = 0;
     int misses = 0;
+    int ramHits = 0; // Part of hits served from the RAM tier
+    qint64 byteHits = 0;
+    qint64 byteMisses = 0;
     qint64 totalSize = 0;
     int itemCount = 0;
     qint64 maxSize = 0;
+    qint64 pinnedSize = 0;
+    int pinnedCount = 0;
+    qint64 ramSize = 0;
+    int ramItemCount = 0;
+    qint64 ramMaxSize = 0; // 0 when the RAM tier is off
+    int quarantined = 0; // Entries the verifier found missing or corrupt
+    QString evictionPolicy;
+    QList<PolicyCounters> shadowCounters; // What each policy would have achieved
     
     double hitRate() const {
         int total = hits + misses;
         return total > 0 ? (static_cast<double>(hits) / total) * 100.0 : 0.0;
     }
+    double byteHitRate() const {
+        qint64 total = byteHits + byteMisses;
+        return total > 0 ? (static_cast<double>(byteHits) / total) * 100.0 : 0.0;
+    }
+    // Share of all lookups answered by each tier; they add up to hitRate()
+    double ramHitRate() const {
+        int total = hits + misses;
+        return total > 0 ? (static_cast<double>(ramHits) / total) * 100.0 : 0.0;
+    }
+    double diskHitRate() const {
+        int total = hits + misses;
+        return total > 0 ? (static_cast<double>(hits - ramHits) / total) * 100.0 : 0.0;
+    }
 };
 
+// Front end of the media cache, used from the GUI thread. All disk work
+// (writes, deletes, hashing, downloads, the index journal) is done by a
+// CacheWorker on a dedicated I/O thread; lookups read the latest immutable
+// CacheView it published, so they never wait on that work or on the disk;
+// the worker verifies files in the background instead.
 class MediaCache : public QObject
 {
     Q_OBJECT
@@ -44,46 +64,78 @@ public:
     // Configuration
     void setMaxSize(qint64 sizeInBytes); // Set max cache size (2-8 GB)
     void setCacheDir(const QString &path); // Set cache directory
+    void setRamCacheSize(qint64 sizeInBytes); // RAM tier in front of the disk, 0 disables
+    static qint64 defaultRamCacheSize(); // An eighth of RAM, at most 512 MB
     qint64 getMaxSize() const { return m_maxSize; }
     QString getCacheDir() const { return m_cacheDir; }
     
-    // Cache operations
-    QString getCachedPath(const QString &url); // Get local path if cached, empty if not
+    // Cache operations. cacheKey may be passed when already known (see
+    // MediaItem::cacheKey) to skip hashing the URL on every lookup.
+    QString getCachedPath(const QString &url, const QString &cacheKey = QString()); // Get local path if cached, empty if not
+    // Same path, for looking ahead: not counted as a hit or miss and leaves
+    // recency, eviction and the RAM tier alone
+    QString peekCachedPath(const QString &url, const QString &cacheKey = QString()) const;
     void cacheFile(const QString &url, const QByteArray &data); // Cache a file
-    void prefetchUrl(const QString &url); // Asynchronously prefetch a URL
-    bool isCached(const QString &url) const;
+    void prefetchUrl(const QString &url, const QString &cacheKey = QString()); // Asynchronously prefetch a URL
+    void fetch(const QString &url, const QString &cacheKey = QString()); // Download now, answered by fetchFinished()
+    void probeSize(const QString &url); // Content length, answered by sizeProbed()
+    bool isCached(const QString &url, const QString &cacheKey = QString()) const;
+    QString contentHash(const QString &url, const QString &cacheKey = QString()) const; // Empty if not cached
+    static QString cacheKeyFor(const QString &url); // Stable key (file name) for a URL
     
     // Cache management
     void clear(); // Clear entire cache
-    void evictLRU(); // Remove least recently used items to stay under limit
+    void evictLRU(); // Remove one entry, chosen by the eviction policy
     void updateAccess(const QString &url); // Update LRU timestamp
+    void setEvictionPolicy(EvictionPolicy::Mode mode);
+    EvictionPolicy::Mode evictionPolicy() const { return m_evictionMode; }
+    
+    // Playlist order (cache keys, empty for items not cached) and the item
+    // on screen, for the playlist-aware eviction policy
+    void setPlaylist(const QStringList &cacheKeys);
+    void setPlaylistPosition(int index);
+    
+    // Named sets of cache keys that are never evicted, e.g. the media of an
+    // upcoming special event. Pinning a key that isn't cached yet is fine;
+    // it is protected from the moment it arrives.
+    void pin(const QString &setName, const QStringList &cacheKeys);
+    void unpin(const QString &setName);
+    // Re-hash on the I/O thread, answered by verified(). A bad entry is
+    // quarantined and downloaded again; call this when a cached file fails to load.
+    void verify(const QString &cacheKey);
     
     // Statistics
-    CacheStats getStats() const { return m_stats; }
+    CacheStats getStats() const;
     void recordHit() { m_stats.hits++; }
     void recordMiss() { m_stats.misses++; }
     
 signals:
     void cacheUpdated();
     void prefetchComplete(const QString &url, bool success);
+    void transferMeasured(const QString &url, qint64 bytes, qint64 elapsedMs); // Finished prefetch throughput
+    void fetchFinished(const QString &url, const QString &localPath); // Empty path on failure
+    void sizeProbed(const QString &url, qint64 bytes);
+    void verified(const QString &cacheKey, bool ok); // A failed entry has been dropped
 
 private slots:
-    void onPrefetchFinished();
+    void onViewChanged(QSharedPointer<const CacheView> view);
+    void onTransferComplete(const QString &url, bool success);
+    void onEvictionStatsChanged(const EvictionStats &stats);
+    void onQuarantined(const QString &url, const QString &key);
 
 private:
-    QString generateCacheKey(const QString &url) const;
-    QString generateContentHash(const QByteArray &data) const;
-    void loadCacheIndex();
-    void saveCacheIndex();
-    void ensureCacheDir();
-    qint64 calculateCurrentSize() const;
+    void startTransfer(const QString &url, const QString &key);
     
-    QHash<QString, CacheEntry> m_cache; // URL hash -> CacheEntry
-    QMutex m_mutex; // Thread safety
+    QThread *m_ioThread; // Runs m_worker
+    CacheWorker *m_worker; // Owns the index and all disk I/O
+    QSharedPointer<const CacheView> m_view; // Latest snapshot from m_worker (GUI thread only)
+    QHash<QString, QString> m_inFlight; // url -> cache key of transfers running on m_worker
+    QSet<QString> m_fetchWaiters; // URLs someone called fetch() for
     QString m_cacheDir;
     qint64 m_maxSize; // Maximum cache size in bytes (default 4GB)
-    CacheStats m_stats;
-    QNetworkAccessManager *m_networkManager;
+    CacheStats m_stats; // hits/misses; sizes come from m_view
+    EvictionStats m_evictionStats; // Latest from m_worker
+    EvictionPolicy::Mode m_evictionMode = EvictionPolicy::PlaylistMode;
 };
 
 #endif // MEDIACACHE_H
@@ -2,24 +2,62 @@
 #include "mediacache.h"
 #include "logger.h"
 #include "qt6compat.h"
-#include <QNetworkAccessManager>
-#include <QNetworkRequest>
-#include <QNetworkReply>
 #include <QPixmap>
 #include <QDebug>
 #include <QUrl>
 #include <QScreen>
 #include <QGuiApplication>
 #include <QTime>
+#include <QDateTime>
 #include <QWidget>
 #include <QApplication>
 #include <QPainter>
 #include <QFont>
 #include <QMediaMetaData>
+#include <QVideoFrame>
+#include <QVideoFrameFormat>
+#include <QMediaFormat>
+#include <QFileInfo>
+
+// The media backends don't say which decoder they picked; the frames they
+// hand over hint at it. GPU textures can only come from a hardware decoder.
+// In-memory NV12/P010 usually means one mapped back to memory, but some
+// software decoders output NV12 too, so that is only a guess; planar YUV is
+// a software decoder.
+static QString decoderPathOf(const QVideoFrame &frame)
+{
+    if (frame.handleType() != QVideoFrame::NoHandle) {
+        return "hardware";
+    }
+    switch (frame.pixelFormat()) {
+    case QVideoFrameFormat::Format_NV12:
+    case QVideoFrameFormat::Format_P010:
+    case QVideoFrameFormat::Format_P016:
+        return "likely hardware";
+    default:
+        return "software";
+    }
+}
+
+// File a player source refers to, empty for network URLs
+static QString localFileOf(const QUrl &source)
+{
+    if (source.isLocalFile()) {
+        return source.toLocalFile();
+    }
+    return source.scheme().isEmpty() ? source.path() : QString();
+}
 
 MediaPlayer::MediaPlayer(QVideoWidget *videoOutput, QLabel *imageLabel, QStackedLayout *layout, QObject *parent)
+    : MediaPlayer(videoOutput, videoOutput, imageLabel, layout, parent)
+{
+}
+
+MediaPlayer::MediaPlayer(QWidget *videoWidget, QObject *videoSink, QLabel *imageLabel, QStackedLayout *layout, QObject *parent)
     : QObject(parent)
-    , m_videoOutput(videoOutput)
+    , m_videoOutput(videoWidget)
+    , m_videoSink(videoSink)
+    , m_prerollSink(new QVideoSink(this))
     , m_imageLabel(imageLabel)
     , m_layout(layout)
     , m_mediaCache(nullptr)
@@ -28,131 +66,341 @@ MediaPlayer::MediaPlayer(QVideoWidget *videoOutput, QLabel *imageLabel, QStacked
     , m_transitionsEnabled(true)
     , m_isFading(false)
     , m_waitingForVideoToLoad(false)
+    , m_timeSource(nullptr)
+    , m_syncIntervalMs(SYNC_INTERVAL_MS)
+    , m_frameBudgetMs(FRAME_BUDGET_MS)
     , m_hwDecodeEnabled(false)
     , m_currentFps(0.0)
 {
-    // Initialize media player
-    m_player = new QMediaPlayer(this);
-    m_player->setVideoOutput(m_videoOutput);
+    // Two players: m_player is on screen, m_standbyPlayer opens the next
+    // video ahead of time into a sink of its own (see prerollNextVideo())
+    m_player = createPlayer();
+    m_player->setVideoOutput(videoSink);
+    m_standbyPlayer = createPlayer();
+    m_standbyPlayer->setVideoOutput(m_prerollSink);
     
-    // Initialize audio output for Qt6 compatibility
-    SETUP_AUDIO_OUTPUT(m_player);
-    
-    // Connect video player signals
-    connect(m_player, &QMediaPlayer::playbackStateChanged, 
-            this, &MediaPlayer::onVideoStateChanged);
-    connect(m_player, &QMediaPlayer::mediaStatusChanged, 
-            this, [this](QMediaPlayer::MediaStatus status) {
-                emit mediaStatusChanged(status);
-                if (status == QMediaPlayer::EndOfMedia) {
-                    onVideoFinished();
-                } else if (status == QMediaPlayer::LoadedMedia || status == QMediaPlayer::BufferedMedia) {
-                    // Detect codec properties when media is loaded
-                    detectMediaProperties();
-                    
-                    // If we were waiting for video to load during a fade transition, show it now
-                    if (m_waitingForVideoToLoad) {
-                        m_waitingForVideoToLoad = false;
-                        showVideo();
-                        // Now start the fade-in animation
-                        if (m_transitionsEnabled && m_isFading) {
-                            fadeIn();
-                        }
-                    }
-                }
-            });
+    // Frames reaching the screen: a video item's first one ends its load,
+    // the rest give its frame pacing. The display sink stays where it is
+    // when the players swap, so this covers both.
+    if (QVideoSink *sink = m_player->videoSink()) {
+        connect(sink, &QVideoSink::videoFrameChanged, this, [this](const QVideoFrame &frame) {
+            if (m_videoOnOverlay && frame.isValid()) {
+                m_transition->showIncoming(fitToArea(frame.toImage()));
+            }
+            if (!frame.isValid() || !m_metrics.hasCurrent() || m_metrics.current().type != "video") {
+                return;
+            }
+            if (m_decoderPath.isEmpty()) {
+                m_decoderPath = decoderPathOf(frame);
+                LOG_DEBUG_CAT(QString("Decoder: %1, %2 frames").arg(m_decoderPath,
+                    QVideoFrameFormat::pixelFormatToString(frame.pixelFormat())), "MediaPlayer");
+                detectMediaProperties();
+            }
+            m_metrics.firstFrameShown();
+            m_metrics.frameDelivered();
+            if (m_metrics.current().frames == REPORT_AFTER_FRAMES && isSingleVideoLoop()) {
+                reportDecode();
+            }
+        });
+    }
     
-    // Log any media player errors
-    connect(m_player, MEDIAPLAYER_ERROR_SIGNAL,
-            this, [this](QMediaPlayer::Error error, const QString &errorString){
-                HANDLE_MEDIA_ERROR(error, errorString);
-                LOG_ERROR_CAT(QString("Media error: %1").arg(errorString), "MediaPlayer");
-                // Move to next item on error
-                next();
-            });
+    // Codec details come from the file itself, read on a worker thread
+    m_mediaProbe = new MediaProbe(this);
+    connect(m_mediaProbe, &MediaProbe::probed, this, [this](const QString &path) {
+        if (m_metrics.hasCurrent() && m_metrics.current().type == "video" && path == localFileOf(m_player->source())) {
+            detectMediaProperties();
+        }
+    });
+    
+    // Images are decoded and scaled off the GUI thread, ahead of their turn
+    m_imageDecoder = new ImageDecodePool(this);
+    connect(m_imageDecoder, &ImageDecodePool::decoded, this, &MediaPlayer::onImageDecoded);
     
     // Initialize image timer
     m_imageTimer = new QTimer(this);
     m_imageTimer->setSingleShot(true);
     connect(m_imageTimer, &QTimer::timeout, this, &MediaPlayer::onImageTimerFinished);
 
-    // Initialize screen capture timer (capture every 100ms for smooth display)
-    m_screenTimer = new QTimer(this);
-    connect(m_screenTimer, &QTimer::timeout, this, &MediaPlayer::onScreenCaptureTimer);
+    // Screen mirroring: only changed frames come through, at a rate that
+    // follows how much the screen changes
+    m_screenCapture = new ScreenCaptureEngine(this);
+    connect(m_screenCapture, &ScreenCaptureEngine::frameReady, this, [this](const QImage &frame) {
+        m_screenLabel->setPixmap(QPixmap::fromImage(frame));
+        m_metrics.firstFrameShown();
+    });
+    connect(m_screenCapture, &ScreenCaptureEngine::captureFailed, this, &MediaPlayer::onCaptureFailed);
+
+    // Live streams share the screen label; the first frame ends a crossfade
+    m_streamReceiver = new StreamReceiver(this);
+    connect(m_streamReceiver, &StreamReceiver::frameReady, this, [this](const QImage &frame) {
+        m_screenLabel->setPixmap(QPixmap::fromImage(frame));
+        m_metrics.firstFrameShown();
+        if (m_isFading) {
+            revealIncoming();
+        }
+    });
 
     // Clock timer for checking scheduled custom_time items (checks every second)
     m_clockTimer = new QTimer(this);
     m_clockTimer->setInterval(1000);
     connect(m_clockTimer, &QTimer::timeout, this, &MediaPlayer::checkScheduledItems);
 
+    // Lockstep sync timer (single-shot, re-armed for the next check or item boundary)
+    m_syncTimer = new QTimer(this);
+    m_syncTimer->setSingleShot(true);
+    m_syncTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_syncTimer, &QTimer::timeout, this, &MediaPlayer::onSyncTimer);
+    
+    // Duration probe: a second, output-less player used only to read video lengths
+    m_durationProbe = new QMediaPlayer(this);
+    connect(m_durationProbe, &QMediaPlayer::durationChanged, this, [this](qint64 duration) {
+        if (duration <= 0 || m_probingUrl.isEmpty()) return;
+        LOG_DEBUG_CAT(QString("Probed duration %1ms: %2").arg(duration).arg(m_probingUrl), "Sync");
+        recordVideoDuration(m_probingUrl, duration);
+        m_probingUrl.clear();
+        SET_MEDIA_SOURCE(m_durationProbe, QUrl());
+        probeVideoDurations();
+        if (m_isPlaying && isLockstepActive() && !m_syncTimer->isActive()) {
+            LOG_INFO_CAT("All item durations known, switching to lockstep playback", "Sync");
+            m_imageTimer->stop();
+            onSyncTimer();
+        }
+    });
+    connect(m_durationProbe, MEDIAPLAYER_ERROR_SIGNAL,
+            this, [this](QMediaPlayer::Error error, const QString &errorString) {
+                Q_UNUSED(error);
+                if (m_probingUrl.isEmpty()) return;
+                LOG_WARNING_CAT(QString("Duration probe failed for %1: %2").arg(m_probingUrl).arg(errorString), "Sync");
+                m_probeFailed.insert(m_probingUrl); // Not cached: tried again on the next load
+                m_probingUrl.clear();
+                probeVideoDurations();
+            });
+
     // Initialize screen label
     m_screenLabel = new QLabel();
     m_screenLabel->setAlignment(Qt::AlignCenter);
     m_screenLabel->setScaledContents(true);
     m_layout->addWidget(m_screenLabel); // Add to layout at SCREEN_INDEX
     
-    // Setup opacity effects for transitions
-    m_videoOpacity = new QGraphicsOpacityEffect(m_videoOutput);
-    m_videoOutput->setGraphicsEffect(m_videoOpacity);
-    m_videoOpacity->setOpacity(1.0);
+    // Crossfades are drawn on an overlay; the media widgets carry no effects
+    m_transition = new TransitionOverlay(m_layout->parentWidget());
+    connect(m_transition, &TransitionOverlay::finished, this, &MediaPlayer::onCrossfadeFinished);
     
-    m_imageOpacity = new QGraphicsOpacityEffect(m_imageLabel);
-    m_imageLabel->setGraphicsEffect(m_imageOpacity);
-    m_imageOpacity->setOpacity(1.0);
+    LOG_INFO_CAT("MediaPlayer initialized with transitions enabled", "MediaPlayer");
+}
+
+QMediaPlayer *MediaPlayer::createPlayer()
+{
+    QMediaPlayer *player = new QMediaPlayer(this);
     
-    m_screenOpacity = new QGraphicsOpacityEffect(m_screenLabel);
-    m_screenLabel->setGraphicsEffect(m_screenOpacity);
-    m_screenOpacity->setOpacity(1.0);
+    // Initialize audio output for Qt6 compatibility
+    SETUP_AUDIO_OUTPUT(player);
     
-    // Setup fade animation
-    m_fadeAnimation = new QPropertyAnimation(this);
-    m_fadeAnimation->setDuration(m_fadeDuration);
-    connect(m_fadeAnimation, &QPropertyAnimation::finished, 
-            this, &MediaPlayer::onFadeInFinished);
+    // The players swap roles, so every handler checks which one it is hearing from
+    connect(player, &QMediaPlayer::playbackStateChanged, 
+            this, [this, player](QMediaPlayer::PlaybackState state) {
+                if (player == m_player) {
+                    onVideoStateChanged(state);
+                }
+            });
+    connect(player, &QMediaPlayer::mediaStatusChanged, 
+            this, [this, player](QMediaPlayer::MediaStatus status) {
+                if (player == m_player) {
+                    onActiveStatusChanged(status);
+                }
+            });
     
-    LOG_INFO_CAT("MediaPlayer initialized with transitions enabled", "MediaPlayer");
+    // Remember video durations for lockstep scheduling
+    connect(player, &QMediaPlayer::durationChanged, this, [this, player](qint64 duration) {
+        QString url;
+        if (player == m_player && m_playlist.getCurrentItem().type == "video") {
+            url = m_playlist.getCurrentItem().url;
+        } else if (player == m_standbyPlayer) {
+            url = m_standbyItemUrl;
+        }
+        if (duration > 0 && !url.isEmpty() && m_videoDurations.value(url) <= 0) {
+            recordVideoDuration(url, duration);
+        }
+    });
+    
+    // Log any media player errors
+    connect(player, MEDIAPLAYER_ERROR_SIGNAL,
+            this, [this, player](QMediaPlayer::Error error, const QString &errorString){
+                if (player == m_standbyPlayer) {
+                    // Nothing on screen; the item loads the usual way when its turn comes
+                    LOG_WARNING_CAT(QString("Pre-roll failed for %1: %2").arg(m_standbyItemUrl, errorString), "MediaPlayer");
+                    releaseStandby();
+                    return;
+                }
+                HANDLE_MEDIA_ERROR(error, errorString);
+                LOG_ERROR_CAT(QString("Media error: %1").arg(errorString), "MediaPlayer");
+                // A cached copy may be corrupt: have the cache check it, and
+                // replace it if so, before the item comes round again
+                MediaItem item = m_playlist.getCurrentItem();
+                if (m_mediaCache && m_mediaCache->isCached(item.url, item.cacheKey)) {
+                    m_mediaCache->verify(item.cacheKey.isEmpty() ? MediaCache::cacheKeyFor(item.url) : item.cacheKey);
+                }
+                // Move to next item on error
+                next();
+            });
+    
+    return player;
+}
+
+void MediaPlayer::onActiveStatusChanged(QMediaPlayer::MediaStatus status)
+{
+    emit mediaStatusChanged(status);
+    if (status == QMediaPlayer::EndOfMedia) {
+        onVideoFinished();
+    } else if (status == QMediaPlayer::StalledMedia || status == QMediaPlayer::BufferingMedia) {
+        m_metrics.stallStarted(); // Only counted once the item has shown a frame
+    } else if (status == QMediaPlayer::LoadedMedia || status == QMediaPlayer::BufferedMedia) {
+        m_metrics.stallEnded();
+        
+        // Detect codec properties when media is loaded
+        detectMediaProperties();
+        
+        // Lockstep: jump straight to where the other displays are
+        if (status == QMediaPlayer::LoadedMedia && isLockstepActive()) {
+            onSyncTimer();
+        }
+        
+        // If we were waiting for video to load during a fade transition, show it now
+        if (m_waitingForVideoToLoad) {
+            m_waitingForVideoToLoad = false;
+            showVideo();
+            // Now crossfade to it
+            if (m_transitionsEnabled && m_isFading) {
+                revealIncoming();
+            }
+        }
+    }
 }
 
 void MediaPlayer::setPlaylist(const MediaPlaylist &playlist)
 {
+    // Periodic refetches usually return the same playlist; keep playing instead of restarting
+    if (m_isPlaying && m_playlist.hasSameContent(playlist)) {
+        LOG_DEBUG_CAT("Playlist unchanged, continuing playback", "MediaPlayer");
+        return;
+    }
+    
     stop();
     m_playlist = playlist;
     m_playlist.currentIndex = 0;
+    m_probeFailed.clear();
+    rebuildCursor();
+    if (m_mediaCache) {
+        QStringList cacheKeys;
+        for (const MediaItem &item : m_playlist.items) {
+            cacheKeys.append(item.cacheKey);
+        }
+        m_mediaCache->setPlaylist(cacheKeys);
+    }
+    if (m_prefetchScheduler) {
+        m_prefetchScheduler->clear(); // Replanned when playback starts
+    }
     LOG_INFO_CAT(QString("Playlist set with %1 items").arg(m_playlist.items.size()), "MediaPlayer");
 }
 
 void MediaPlayer::setMediaCache(MediaCache *cache)
 {
     m_mediaCache = cache;
+    delete m_prefetchScheduler;
+    m_prefetchScheduler = nullptr;
     if (m_mediaCache) {
         connect(m_mediaCache, &MediaCache::prefetchComplete,
                 this, &MediaPlayer::onPrefetchComplete);
+        connect(m_mediaCache, &MediaCache::fetchFinished,
+                this, &MediaPlayer::onImageFetched);
+        m_prefetchScheduler = new PrefetchScheduler(m_mediaCache, this);
         LOG_INFO_CAT("Media cache connected", "MediaPlayer");
     }
 }
 
+void MediaPlayer::setTimeSource(NetworkClient *client)
+{
+    m_timeSource = client;
+    m_streamReceiver->setTimeSource(client);
+    if (m_timeSource) {
+        // Durations probed in earlier runs let a restarted client resume mid-loop right away
+        const QHash<QString, qint64> cached = m_timeSource->loadCachedDurations();
+        for (auto it = cached.constBegin(); it != cached.constEnd(); ++it) {
+            if (it.value() > 0) { // Older runs recorded failed probes as -1
+                m_videoDurations.insert(it.key(), it.value());
+            }
+        }
+        rebuildCursor();
+    }
+}
+
+void MediaPlayer::setWallConfig(const WallConfig &config)
+{
+    m_wall = config;
+    m_imageDecoder->setWallConfig(config);
+    if (m_wall.isEnabled()) {
+        m_syncIntervalMs = WALL_SYNC_INTERVAL_MS;
+        m_frameBudgetMs = WALL_FRAME_BUDGET_MS;
+        LOG_INFO_CAT(QString("Video wall mode: %1").arg(m_wall.toString()), "MediaPlayer");
+    } else {
+        m_syncIntervalMs = SYNC_INTERVAL_MS;
+        m_frameBudgetMs = FRAME_BUDGET_MS;
+    }
+}
+
 void MediaPlayer::play()
 {
     if (!m_playlist.hasItems()) {
         qDebug() << "Cannot play: playlist is empty";
         return;
     }
+    if (m_isPlaying) {
+        return; // Already playing this playlist (see setPlaylist)
+    }
     
     m_isPlaying = true;
     // If this is a special playlist, start the clock that looks for custom_time items
     if (m_playlist.isSpecial) {
         m_clockTimer->start();
     }
+    
+    // In lockstep mode start on whatever item the rest of the displays are showing
+    PlaylistCursor::Position position = lockstepPosition(syncedNowMs());
+    if (position.isValid()) {
+        m_playlist.currentIndex = position.index;
+        LOG_INFO_CAT(QString("Lockstep playback: starting at item %1 (+%2ms)").arg(position.index).arg(position.offsetMs), "Sync");
+    } else if (m_timeSource && m_playlist.epochMs > 0) {
+        probeVideoDurations();
+    }
+    
     playCurrentItem();
+    schedulePrefetches();
+    
+    if (isLockstepActive()) {
+        m_syncTimer->start(m_syncIntervalMs);
+    }
 }
 
 void MediaPlayer::stop()
 {
     m_isPlaying = false;
     m_player->stop();
+    releaseStandby();
+    m_imageDecoder->retain(QStringList());
+    m_pendingImageUrl.clear();
+    m_transition->cancel();
+    m_isFading = false;
+    m_videoOnOverlay = false;
+    m_waitingForVideoToLoad = false;
     m_imageTimer->stop();
-    m_screenTimer->stop();
+    m_screenCapture->stop();
+    m_streamReceiver->stop();
     m_clockTimer->stop();
+    m_syncTimer->stop();
+    m_lockstepTargetIndex = -1;
+    reportDecode();
+    m_metrics.itemEnded();
+    writePlaybackMetrics();
 }
 
 void MediaPlayer::next()
@@ -160,10 +408,9 @@ void MediaPlayer::next()
     if (!m_playlist.hasItems()) {
         return;
     }
-    // Start fade out before switching if transitions are enabled
+    // Crossfade: the next item starts under a snapshot of this one
     if (m_transitionsEnabled && !m_isFading) {
-        fadeOut();
-        // The actual transition will happen in onFadeOutFinished()
+        startCrossfade();
         return;
     }
 
@@ -182,6 +429,10 @@ void MediaPlayer::next()
     }
 
     int nextIndex = m_playlist.currentIndex + 1;
+    if (m_lockstepTargetIndex >= 0) {
+        nextIndex = m_lockstepTargetIndex;
+        m_lockstepTargetIndex = -1;
+    }
 
     // If this is a special (one-shot) playlist and we've reached the end, finish
     if (m_playlist.isSpecial && nextIndex >= size) {
@@ -203,13 +454,14 @@ void MediaPlayer::next()
         m_player->stop();
     }
     m_imageTimer->stop();
-    m_screenTimer->stop();
+    m_screenCapture->stop();
+    m_streamReceiver->stop();
 
     // Move to next item
     m_playlist.currentIndex = nextIndex;
 
-    // Prefetch the next item after this one
-    prefetchNextItem();
+    // Line up downloads for the items coming after this one
+    schedulePrefetches();
 
     if (m_isPlaying) {
         playCurrentItem();
@@ -227,17 +479,25 @@ void MediaPlayer::playCurrentItem()
     LOG_INFO_CAT(QString("Playing: %1 %2").arg(currentItem.type).arg(currentItem.url), "MediaPlayer");
     
     emit mediaChanged(currentItem);
+    if (m_mediaCache) {
+        m_mediaCache->setPlaylistPosition(m_playlist.currentIndex);
+    }
+    // Before anything below starts loading it; ends the previous item's record
+    reportDecode();
+    m_metrics.itemStarted(currentItem, itemSource(currentItem));
+    writePlaybackMetrics();
+    m_currentMedia = MediaInfo();
+    m_decoderPath.clear();
+    m_decodeReported = false;
+    m_overDecodeBudget = false;
+    m_pendingImageUrl.clear();
+    m_currentImageUrl.clear();
     
-    if (currentItem.type == "video") {
-        // Check cache first
-        QString mediaUrl = currentItem.url;
-        if (m_mediaCache && (mediaUrl.startsWith("http://") || mediaUrl.startsWith("https://"))) {
-            QString cachedPath = m_mediaCache->getCachedPath(mediaUrl);
-            if (!cachedPath.isEmpty()) {
-                mediaUrl = "file://" + cachedPath;
-                LOG_INFO_CAT(QString("Using cached video: %1").arg(cachedPath), "MediaPlayer");
-            }
-        }
+    if (currentItem.type == "video" && m_standbyIndex == m_playlist.currentIndex &&
+        m_standbyItemUrl == currentItem.url) {
+        swapInStandby(currentItem);
+    } else if (currentItem.type == "video") {
+        QString mediaUrl = videoSource(currentItem);
         
         // Properly reset the media player to avoid "partial file" errors on replay
         m_player->stop();
@@ -249,8 +509,9 @@ void MediaPlayer::playCurrentItem()
             m_player->setMedia(QMediaContent());  // Clear media in Qt5
         #endif
         
-        // Reset position
+        // Reset position and any lockstep rate correction from the previous video
         m_player->setPosition(0);
+        m_player->setPlaybackRate(1.0);
         
         // Now set the new source
         SET_MEDIA_SOURCE(m_player, createUrl(mediaUrl));
@@ -259,6 +520,12 @@ void MediaPlayer::playCurrentItem()
         SET_AUDIO_MUTED(m_player, currentItem.muted);
         COMPAT_DEBUG("Video muted:" << currentItem.muted);
         
+        // A playlist of one video loops inside the player, with no reload
+        // (and no EndOfMedia) between passes
+        #ifdef QT6_OR_LATER
+            m_player->setLoops(isSingleVideoLoop() ? QMediaPlayer::Infinite : 1);
+        #endif
+        
         // Start playing
         m_player->play();
         
@@ -276,100 +543,297 @@ void MediaPlayer::playCurrentItem()
     } else if (currentItem.type == "image") {
         showImage();
         loadImage(currentItem.url);
-        startImageTimer(currentItem.duration);
+        
+        // In lockstep mode the sync timer advances at the shared item boundary
+        PlaylistCursor::Position position = lockstepPosition(syncedNowMs());
+        if (position.isValid()) {
+            if (position.index == m_playlist.currentIndex) {
+                m_syncSkewMs = position.offsetMs; // How late this item went on screen
+            }
+        } else {
+            startImageTimer(currentItem.duration);
+        }
     } else if (currentItem.type == "screen") {
         showScreen();
-        // Start screen capture timer (capture every 100ms)
-        m_screenTimer->start(100);
+        m_screenCapture->start(screenTargetSize());
+    } else if (currentItem.type == "stream") {
+        showScreen();
+        m_screenLabel->clear(); // Black until the first frame
+        m_streamReceiver->start(currentItem.url, screenTargetSize());
+        if (currentItem.duration > 0 && !isLockstepActive()) {
+            startImageTimer(currentItem.duration);
+        }
     } else {
         qDebug() << "Unknown media type:" << currentItem.type;
         next(); // Skip unknown types
+        return;
+    }
+    
+    prerollNextVideo();
+    prepareImages();
+}
+
+QString MediaPlayer::videoSource(const MediaItem &item, bool demand)
+{
+    // Check cache first
+    QString mediaUrl = item.url;
+    if (m_mediaCache && (mediaUrl.startsWith("http://") || mediaUrl.startsWith("https://"))) {
+        QString cachedPath = demand ? m_mediaCache->getCachedPath(mediaUrl, item.cacheKey)
+                                    : m_mediaCache->peekCachedPath(mediaUrl, item.cacheKey);
+        if (!cachedPath.isEmpty()) {
+            mediaUrl = "file://" + cachedPath;
+            LOG_INFO_CAT(QString("Using cached video: %1").arg(cachedPath), "MediaPlayer");
+        }
+    }
+    return mediaUrl;
+}
+
+QString MediaPlayer::itemSource(const MediaItem &item) const
+{
+    if (item.type == "screen") {
+        return "capture";
+    }
+    if (item.type == "stream") {
+        return "stream";
+    }
+    if (item.type == "video" && m_standbyIndex == m_playlist.currentIndex && m_standbyItemUrl == item.url) {
+        return "preroll"; // Opened and decoded while the previous item played
+    }
+    if (item.type == "image" && m_imageDecoder->isReady(item.url)) {
+        return "decoded";
+    }
+    if (!item.url.startsWith("http://") && !item.url.startsWith("https://")) {
+        return "local";
+    }
+    return m_mediaCache && m_mediaCache->isCached(item.url, item.cacheKey) ? "cache" : "network";
+}
+
+bool MediaPlayer::isSingleVideoLoop() const
+{
+    return !m_playlist.isSpecial && m_playlist.items.size() == 1 &&
+           m_playlist.items.first().type == "video";
+}
+
+void MediaPlayer::prerollNextVideo()
+{
+    // Only the item that follows in playlist order; after a custom-time or
+    // lockstep jump elsewhere the video loads the usual way
+    int size = m_playlist.items.size();
+    int nextIndex = m_playlist.currentIndex + 1;
+    if (!m_isPlaying || size == 0 || isSingleVideoLoop() || (m_playlist.isSpecial && nextIndex >= size)) {
+        releaseStandby();
+        return;
+    }
+    nextIndex %= size;
+    
+    const MediaItem &item = m_playlist.items.at(nextIndex);
+    if (item.type != "video") {
+        releaseStandby();
+        return;
+    }
+    if (m_standbyIndex == nextIndex && m_standbyItemUrl == item.url) {
+        return; // Already waiting
     }
+    
+    // Paused rather than stopped: the file is opened, probed and its first
+    // frame decoded now, while the current item plays
+    // Not a demand access yet: that is counted when it goes on screen
+    QUrl source = createUrl(videoSource(item, false));
+    SET_MEDIA_SOURCE(m_standbyPlayer, source);
+    m_mediaProbe->request(localFileOf(source)); // Details ready by the time it plays
+    SET_AUDIO_MUTED(m_standbyPlayer, true);
+    m_standbyPlayer->pause();
+    m_standbyIndex = nextIndex;
+    m_standbyItemUrl = item.url;
+    LOG_DEBUG_CAT(QString("Pre-rolling item %1: %2").arg(nextIndex).arg(item.url), "MediaPlayer");
+}
+
+void MediaPlayer::swapInStandby(const MediaItem &item)
+{
+    LOG_DEBUG_CAT(QString("Swapping in pre-rolled video: %1").arg(item.url), "MediaPlayer");
+    if (m_mediaCache && (item.url.startsWith("http://") || item.url.startsWith("https://"))) {
+        m_mediaCache->getCachedPath(item.url, item.cacheKey); // The demand access the preroll deferred
+    }
+    m_waitingForVideoToLoad = false;
+    m_standbyIndex = -1;
+    m_standbyItemUrl.clear();
+    
+    QMediaPlayer *previous = m_player;
+    m_player = m_standbyPlayer;
+    m_standbyPlayer = previous;
+    
+    // Outputs change hands: the new player renders to the screen from its
+    // already decoded first frame, the old one goes back to the preroll sink
+    // (a sink serves one player at a time, hence the detour through nullptr)
+    previous->stop();
+    previous->setVideoOutput(nullptr);
+    m_player->setVideoOutput(m_videoSink);
+    previous->setVideoOutput(m_prerollSink);
+    SET_MEDIA_SOURCE(previous, QUrl());
+    
+    m_player->setPlaybackRate(1.0);
+    SET_AUDIO_MUTED(m_player, item.muted);
+    m_player->play();
+    
+    // Already loaded, so no LoadedMedia will come to do these
+    emit mediaStatusChanged(m_player->mediaStatus());
+    detectMediaProperties();
+    showVideo();
+    if (m_isFading && m_transitionsEnabled) {
+        revealIncoming();
+    }
+    if (isLockstepActive()) {
+        onSyncTimer();
+    }
+}
+
+void MediaPlayer::releaseStandby()
+{
+    if (m_standbyIndex < 0) {
+        return;
+    }
+    m_standbyIndex = -1;
+    m_standbyItemUrl.clear();
+    m_standbyPlayer->stop();
+    SET_MEDIA_SOURCE(m_standbyPlayer, QUrl());
 }
 
 void MediaPlayer::showVideo()
 {
+    if (m_isFading && m_transition->isActive()) {
+        // The video output is a native window and would cover the overlay;
+        // its frames are drawn on the overlay until the fade is done
+        m_videoOnOverlay = true;
+        m_transition->showIncoming(QImage());
+        return;
+    }
     m_layout->setCurrentIndex(VIDEO_WIDGET_INDEX);
 }
 
 void MediaPlayer::showImage()
 {
+    m_videoOnOverlay = false;
     m_layout->setCurrentIndex(IMAGE_WIDGET_INDEX);
 }
 
 void MediaPlayer::showScreen()
 {
+    m_videoOnOverlay = false;
     m_layout->setCurrentIndex(SCREEN_INDEX);
 }
 
 void MediaPlayer::loadImage(const QString &url)
 {
-    // Check cache first for network URLs
-    if (m_mediaCache && (url.startsWith("http://") || url.startsWith("https://"))) {
-        QString cachedPath = m_mediaCache->getCachedPath(url);
-        if (!cachedPath.isEmpty()) {
-            // Load from cache
-            QPixmap pixmap(cachedPath);
-            if (!pixmap.isNull()) {
-                m_currentImage = pixmap;
-                scaleAndSetImage(pixmap);
-                LOG_INFO_CAT(QString("Using cached image: %1").arg(cachedPath), "MediaPlayer");
-                
-                // Detect image properties for cached image
-                detectImageProperties(url);
-                return;
-            }
+    m_pendingImageUrl = url;
+    m_imageDecoder->setTargetSize(imageTargetSize());
+    
+    // The cache lookup that counts as a hit or miss, whether or not the
+    // image was decoded ahead
+    bool network = url.startsWith("http://") || url.startsWith("https://");
+    QString path;
+    if (network && m_mediaCache) {
+        path = m_mediaCache->getCachedPath(url);
+    } else if (!network) {
+        path = localImagePath(url);
+    }
+    
+    // Normally decoded while the previous item was on screen
+    if (m_imageDecoder->isReady(url)) {
+        showDecodedImage(url);
+        return;
+    }
+    
+    // Cached or local: decode now, shown in onImageDecoded()
+    if (!path.isEmpty()) {
+        if (network) {
+            LOG_INFO_CAT(QString("Using cached image: %1").arg(path), "MediaPlayer");
         }
+        m_imageDecoder->request(url, path, imageVersion(url, path));
+        return;
     }
     
-    // If it's a network URL, download the image
+    if (!m_mediaCache) {
+        LOG_ERROR_CAT(QString("No media cache to download image: %1").arg(url), "MediaPlayer");
+        m_pendingImageUrl.clear();
+        return;
+    }
+    // Downloaded into the cache, sharing the transfer if this URL is
+    // already being prefetched; decoded in onImageFetched()
+    m_mediaCache->fetch(url);
+}
+
+void MediaPlayer::showDecodedImage(const QString &url)
+{
+    m_pendingImageUrl.clear();
+    m_currentImageUrl = url;
+    m_currentImageSize = m_imageDecoder->sourceSize(url);
+    m_imageLabel->setPixmap(m_imageDecoder->frame(url));
+    m_metrics.firstFrameShown();
+    if (m_isFading && m_transitionsEnabled) {
+        revealIncoming();
+    }
+    
+    // Detect image properties after loading
+    detectImageProperties(url);
+}
+
+void MediaPlayer::prepareImages()
+{
+    // The current item and the next IMAGE_LOOKAHEAD; anything else is dropped
+    QStringList urls;
+    int size = m_playlist.items.size();
+    for (int step = 0; step <= IMAGE_LOOKAHEAD && step < size; ++step) {
+        const MediaItem &item = m_playlist.items.at((m_playlist.currentIndex + step) % size);
+        if (item.type == "image" && !urls.contains(item.url)) {
+            urls.append(item.url);
+        }
+    }
+    m_imageDecoder->retain(urls);
+    m_imageDecoder->setTargetSize(imageTargetSize());
+    
+    // Images not downloaded yet are requested again after their prefetch completes
+    for (const QString &url : urls) {
+        QString path = localImagePath(url);
+        if (!path.isEmpty()) {
+            m_imageDecoder->request(url, path, imageVersion(url, path));
+        }
+    }
+}
+
+QString MediaPlayer::localImagePath(const QString &url) const
+{
     if (url.startsWith("http://") || url.startsWith("https://")) {
-        QNetworkAccessManager *manager = new QNetworkAccessManager(this);
-        QNetworkRequest request = createNetworkRequest(url);
-        QNetworkReply *reply = manager->get(request);
-        
-        connect(reply, &QNetworkReply::finished, this, [this, reply, url]() {
-            if (reply->error() == QNetworkReply::NoError) {
-                QByteArray imageData = reply->readAll();
-                QPixmap pixmap;
-                if (pixmap.loadFromData(imageData)) {
-                    m_currentImage = pixmap;
-                    scaleAndSetImage(pixmap);
-                    
-                    // Cache the image
-                    if (m_mediaCache) {
-                        m_mediaCache->cacheFile(url, imageData);
-                    }
-                    
-                    // Detect image properties after loading
-                    detectImageProperties(url);
-                } else {
-                    COMPAT_DEBUG("Failed to load image from network data");
-                    LOG_ERROR_CAT("Failed to load image from network data", "MediaPlayer");
-                }
-            } else {
-                HANDLE_NETWORK_ERROR(reply->error(), reply->errorString());
-                LOG_ERROR_CAT(QString("Network error loading image: %1").arg(reply->errorString()), "MediaPlayer");
-            }
-            reply->deleteLater();
-        });
-    } else {
-        // Local file path - handle both absolute and relative paths
-        QString imagePath = convertMediaPath(url);
-        
-        QPixmap pixmap(imagePath);
-        if (!pixmap.isNull()) {
-            m_currentImage = pixmap;
-            scaleAndSetImage(pixmap);
-            COMPAT_DEBUG("Loaded local image:" << imagePath);
-            
-            // Detect image properties after loading
-            detectImageProperties(url);
+        return m_mediaCache ? m_mediaCache->peekCachedPath(url) : QString();
+    }
+    // Local file path - handle both absolute and relative paths
+    return convertMediaPath(url);
+}
+
+QString MediaPlayer::imageVersion(const QString &url, const QString &path) const
+{
+    // What the cache hashed on download; local files go by modification time and size
+    if (m_mediaCache && (url.startsWith("http://") || url.startsWith("https://"))) {
+        return m_mediaCache->contentHash(url);
+    }
+    QFileInfo info(path);
+    return QString("%1-%2").arg(info.lastModified().toMSecsSinceEpoch()).arg(info.size());
+}
+
+QSize MediaPlayer::imageTargetSize() const
+{
+    // Get the available size for the image
+    QSize labelSize = m_imageLabel->size();
+    
+    // If the label doesn't have a size yet (e.g., during initialization), 
+    // use a reasonable default or the parent widget size
+    if (labelSize.width() <= 0 || labelSize.height() <= 0) {
+        if (m_imageLabel->parentWidget()) {
+            labelSize = m_imageLabel->parentWidget()->size();
         } else {
-            COMPAT_DEBUG("Failed to load local image:" << imagePath);
-            LOG_ERROR_CAT(QString("Failed to load local image: %1").arg(imagePath), "MediaPlayer");
+            labelSize = QSize(800, 600); // Fallback size
         }
     }
+    return labelSize;
 }
 
 void MediaPlayer::startImageTimer(int durationMs)
@@ -385,6 +849,9 @@ void MediaPlayer::startImageTimer(int durationMs)
 
 void MediaPlayer::onImageTimerFinished()
 {
+    if (isLockstepActive()) {
+        return; // Boundaries are driven by the sync timer
+    }
     COMPAT_DEBUG("Image timer finished, moving to next");
     next();
 }
@@ -417,49 +884,42 @@ void MediaPlayer::checkScheduledItems()
             // Stop current playback and start the scheduled item
             m_player->stop();
             m_imageTimer->stop();
-            m_screenTimer->stop();
+            m_screenCapture->stop();
+            m_streamReceiver->stop();
             playCurrentItem();
             return;
         }
     }
 }
 
-void MediaPlayer::scaleAndSetImage(const QPixmap &originalPixmap)
+void MediaPlayer::rescaleCurrentImage()
 {
-    if (originalPixmap.isNull()) {
-        return;
+    if (m_screenCapture->isActive()) {
+        m_screenCapture->setTargetSize(screenTargetSize());
     }
-    
-    // Get the available size for the image
-    QSize labelSize = m_imageLabel->size();
-    
-    // If the label doesn't have a size yet (e.g., during initialization), 
-    // use a reasonable default or the parent widget size
-    if (labelSize.width() <= 0 || labelSize.height() <= 0) {
-        if (m_imageLabel->parentWidget()) {
-            labelSize = m_imageLabel->parentWidget()->size();
-        } else {
-            labelSize = QSize(800, 600); // Fallback size
-        }
+    if (m_streamReceiver->isActive()) {
+        m_streamReceiver->setTargetSize(screenTargetSize());
     }
-    
-    // Scale the image to fit within the available space while maintaining aspect ratio
-    QPixmap scaledPixmap = originalPixmap.scaled(labelSize, 
-                                               Qt::KeepAspectRatio, 
-                                               Qt::SmoothTransformation);
-    
-    m_imageLabel->setPixmap(scaledPixmap);
-}
-
-void MediaPlayer::rescaleCurrentImage()
-{
-    if (!m_currentImage.isNull()) {
-        scaleAndSetImage(m_currentImage);
+    if (m_currentImageUrl.isEmpty()) {
+        return;
+    }
+    // A new size invalidates the decoded frames; the old one stays up until
+    // its replacement is ready
+    m_imageDecoder->setTargetSize(imageTargetSize());
+    if (m_imageDecoder->isReady(m_currentImageUrl)) {
+        showDecodedImage(m_currentImageUrl);
+    } else {
+        m_pendingImageUrl = m_currentImageUrl;
     }
 }
 
 void MediaPlayer::onVideoFinished()
 {
+    if (isLockstepActive()) {
+        // Hold the last frame until the shared boundary rather than running ahead
+        onSyncTimer();
+        return;
+    }
     COMPAT_DEBUG("Video finished, moving to next");
     next();
 }
@@ -474,19 +934,23 @@ void MediaPlayer::onVideoStateChanged(QMediaPlayer::PlaybackState state)
     }
 }
 
-void MediaPlayer::onScreenCaptureTimer()
+QSize MediaPlayer::screenTargetSize() const
 {
-    captureScreen();
+    // Screen frames are scaled to fit the label while maintaining aspect ratio
+    QSize labelSize = m_screenLabel->size();
+    if (labelSize.width() <= 0 || labelSize.height() <= 0) {
+        if (m_screenLabel->parentWidget()) {
+            labelSize = m_screenLabel->parentWidget()->size();
+        } else {
+            labelSize = QSize(800, 600); // Fallback size
+        }
+    }
+    return labelSize;
 }
 
-void MediaPlayer::captureScreen()
+void MediaPlayer::onCaptureFailed(ScreenCaptureEngine::Failure failure)
 {
-    qDebug() << "Attempting screen capture...";
-
-    // Get the primary screen
-    QScreen *screen = QGuiApplication::primaryScreen();
-    if (!screen) {
-        qDebug() << "ERROR: No primary screen found for screen capture";
+    if (failure == ScreenCaptureEngine::NoScreen) {
         // Fallback: create a placeholder image
         QPixmap placeholder(800, 600);
         placeholder.fill(Qt::black);
@@ -498,18 +962,8 @@ void MediaPlayer::captureScreen()
         return;
     }
 
-    qDebug() << "Primary screen found:" << screen->name() << "size:" << screen->size();
-
-    // Check display server type
-    QString sessionType = qgetenv("XDG_SESSION_TYPE");
-    bool isWayland = (sessionType == "wayland");
-
-    qDebug() << "Display server type:" << sessionType;
-
     // On Wayland, screen capture is restricted by design for security
-    if (isWayland) {
-        qDebug() << "Wayland detected - screen capture not supported with Qt";
-
+    if (failure == ScreenCaptureEngine::Wayland) {
         // Create helpful error message for Wayland
         QPixmap placeholder(800, 600);
         placeholder.fill(Qt::darkBlue);
@@ -533,136 +987,104 @@ void MediaPlayer::captureScreen()
         return;
     }
 
-    // Try screen capture (should work on X11)
-    QPixmap screenshot = screen->grabWindow(0);
-    if (screenshot.isNull()) {
-        qDebug() << "Screen capture failed on X11";
-
-        // Create error placeholder for X11 issues
-        QPixmap placeholder(800, 600);
-        placeholder.fill(Qt::darkRed);
-        QPainter painter(&placeholder);
-        painter.setPen(Qt::white);
-        painter.setFont(QFont("SF Pro Display", 16));
-
-        QString x11Message =
-            "Screen Capture Failed\n\n"
-            "Running on X11 but capture failed.\n"
-            "Possible causes:\n"
-            "• Missing X11 permissions\n"
-            "• Compositor restrictions\n"
-            "• Display access issues\n\n"
-            "Check X11 configuration.";
-
-        painter.drawText(placeholder.rect(), Qt::AlignCenter, x11Message);
-        m_screenLabel->setPixmap(placeholder.scaled(m_screenLabel->size(), Qt::KeepAspectRatio, Qt::SmoothTransformation));
-        return;
-    }
-
-    qDebug() << "Screen captured successfully, size:" << screenshot.size();
+    // Create error placeholder for X11 issues
+    QPixmap placeholder(800, 600);
+    placeholder.fill(Qt::darkRed);
+    QPainter painter(&placeholder);
+    painter.setPen(Qt::white);
+    painter.setFont(QFont("SF Pro Display", 16));
+
+    QString x11Message =
+        "Screen Capture Failed\n\n"
+        "Running on X11 but capture failed.\n"
+        "Possible causes:\n"
+        "• Missing X11 permissions\n"
+        "• Compositor restrictions\n"
+        "• Display access issues\n\n"
+        "Check X11 configuration.";
+
+    painter.drawText(placeholder.rect(), Qt::AlignCenter, x11Message);
+    m_screenLabel->setPixmap(placeholder.scaled(m_screenLabel->size(), Qt::KeepAspectRatio, Qt::SmoothTransformation));
+}
 
-    // Scale the screenshot to fit the label while maintaining aspect ratio
-    QSize labelSize = m_screenLabel->size();
-    if (labelSize.width() <= 0 || labelSize.height() <= 0) {
-        if (m_screenLabel->parentWidget()) {
-            labelSize = m_screenLabel->parentWidget()->size();
-        } else {
-            labelSize = QSize(800, 600); // Fallback size
+void MediaPlayer::startCrossfade()
+{
+    m_isFading = true;
+    LOG_DEBUG_CAT("Starting crossfade", "MediaPlayer");
+    
+    // Taken once; nothing is re-rendered from the outgoing item after this
+    QPixmap outgoing = snapshotCurrent();
+    if (!outgoing.isNull()) {
+        m_transition->hold(outgoing, m_fadeDuration);
+        if (m_layout->currentIndex() == VIDEO_INDEX) {
+            // Out from under the overlay; the snapshot covers the image page
+            m_layout->setCurrentIndex(IMAGE_INDEX);
         }
     }
-
-    QPixmap scaledScreenshot = screenshot.scaled(labelSize,
-                                               Qt::KeepAspectRatio,
-                                               Qt::SmoothTransformation);
-
-    m_screenLabel->setPixmap(scaledScreenshot);
-    qDebug() << "Screen displayed on label, scaled to:" << scaledScreenshot.size();
+    advanceUnderSnapshot();
 }
 
-void MediaPlayer::fadeOut()
+QPixmap MediaPlayer::snapshotCurrent() const
 {
-    if (m_isFading) return;
+    QWidget *area = m_layout->parentWidget();
+    if (!area || area->size().isEmpty()) {
+        return QPixmap();
+    }
     
-    m_isFading = true;
-    LOG_DEBUG_CAT("Starting fade out", "MediaPlayer");
-    
-    // Determine which widget is currently visible
-    QGraphicsOpacityEffect *effect = nullptr;
-    int currentIndex = m_layout->currentIndex();
-    
-    if (currentIndex == VIDEO_INDEX) {
-        effect = m_videoOpacity;
-    } else if (currentIndex == IMAGE_INDEX) {
-        effect = m_imageOpacity;
-    } else if (currentIndex == SCREEN_INDEX) {
-        effect = m_screenOpacity;
-    }
-    
-    if (effect) {
-        m_fadeAnimation->setTargetObject(effect);
-        m_fadeAnimation->setPropertyName("opacity");
-        m_fadeAnimation->setStartValue(1.0);
-        m_fadeAnimation->setEndValue(0.0);
-        m_fadeAnimation->setDuration(m_fadeDuration);
-        
-        disconnect(m_fadeAnimation, &QPropertyAnimation::finished, 
-                   this, &MediaPlayer::onFadeInFinished);
-        connect(m_fadeAnimation, &QPropertyAnimation::finished, 
-                this, &MediaPlayer::onFadeOutFinished);
-        
-        m_fadeAnimation->start();
-    } else {
-        // No effect, just transition directly
-        m_isFading = false;
-        onFadeOutFinished();
+    if (m_layout->currentIndex() == VIDEO_INDEX) {
+        // Video widgets can't be grabbed, their frames never pass through
+        // the widget's backing store; take the sink's last frame instead
+        QVideoSink *sink = m_player->videoSink();
+        QImage frame = fitToArea(sink ? sink->videoFrame().toImage() : QImage());
+        return frame.isNull() ? QPixmap() : QPixmap::fromImage(frame);
     }
+    
+    // Image and screen labels are plain widgets
+    QWidget *current = m_layout->currentWidget();
+    return current ? current->grab() : QPixmap();
 }
 
-void MediaPlayer::fadeIn()
+QImage MediaPlayer::fitToArea(const QImage &frame) const
 {
-    LOG_DEBUG_CAT("Starting fade in", "MediaPlayer");
-    
-    // Determine which widget is now visible
-    QGraphicsOpacityEffect *effect = nullptr;
-    int currentIndex = m_layout->currentIndex();
-    
-    if (currentIndex == VIDEO_INDEX) {
-        effect = m_videoOpacity;
-    } else if (currentIndex == IMAGE_INDEX) {
-        effect = m_imageOpacity;
-    } else if (currentIndex == SCREEN_INDEX) {
-        effect = m_screenOpacity;
+    QWidget *area = m_layout->parentWidget();
+    if (frame.isNull() || !area || area->size().isEmpty()) {
+        return QImage();
     }
-    
-    if (effect) {
-        // Opacity should already be 0 from onFadeOutFinished
-        m_fadeAnimation->setTargetObject(effect);
-        m_fadeAnimation->setPropertyName("opacity");
-        m_fadeAnimation->setStartValue(0.0);
-        m_fadeAnimation->setEndValue(1.0);
-        m_fadeAnimation->setDuration(m_fadeDuration);
-        
-        disconnect(m_fadeAnimation, &QPropertyAnimation::finished, 
-                   this, &MediaPlayer::onFadeOutFinished);
-        connect(m_fadeAnimation, &QPropertyAnimation::finished, 
-                this, &MediaPlayer::onFadeInFinished);
-        
-        m_fadeAnimation->start();
-    } else {
-        m_isFading = false;
+    if (m_wall.isEnabled()) {
+        return renderWallTile(frame, m_wall, area->size());
     }
+    QImage letterboxed(area->size(), QImage::Format_RGB32);
+    letterboxed.fill(Qt::black);
+    QSize fitted = frame.size().scaled(area->size(), Qt::KeepAspectRatio);
+    QPainter painter(&letterboxed);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+    painter.drawImage(QRect(QPoint((area->width() - fitted.width()) / 2,
+                                   (area->height() - fitted.height()) / 2), fitted), frame);
+    painter.end();
+    return letterboxed;
 }
 
-void MediaPlayer::onFadeOutFinished()
+void MediaPlayer::revealIncoming()
+{
+    LOG_DEBUG_CAT("Revealing incoming item", "MediaPlayer");
+    m_metrics.fadeStarted();
+    m_transition->reveal(); // finished() right away if there was no snapshot
+}
+
+void MediaPlayer::advanceUnderSnapshot()
 {
-    LOG_DEBUG_CAT("Fade out finished", "MediaPlayer");
     // Compute next index
     int size = m_playlist.items.size();
     int nextIndex = m_playlist.currentIndex + 1;
+    if (m_lockstepTargetIndex >= 0) {
+        nextIndex = m_lockstepTargetIndex;
+        m_lockstepTargetIndex = -1;
+    }
 
     // If this is a special (one-shot) playlist and we've reached the end, finish
     if (m_playlist.isSpecial && nextIndex >= size) {
         LOG_INFO_CAT("Special playlist finished (during fade)", "MediaPlayer");
+        m_transition->cancel();
         m_isFading = false;
         m_isPlaying = false;
         emit playlistFinished();
@@ -677,71 +1099,132 @@ void MediaPlayer::onFadeOutFinished()
     // Move to next
     m_playlist.currentIndex = nextIndex;
 
-    // Prefetch the next item after this one
-    prefetchNextItem();
+    // Line up downloads for the items coming after this one
+    schedulePrefetches();
 
-    if (m_isPlaying) {
-        const MediaItem &nextItem = m_playlist.getCurrentItem();
+    if (!m_isPlaying) {
+        m_transition->cancel();
+        m_isFading = false;
+        return;
+    }
+    
+    const MediaItem &nextItem = m_playlist.getCurrentItem();
 
-        // Only stop player if NOT transitioning to a video (to avoid blank screen)
-        if (nextItem.type != "video") {
-            m_player->stop();
-        }
-        m_imageTimer->stop();
-        m_screenTimer->stop();
-
-        // Pre-set the NEXT widget's opacity to 0 before switching
-        if (m_transitionsEnabled) {
-            if (nextItem.type == "video") {
-                m_videoOpacity->setOpacity(0.0);
-            } else if (nextItem.type == "image") {
-                m_imageOpacity->setOpacity(0.0);
-            } else if (nextItem.type == "screen") {
-                m_screenOpacity->setOpacity(0.0);
-            }
-        }
+    // Only stop player if NOT transitioning to a video (to avoid blank screen)
+    if (nextItem.type != "video") {
+        m_player->stop();
+    }
+    m_imageTimer->stop();
+    m_screenCapture->stop();
+    m_streamReceiver->stop();
 
-        playCurrentItem();
+    playCurrentItem();
 
-        // Start fade in (unless it's a video - video will fade in when loaded)
-        if (m_transitionsEnabled) {
-            if (nextItem.type != "video") {
-                fadeIn();
-            }
-            // For videos, fadeIn() will be called from mediaStatusChanged when LoadedMedia
-        } else {
-            m_isFading = false;
-        }
-    } else {
-        m_isFading = false;
+    // Crossfade once the incoming item is on screen: videos when loaded
+    // (mediaStatusChanged), images when decoded (showDecodedImage()),
+    // streams on their first frame
+    if (nextItem.type == "screen" || (nextItem.type == "image" && m_pendingImageUrl.isEmpty())) {
+        revealIncoming();
     }
 }
 
-void MediaPlayer::onFadeInFinished()
+void MediaPlayer::onCrossfadeFinished()
 {
-    LOG_DEBUG_CAT("Fade in finished", "MediaPlayer");
+    LOG_DEBUG_CAT("Crossfade finished", "MediaPlayer");
     m_isFading = false;
+    if (m_videoOnOverlay) {
+        m_videoOnOverlay = false;
+        showVideo();
+    }
+    m_metrics.fadeFinished();
 }
 
-void MediaPlayer::prefetchNextItem()
+void MediaPlayer::schedulePrefetches()
 {
-    if (!m_mediaCache || !m_playlist.hasItems()) {
+    if (!m_prefetchScheduler || !m_playlist.hasItems()) {
         return;
     }
     
-    // Calculate next index
-    int nextIndex = (m_playlist.currentIndex + 1) % m_playlist.items.size();
+    // Time until the current item ends: exact in lockstep, otherwise we're
+    // called as it starts so its whole duration is left
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    PlaylistCursor::Position position = lockstepPosition(syncedNowMs());
+    qint64 startsIn = position.isValid() ? position.remainingMs
+                                         : itemDurationMs(m_playlist.getCurrentItem());
     
-    if (nextIndex < m_playlist.items.size()) {
-        const MediaItem &nextItem = m_playlist.items[nextIndex];
+    // Walk forward once around the playlist (or to its end for one-shot
+    // playlists), giving each network item the time it goes on screen.
+    // Unknown durations count as zero, which only makes deadlines earlier.
+    QList<PrefetchJob> jobs;
+    int size = m_playlist.items.size();
+    for (int step = 1; step < size && startsIn <= PREFETCH_HORIZON_MS; ++step) {
+        int index = m_playlist.currentIndex + step;
+        if (index >= size) {
+            if (m_playlist.isSpecial) {
+                break;
+            }
+            index %= size;
+        }
+        const MediaItem &item = m_playlist.items[index];
         
         // Only prefetch network URLs for videos and images
-        if ((nextItem.type == "video" || nextItem.type == "image") &&
-            (nextItem.url.startsWith("http://") || nextItem.url.startsWith("https://"))) {
-            
-            LOG_DEBUG_CAT(QString("Prefetching next item: %1").arg(nextItem.url), "MediaPlayer");
-            m_mediaCache->prefetchUrl(nextItem.url);
+        if ((item.type == "video" || item.type == "image") &&
+            (item.url.startsWith("http://") || item.url.startsWith("https://"))) {
+            PrefetchJob job;
+            job.url = item.url;
+            job.cacheKey = item.cacheKey;
+            job.deadlineMs = now + startsIn;
+            jobs.append(job);
+        }
+        startsIn += itemDurationMs(item);
+    }
+    
+    m_prefetchScheduler->plan(jobs);
+}
+
+PrefetchStats MediaPlayer::getPrefetchStats() const
+{
+    return m_prefetchScheduler ? m_prefetchScheduler->stats() : PrefetchStats();
+}
+
+bool MediaPlayer::writePlaybackMetrics() const
+{
+    return !m_metricsPath.isEmpty() && m_metrics.writeJson(m_metricsPath);
+}
+
+void MediaPlayer::onImageFetched(const QString &url, const QString &localPath)
+{
+    if (url != m_pendingImageUrl) {
+        return; // Playback has moved on
+    }
+    
+    if (localPath.isEmpty()) {
+        LOG_ERROR_CAT(QString("Network error loading image: %1").arg(url), "MediaPlayer");
+        m_pendingImageUrl.clear();
+        return;
+    }
+    m_imageDecoder->request(url, localPath, imageVersion(url, localPath));
+}
+
+void MediaPlayer::onImageDecoded(const QString &url, bool ok)
+{
+    if (url != m_pendingImageUrl) {
+        return; // Decoded ahead of its turn, or playback has moved on
+    }
+    if (ok) {
+        showDecodedImage(url);
+        return;
+    }
+    
+    m_pendingImageUrl.clear();
+    if (url.startsWith("http://") || url.startsWith("https://")) {
+        // Corrupt or truncated: quarantined by the cache and fetched again
+        LOG_WARNING_CAT(QString("Cached image failed to decode: %1").arg(url), "MediaPlayer");
+        if (m_mediaCache) {
+            m_mediaCache->verify(MediaCache::cacheKeyFor(url));
         }
+    } else {
+        LOG_ERROR_CAT(QString("Failed to load local image: %1").arg(convertMediaPath(url)), "MediaPlayer");
     }
 }
 
@@ -749,6 +1232,9 @@ void MediaPlayer::onPrefetchComplete(const QString &url, bool success)
 {
     if (success) {
         LOG_INFO_CAT(QString("Prefetch successful: %1").arg(url), "MediaPlayer");
+        if (m_isPlaying) {
+            prepareImages(); // It may be one of the next few
+        }
     } else {
         LOG_WARNING_CAT(QString("Prefetch failed: %1").arg(url), "MediaPlayer");
     }
@@ -756,65 +1242,71 @@ void MediaPlayer::onPrefetchComplete(const QString &url, bool success)
 
 void MediaPlayer::detectMediaProperties()
 {
-    // Detect codec and hardware acceleration
-    // Note: QMediaPlayer doesn't provide direct access to codec info in Qt5/6
-    // This is a placeholder for future enhancement or platform-specific implementation
-    
-    m_currentCodec = "unknown";
-    m_hwDecodeEnabled = false;
+    // The container says what the stream is; the backend's metadata covers
+    // what MediaProbe can't parse (WebM, AVI, uncached network URLs). The
+    // decoder in use shows in the frames (see decoderPathOf()), so until the
+    // first one arrives it is unknown.
+    #ifdef QT6_OR_LATER
+        QString path = localFileOf(m_player->source());
+    #else
+        QString path = localFileOf(m_player->media().request().url());
+    #endif
+    if (!path.isEmpty() && !m_mediaProbe->hasInfo(path)) {
+        m_mediaProbe->request(path); // Back here from probed()
+    }
+    MediaInfo info = m_mediaProbe->info(path);
     
-    // Try to get video size and frame rate
     #ifdef QT6_OR_LATER
-        // Qt6 has better metaData support
         QMediaMetaData metadata = m_player->metaData();
-        if (metadata.value(QMediaMetaData::Key::Resolution).isValid()) {
-            QSize resolution = metadata.value(QMediaMetaData::Key::Resolution).toSize();
-            m_currentResolution = QString("%1x%2").arg(resolution.width()).arg(resolution.height());
+        if (info.codec.isEmpty()) {
+            QMediaFormat::VideoCodec codec = metadata.value(QMediaMetaData::Key::VideoCodec).value<QMediaFormat::VideoCodec>();
+            if (codec != QMediaFormat::VideoCodec::Unspecified) {
+                info.codec = QMediaFormat::videoCodecName(codec);
+            }
+        }
+        if (!info.resolution.isValid()) {
+            info.resolution = metadata.value(QMediaMetaData::Key::Resolution).toSize();
         }
-        if (metadata.value(QMediaMetaData::Key::VideoFrameRate).isValid()) {
-            m_currentFps = metadata.value(QMediaMetaData::Key::VideoFrameRate).toReal();
+        if (info.fps <= 0.0) {
+            info.fps = metadata.value(QMediaMetaData::Key::VideoFrameRate).toReal();
+        }
+        if (info.bitrateBps <= 0) {
+            info.bitrateBps = metadata.value(QMediaMetaData::Key::VideoBitRate).toLongLong();
         }
     #else
         // Qt5 metadata access
         if (m_player->isMetaDataAvailable()) {
-            QSize resolution = m_player->metaData("Resolution").toSize();
-            if (resolution.isValid()) {
-                m_currentResolution = QString("%1x%2").arg(resolution.width()).arg(resolution.height());
+            if (!info.resolution.isValid()) {
+                info.resolution = m_player->metaData("Resolution").toSize();
+            }
+            if (info.fps <= 0.0) {
+                info.fps = m_player->metaData("VideoFrameRate").toReal();
             }
-            m_currentFps = m_player->metaData("VideoFrameRate").toReal();
         }
     #endif
     
-    // Check for VAAPI or other hardware acceleration hints
-    // GStreamer will use VAAPI automatically if available
-    QString mediaBackend = qgetenv("QT_MEDIA_BACKEND");
-    QString vaDriver = qgetenv("LIBVA_DRIVER_NAME");
-    QString vdpauDriver = qgetenv("VDPAU_DRIVER");
-    
-    // Assume hardware decode if using GStreamer with VAAPI driver
-    if (mediaBackend == "gstreamer" && !vaDriver.isEmpty()) {
-        m_hwDecodeEnabled = true;
-        m_currentCodec = QString("H.264 (VAAPI-%1)").arg(vaDriver);
-    } 
-    // Or if backend explicitly mentions hardware decode
-    else if (mediaBackend.contains("vaapi") || mediaBackend.contains("nvdec") || mediaBackend.contains("vdpau")) {
-        m_hwDecodeEnabled = true;
-        m_currentCodec = mediaBackend;
-    }
-    // Or if VDPAU is configured
-    else if (!vdpauDriver.isEmpty()) {
-        m_hwDecodeEnabled = true;
-        m_currentCodec = QString("H.264 (VDPAU-%1)").arg(vdpauDriver);
-    }
-    // Otherwise assume software decode
-    else if (mediaBackend == "ffmpeg" || mediaBackend == "gstreamer") {
-        m_currentCodec = QString("H.264 (%1-sw)").arg(mediaBackend);
-        m_hwDecodeEnabled = false;
-    }
-    
-    LOG_DEBUG_CAT(QString("Media properties - Codec: %1, HW: %2, Resolution: %3, FPS: %4")
+    m_currentMedia = info;
+    m_currentCodec = info.summary();
+    m_hwDecodeEnabled = m_decoderPath == "hardware"; // Not claimed on a guess
+    if (info.resolution.isValid()) {
+        m_currentResolution = QString("%1x%2").arg(info.resolution.width()).arg(info.resolution.height());
+    }
+    m_currentFps = info.fps;
+    // Frames further apart than the rate allows are counted as late
+    m_metrics.setNominalFrameRate(info.fps);
+    
+    // Something this costly has played late on this decoder before
+    if (!m_overDecodeBudget && m_decodeBudget.exceeds(m_decoderPath, info.pixelRate())) {
+        m_overDecodeBudget = true;
+        LOG_WARNING_CAT(QString("%1 (%2 at %3 fps) is over this display's %4 decode budget")
+            .arg(m_playlist.getCurrentItem().url, m_currentResolution)
+            .arg(info.fps, 0, 'f', 1)
+            .arg(m_decoderPath), "MediaPlayer");
+    }
+    
+    LOG_DEBUG_CAT(QString("Media properties - Codec: %1, Decoder: %2, Resolution: %3, FPS: %4")
         .arg(m_currentCodec)
-        .arg(m_hwDecodeEnabled ? "Yes" : "No")
+        .arg(m_decoderPath.isEmpty() ? "pending" : m_decoderPath)
         .arg(m_currentResolution)
         .arg(m_currentFps), "MediaPlayer");
     
@@ -822,18 +1314,42 @@ void MediaPlayer::detectMediaProperties()
     emit codecDetected(m_currentCodec, m_hwDecodeEnabled);
 }
 
+void MediaPlayer::reportDecode()
+{
+    if (!m_metrics.hasCurrent() || m_metrics.current().type != "video" || m_decoderPath.isEmpty() ||
+        m_decodeReported) {
+        return;
+    }
+    m_decodeReported = true; // Once per item, or the budget would count its frames twice
+    const ItemPlayback &item = m_metrics.current();
+    m_decodeBudget.record(m_decoderPath, m_currentMedia.pixelRate(), item.frames, item.lateFrames);
+    if (!m_overDecodeBudget && m_decodeBudget.playedLate(item.frames, item.lateFrames)) {
+        m_overDecodeBudget = true;
+        LOG_WARNING_CAT(QString("%1: %2 of %3 frames late on the %4 decoder")
+            .arg(item.url)
+            .arg(item.lateFrames)
+            .arg(item.frames)
+            .arg(m_decoderPath), "MediaPlayer");
+    }
+    
+    QJsonObject report = m_currentMedia.toJson();
+    report["url"] = item.url;
+    report["decoder"] = m_decoderPath;
+    report["frames"] = item.frames;
+    report["lateFrames"] = item.lateFrames;
+    report["overBudget"] = m_overDecodeBudget;
+    report["budget"] = m_decodeBudget.toJson();
+    emit decodeReport(report);
+}
+
 void MediaPlayer::detectImageProperties(const QString &url)
 {
-    // Detect image format from URL or cached file
+    // Detect image format from the URL; cached files are named by hash and
+    // have no extension, so there's no point looking them up again
     QString imagePath = url;
-    
-    // If it's a network URL, try to get from cache
-    if (m_mediaCache && (url.startsWith("http://") || url.startsWith("https://"))) {
-        QString cachedPath = m_mediaCache->getCachedPath(url);
-        if (!cachedPath.isEmpty()) {
-            imagePath = cachedPath;
-        }
-    } else if (!url.startsWith("http")) {
+    if (url.startsWith("http://") || url.startsWith("https://")) {
+        imagePath = QUrl(url).path();
+    } else {
         imagePath = convertMediaPath(url);
     }
     
@@ -854,8 +1370,8 @@ void MediaPlayer::detectImageProperties(const QString &url)
     }
     
     // Get image size if available
-    if (!m_currentImage.isNull()) {
-        m_currentResolution = QString("%1x%2").arg(m_currentImage.width()).arg(m_currentImage.height());
+    if (m_currentImageSize.isValid()) {
+        m_currentResolution = QString("%1x%2").arg(m_currentImageSize.width()).arg(m_currentImageSize.height());
     } else {
         m_currentResolution = "unknown";
     }
@@ -871,3 +1387,150 @@ void MediaPlayer::detectImageProperties(const QString &url)
     // Emit codec information for status bar
     emit codecDetected(m_currentCodec, m_hwDecodeEnabled);
 }
+
+qint64 MediaPlayer::syncedNowMs() const
+{
+    if (m_timeSource) {
+        return m_timeSource->getCurrentDateTime().toMSecsSinceEpoch();
+    }
+    return QDateTime::currentMSecsSinceEpoch();
+}
+
+qint64 MediaPlayer::itemDurationMs(const MediaItem &item) const
+{
+    if (item.type == "image") {
+        return item.duration > 0 ? item.duration : 5000; // Same default as startImageTimer
+    }
+    if (item.duration > 0) {
+        return item.duration;
+    }
+    if (item.type == "video") {
+        return m_videoDurations.value(item.url, 0);
+    }
+    return 0; // Continuous items (screen) can't be scheduled
+}
+
+void MediaPlayer::rebuildCursor()
+{
+    QList<qint64> durations;
+    durations.reserve(m_playlist.items.size());
+    for (const MediaItem &item : m_playlist.items) {
+        durations.append(itemDurationMs(item));
+    }
+    m_cursor.rebuild(durations);
+}
+
+void MediaPlayer::recordVideoDuration(const QString &url, qint64 durationMs)
+{
+    m_videoDurations[url] = durationMs;
+    rebuildCursor();
+    if (m_timeSource) {
+        m_timeSource->saveCachedDurations(m_videoDurations);
+    }
+}
+
+PlaylistCursor::Position MediaPlayer::lockstepPosition(qint64 syncedMs) const
+{
+    if (!m_timeSource || m_timeSource->isUsingTestDateTime() ||
+        m_playlist.epochMs <= 0 || m_playlist.isSpecial) {
+        return PlaylistCursor::Position();
+    }
+    // Invalid until every item has a known duration
+    return m_cursor.positionAt(m_playlist.epochMs, syncedMs);
+}
+
+bool MediaPlayer::isLockstepActive() const
+{
+    return lockstepPosition(syncedNowMs()).isValid();
+}
+
+void MediaPlayer::onSyncTimer()
+{
+    if (!m_isPlaying) {
+        return;
+    }
+    
+    qint64 now = syncedNowMs();
+    PlaylistCursor::Position position = lockstepPosition(now);
+    if (!position.isValid()) {
+        return; // Lockstep no longer possible, local timers take over from the next item
+    }
+    
+    // A crossfade starts the incoming item at once, so advance right at the boundary
+    if (position.index != m_playlist.currentIndex) {
+        if (!m_isFading) {
+            LOG_DEBUG_CAT(QString("Advancing to item %1 at shared boundary").arg(position.index), "Sync");
+            m_lockstepTargetIndex = position.index;
+            next();
+        }
+    } else if (m_playlist.getCurrentItem().type == "video" &&
+               !m_waitingForVideoToLoad &&
+               m_player->playbackState() == QMediaPlayer::PlayingState) {
+        correctVideoPosition(position.offsetMs);
+    }
+    
+    // Re-arm for the next periodic check, or exactly at the next transition if sooner
+    m_syncTimer->start(static_cast<int>(qBound<qint64>(1, position.remainingMs, m_syncIntervalMs)));
+}
+
+void MediaPlayer::correctVideoPosition(qint64 expectedOffsetMs)
+{
+    qint64 position = m_player->position();
+    qint64 skew = position - expectedOffsetMs; // Positive: we are ahead
+    m_syncSkewMs = skew;
+    
+    // Periodic trace, parsed by scripts/wall_skew_test.sh to measure skew between displays
+    qint64 now = syncedNowMs();
+    if (now - m_lastSyncLogMs >= 1000) {
+        m_lastSyncLogMs = now;
+        LOG_DEBUG_CAT(QString("Position item=%1 expected=%2 actual=%3 skew=%4 at=%5")
+            .arg(m_playlist.currentIndex)
+            .arg(expectedOffsetMs)
+            .arg(position)
+            .arg(skew)
+            .arg(now), "Sync");
+    }
+    
+    if (qAbs(skew) > SEEK_THRESHOLD_MS) {
+        LOG_DEBUG_CAT(QString("Skew %1ms, seeking to %2ms").arg(skew).arg(expectedOffsetMs), "Sync");
+        m_player->setPosition(expectedOffsetMs);
+        m_player->setPlaybackRate(1.0);
+    } else if (qAbs(skew) > m_frameBudgetMs) {
+        // Small errors are pulled in by running up to 5% fast/slow, which is
+        // invisible, instead of a seek which would stutter
+        qreal rate = 1.0 - qBound(-0.05, skew / 2000.0, 0.05);
+        if (!qFuzzyCompare(rate, m_player->playbackRate())) {
+            m_player->setPlaybackRate(rate);
+        }
+    } else if (!qFuzzyCompare(m_player->playbackRate(), 1.0)) {
+        m_player->setPlaybackRate(1.0);
+    }
+}
+
+void MediaPlayer::probeVideoDurations()
+{
+    if (!m_probingUrl.isEmpty()) {
+        return; // One probe at a time
+    }
+    
+    for (const MediaItem &item : m_playlist.items) {
+        if (item.type != "video" || item.duration > 0 || m_videoDurations.contains(item.url) ||
+            m_probeFailed.contains(item.url)) {
+            continue;
+        }
+        
+        // Not a demand access: probing mustn't count as a hit or refresh recency
+        QString mediaUrl = item.url;
+        if (m_mediaCache && (mediaUrl.startsWith("http://") || mediaUrl.startsWith("https://"))) {
+            QString cachedPath = m_mediaCache->peekCachedPath(mediaUrl, item.cacheKey);
+            if (!cachedPath.isEmpty()) {
+                mediaUrl = "file://" + cachedPath;
+            }
+        }
+        
+        m_probingUrl = item.url;
+        LOG_DEBUG_CAT(QString("Probing duration: %1").arg(item.url), "Sync");
+        SET_MEDIA_SOURCE(m_durationProbe, createUrl(mediaUrl));
+        return;
+    }
+}
@@ -5,15 +5,25 @@
 #include <QTimer>
 #include <QMediaPlayer>
 #include <QVideoWidget>
+#include <QVideoSink>
 #include <QLabel>
 #include <QStackedLayout>
 #include <QScreen>
 #include <QGuiApplication>
 #include <QString>
-#include <QGraphicsOpacityEffect>
-#include <QPropertyAnimation>
+#include <QHash>
+#include <QSet>
 #include "qt6compat.h"
 #include "networkclient.h"
+#include "videowall.h"
+#include "playlistcursor.h"
+#include "prefetchscheduler.h"
+#include "imagedecodepool.h"
+#include "transitionoverlay.h"
+#include "screencaptureengine.h"
+#include "streamreceiver.h"
+#include "playbackmetrics.h"
+#include "mediaprobe.h"
 
 class MediaCache;
 
@@ -23,9 +33,15 @@ class MediaPlayer : public QObject
 
 public:
     explicit MediaPlayer(QVideoWidget *videoOutput, QLabel *imageLabel, QStackedLayout *layout, QObject *parent = nullptr);
+    // videoWidget is the widget shown for videos, videoSink what QMediaPlayer renders into
+    MediaPlayer(QWidget *videoWidget, QObject *videoSink, QLabel *imageLabel, QStackedLayout *layout, QObject *parent = nullptr);
     
     void setPlaylist(const MediaPlaylist &playlist);
     void setMediaCache(MediaCache *cache);
+    void setTimeSource(NetworkClient *client); // Synced clock for lockstep playback
+    void setWallConfig(const WallConfig &config); // Crop images to this tile, tighten sync
+    void setImageMemoryBudget(qint64 bytes) { m_imageDecoder->setMemoryBudget(bytes); }
+    void setMetricsFile(const QString &path) { m_metricsPath = path; } // Playback metrics JSON, rewritten per item
     void play();
     void stop();
     void next();
@@ -38,73 +54,151 @@ public:
     // Diagnostics
     QString getCurrentCodec() const { return m_currentCodec; }
     bool isHardwareDecodeEnabled() const { return m_hwDecodeEnabled; }
+    QString getDecoderPath() const { return m_decoderPath; } // Empty until the first frame
+    bool isOverDecodeBudget() const { return m_overDecodeBudget; }
     QString getCurrentResolution() const { return m_currentResolution; }
     qreal getCurrentFps() const { return m_currentFps; }
+    bool isLockstepActive() const;
+    qint64 getSyncSkewMs() const { return m_syncSkewMs; }
+    PrefetchStats getPrefetchStats() const;
+    CaptureStats getCaptureStats() const { return m_screenCapture->stats(); }
+    StreamStats getStreamStats() const { return m_streamReceiver->stats(); }
+    PlaybackStats getPlaybackStats() const { return m_metrics.stats(); }
+    bool writePlaybackMetrics() const; // To the metrics file, if one is set
 
 signals:
     void mediaChanged(const MediaItem &item);
     void playlistFinished();
     void mediaStatusChanged(QMediaPlayer::MediaStatus status);
     void codecDetected(const QString &codec, bool hwDecode);
+    void decodeReport(const QJsonObject &report); // A video item's stream, decoder and frame pacing
 
 private slots:
     void onImageTimerFinished();
     void checkScheduledItems();
     void onVideoFinished();
     void onVideoStateChanged(QMediaPlayer::PlaybackState state);
-    void onScreenCaptureTimer();
-    void onFadeOutFinished();
-    void onFadeInFinished();
+    void onCaptureFailed(ScreenCaptureEngine::Failure failure);
+    void onCrossfadeFinished();
     void onPrefetchComplete(const QString &url, bool success);
+    void onImageFetched(const QString &url, const QString &localPath);
+    void onImageDecoded(const QString &url, bool ok);
+    void onSyncTimer();
 
 private:
     void playCurrentItem();
+    QMediaPlayer *createPlayer(); // With audio output and signal handlers
+    void onActiveStatusChanged(QMediaPlayer::MediaStatus status);
+    QString videoSource(const MediaItem &item, bool demand = true); // Cached file if there is one, else the URL
+    QString itemSource(const MediaItem &item) const; // Where its media will come from, for the metrics
+    bool isSingleVideoLoop() const;
+    void prerollNextVideo();
+    void swapInStandby(const MediaItem &item);
+    void releaseStandby();
     void showVideo();
     void showImage();
     void showScreen();
     void loadImage(const QString &url);
     void startImageTimer(int durationMs);
-    void scaleAndSetImage(const QPixmap &originalPixmap);
-    void captureScreen();
-    void fadeOut();
-    void fadeIn();
-    void prefetchNextItem();
+    void showDecodedImage(const QString &url);
+    void prepareImages(); // Decode the current and upcoming images ahead of time
+    QString localImagePath(const QString &url) const; // Empty if not downloaded yet; not a demand lookup
+    QString imageVersion(const QString &url, const QString &path) const; // Changes with the content
+    QSize imageTargetSize() const;
+    QSize screenTargetSize() const;
+    void startCrossfade();
+    QPixmap snapshotCurrent() const; // What is on screen now, at the media area's size
+    QImage fitToArea(const QImage &frame) const; // A video frame as shown in the media area
+    void revealIncoming();
+    void advanceUnderSnapshot();
+    void schedulePrefetches();
     void detectMediaProperties();
+    void reportDecode();
     void detectImageProperties(const QString &url);
+    
+    // Lockstep scheduling
+    qint64 syncedNowMs() const;
+    qint64 itemDurationMs(const MediaItem &item) const;
+    PlaylistCursor::Position lockstepPosition(qint64 syncedMs) const;
+    void rebuildCursor();
+    void recordVideoDuration(const QString &url, qint64 durationMs);
+    void correctVideoPosition(qint64 expectedOffsetMs);
+    void probeVideoDurations();
 
-    QMediaPlayer *m_player;
-    QVideoWidget *m_videoOutput;
+    QMediaPlayer *m_player; // On screen
+    QMediaPlayer *m_standbyPlayer; // Next video, opened and paused on its first frame
+    int m_standbyIndex = -1; // Playlist index m_standbyPlayer holds, -1 if none
+    QString m_standbyItemUrl;
+    QWidget *m_videoOutput;
+    QObject *m_videoSink; // What the on-screen player renders into
+    QVideoSink *m_prerollSink; // Off-screen target of m_standbyPlayer
     QLabel *m_imageLabel;
     QLabel *m_screenLabel;
     QStackedLayout *m_layout;
     MediaCache *m_mediaCache;
+    PrefetchScheduler *m_prefetchScheduler = nullptr; // Orders downloads of upcoming items
     
     MediaPlaylist m_playlist;
     QTimer *m_imageTimer;
-    QTimer *m_screenTimer;
+    ScreenCaptureEngine *m_screenCapture; // Mirrors the screen for "screen" items
+    StreamReceiver *m_streamReceiver; // Plays "stream" items
     QTimer *m_clockTimer; // checks scheduled custom_time items
-    QPixmap m_currentImage; // Store original image for rescaling
+    ImageDecodePool *m_imageDecoder;
+    QString m_currentImageUrl; // Image on screen, for rescaling
+    QSize m_currentImageSize; // Its size before scaling
+    QString m_pendingImageUrl; // Image being fetched or decoded for display
     
     bool m_isPlaying;
     bool m_interruptedForCustom = false;
     int m_resumeIndex = -1;
     bool m_playingCustomItem = false;
     
-    // Transition effects
-    QGraphicsOpacityEffect *m_videoOpacity;
-    QGraphicsOpacityEffect *m_imageOpacity;
-    QGraphicsOpacityEffect *m_screenOpacity;
-    QPropertyAnimation *m_fadeAnimation;
+    // Transitions
+    TransitionOverlay *m_transition;
     int m_fadeDuration;
     bool m_transitionsEnabled;
     bool m_isFading;
     bool m_waitingForVideoToLoad;  // Flag to delay showing video during fade
+    bool m_videoOnOverlay = false; // Incoming video drawn by m_transition until the fade ends
+    
+    // Lockstep playback: item and offset are derived from the playlist epoch
+    // and the synced clock instead of local timers
+    NetworkClient *m_timeSource;
+    QTimer *m_syncTimer;
+    QMediaPlayer *m_durationProbe; // Loads videos without output to learn their duration
+    QString m_probingUrl;
+    QHash<QString, qint64> m_videoDurations; // url -> ms
+    QSet<QString> m_probeFailed; // Urls whose probe failed for this playlist; retried when it's set again
+    PlaylistCursor m_cursor; // Item boundaries of the current playlist
+    int m_lockstepTargetIndex = -1;
+    qint64 m_syncSkewMs = 0;
+    qint64 m_lastSyncLogMs = 0;
+    int m_syncIntervalMs;
+    int m_frameBudgetMs; // Skew tolerated without correction
+    WallConfig m_wall;
+    
+    static const int SYNC_INTERVAL_MS = 250;
+    static const int FRAME_BUDGET_MS = 20;
+    static const int WALL_SYNC_INTERVAL_MS = 100; // Adjacent wall tiles need frame accuracy
+    static const int WALL_FRAME_BUDGET_MS = 8;
+    static const int SEEK_THRESHOLD_MS = 500; // Above this seek, below it nudge playback rate
+    static const qint64 PREFETCH_HORIZON_MS = 30 * 60 * 1000; // How far ahead downloads are planned
+    static const int IMAGE_LOOKAHEAD = 2; // Items after the current one whose images are decoded early
+    static const int REPORT_AFTER_FRAMES = 900; // Decode report of a single looping video, which never ends
     
     // Diagnostics
     QString m_currentCodec;
     bool m_hwDecodeEnabled;
+    MediaProbe *m_mediaProbe; // Reads codec details from the video files
+    MediaInfo m_currentMedia;
+    QString m_decoderPath; // As its frames show it, see decoderPathOf()
+    DecodeBudget m_decodeBudget;
+    bool m_overDecodeBudget = false;
+    bool m_decodeReported = false; // Current item already in m_decodeBudget
     QString m_currentResolution;
     qreal m_currentFps;
+    PlaybackMetrics m_metrics; // Per-item latency, fades, stalls and frame pacing
+    QString m_metricsPath;
     
     // Widget indices for stacked layout (using compatibility constants)
     static const int VIDEO_INDEX = VIDEO_WIDGET_INDEX;
@@ -0,0 +1,396 @@
+#include "mediaprobe.h"
+#include "logger.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QMetaObject>
+
+// --- ISO BMFF helpers ---
+
+static quint16 be16(const QByteArray &data, qint64 at)
+{
+    const uchar *p = reinterpret_cast<const uchar *>(data.constData()) + at;
+    return static_cast<quint16>((p[0] << 8) | p[1]);
+}
+
+static quint32 be32(const QByteArray &data, qint64 at)
+{
+    const uchar *p = reinterpret_cast<const uchar *>(data.constData()) + at;
+    return (quint32(p[0]) << 24) | (quint32(p[1]) << 16) | (quint32(p[2]) << 8) | quint32(p[3]);
+}
+
+static quint64 be64(const QByteArray &data, qint64 at)
+{
+    return (quint64(be32(data, at)) << 32) | be32(data, at + 4);
+}
+
+// A box inside a buffer: its body is data[body, end)
+struct Box {
+    QByteArray type;
+    qint64 body = 0;
+    qint64 end = 0;
+};
+
+// First box of the given type among the boxes in data[begin, end)
+static bool findBox(const QByteArray &data, qint64 begin, qint64 end, const char *type, Box *box)
+{
+    qint64 at = begin;
+    while (at + 8 <= end) {
+        qint64 size = be32(data, at);
+        qint64 header = 8;
+        if (size == 1) {
+            if (at + 16 > end) {
+                return false;
+            }
+            size = static_cast<qint64>(be64(data, at + 8));
+            header = 16;
+        } else if (size == 0) {
+            size = end - at; // Runs to the end of its parent
+        }
+        if (size < header || at + size > end) {
+            return false; // Corrupt or truncated
+        }
+        if (data.mid(at + 4, 4) == type) {
+            box->type = type;
+            box->body = at + header;
+            box->end = at + size;
+            return true;
+        }
+        at += size;
+    }
+    return false;
+}
+
+// Same, following a path of nested types ("mdia/minf/stbl")
+static bool findPath(const QByteArray &data, const Box &parent, const QList<QByteArray> &path, Box *box)
+{
+    Box current = parent;
+    for (const QByteArray &type : path) {
+        if (!findBox(data, current.body, current.end, type.constData(), &current)) {
+            return false;
+        }
+    }
+    *box = current;
+    return true;
+}
+
+static QString codecName(const QString &fourcc)
+{
+    if (fourcc == "avc1" || fourcc == "avc3") return "H.264";
+    if (fourcc == "hvc1" || fourcc == "hev1") return "H.265";
+    if (fourcc == "av01") return "AV1";
+    if (fourcc == "vp09") return "VP9";
+    if (fourcc == "vp08") return "VP8";
+    if (fourcc == "mp4v") return "MPEG-4 Part 2";
+    if (fourcc.startsWith("ap")) return "ProRes";
+    if (fourcc == "jpeg" || fourcc == "mjpa") return "Motion JPEG";
+    return fourcc;
+}
+
+static QString avcProfileName(int profileIdc)
+{
+    switch (profileIdc) {
+    case 66: return "Baseline";
+    case 77: return "Main";
+    case 88: return "Extended";
+    case 100: return "High";
+    case 110: return "High 10";
+    case 122: return "High 4:2:2";
+    case 244: return "High 4:4:4";
+    default: return QString("Profile %1").arg(profileIdc);
+    }
+}
+
+static QString hevcProfileName(int profileIdc)
+{
+    switch (profileIdc) {
+    case 1: return "Main";
+    case 2: return "Main 10";
+    case 3: return "Main Still";
+    case 4: return "Range Extensions";
+    default: return QString("Profile %1").arg(profileIdc);
+    }
+}
+
+// Profile and level from the decoder configuration box after the sample entry
+static void readCodecConfig(const QByteArray &data, const Box &entry, MediaInfo *info)
+{
+    // VisualSampleEntry fields before its child boxes
+    const qint64 childrenAt = entry.body + 78;
+    Box config;
+    if (findBox(data, childrenAt, entry.end, "avcC", &config) && config.end - config.body >= 4) {
+        info->profile = avcProfileName(static_cast<uchar>(data.at(config.body + 1)));
+        info->level = QString::number(static_cast<uchar>(data.at(config.body + 3)) / 10.0);
+    } else if (findBox(data, childrenAt, entry.end, "hvcC", &config) && config.end - config.body >= 13) {
+        info->profile = hevcProfileName(static_cast<uchar>(data.at(config.body + 1)) & 0x1F);
+        info->level = QString::number(static_cast<uchar>(data.at(config.body + 12)) / 30.0);
+    } else if (findBox(data, childrenAt, entry.end, "av1C", &config) && config.end - config.body >= 2) {
+        uchar profileLevel = static_cast<uchar>(data.at(config.body + 1));
+        static const char *AV1_PROFILES[] = {"Main", "High", "Professional"};
+        int profile = profileLevel >> 5;
+        info->profile = profile < 3 ? QString(AV1_PROFILES[profile]) : QString("Profile %1").arg(profile);
+        int levelIdx = profileLevel & 0x1F;
+        info->level = QString("%1.%2").arg(2 + (levelIdx >> 2)).arg(levelIdx & 3);
+    } else if (findBox(data, childrenAt, entry.end, "vpcC", &config) && config.end - config.body >= 6) {
+        info->profile = QString("Profile %1").arg(static_cast<uchar>(data.at(config.body + 4)));
+        info->level = QString::number(static_cast<uchar>(data.at(config.body + 5)) / 10.0);
+    }
+}
+
+// Fills info from the first video track of a moov box; false if there is none
+static bool readVideoTrack(const QByteArray &moov, MediaInfo *info)
+{
+    Box root;
+    root.body = 0;
+    root.end = moov.size();
+
+    qint64 at = 0;
+    Box trak;
+    while (findBox(moov, at, root.end, "trak", &trak)) {
+        at = trak.end;
+        Box hdlr;
+        if (!findPath(moov, trak, {"mdia", "hdlr"}, &hdlr) || hdlr.end - hdlr.body < 12 ||
+            moov.mid(hdlr.body + 8, 4) != "vide") {
+            continue;
+        }
+
+        // Track timescale and duration
+        Box mdhd;
+        quint32 timescale = 0;
+        quint64 duration = 0;
+        if (findPath(moov, trak, {"mdia", "mdhd"}, &mdhd) && mdhd.end - mdhd.body >= 24) {
+            if (moov.at(mdhd.body) == 1 && mdhd.end - mdhd.body >= 32) {
+                timescale = be32(moov, mdhd.body + 20);
+                duration = be64(moov, mdhd.body + 24);
+            } else {
+                timescale = be32(moov, mdhd.body + 12);
+                duration = be32(moov, mdhd.body + 16);
+            }
+        }
+        if (timescale > 0) {
+            info->durationMs = static_cast<qint64>(duration * 1000 / timescale);
+        }
+
+        Box stbl;
+        if (!findPath(moov, trak, {"mdia", "minf", "stbl"}, &stbl)) {
+            return true;
+        }
+
+        // First sample description: codec, coded size, configuration
+        Box stsd;
+        if (findBox(moov, stbl.body, stbl.end, "stsd", &stsd) && stsd.end - stsd.body >= 16) {
+            qint64 entryAt = stsd.body + 8;
+            qint64 entrySize = be32(moov, entryAt);
+            if (entrySize >= 8 + 78 && entryAt + entrySize <= stsd.end) {
+                Box entry;
+                entry.type = moov.mid(entryAt + 4, 4);
+                entry.body = entryAt + 8;
+                entry.end = entryAt + entrySize;
+                info->fourcc = QString::fromLatin1(entry.type);
+                info->codec = codecName(info->fourcc);
+                info->resolution = QSize(be16(moov, entry.body + 24), be16(moov, entry.body + 26));
+                readCodecConfig(moov, entry, info);
+            }
+        }
+
+        // Sample count for the frame rate, sample sizes for the bitrate
+        Box stsz;
+        if (findBox(moov, stbl.body, stbl.end, "stsz", &stsz) && stsz.end - stsz.body >= 12) {
+            quint32 sampleSize = be32(moov, stsz.body + 4);
+            quint32 sampleCount = be32(moov, stsz.body + 8);
+            quint64 bytes = 0;
+            if (sampleSize != 0) {
+                bytes = quint64(sampleSize) * sampleCount;
+            } else if (stsz.body + 12 + qint64(sampleCount) * 4 <= stsz.end) {
+                for (quint32 i = 0; i < sampleCount; ++i) {
+                    bytes += be32(moov, stsz.body + 12 + qint64(i) * 4);
+                }
+            }
+            if (duration > 0 && timescale > 0) {
+                double seconds = static_cast<double>(duration) / timescale;
+                info->fps = sampleCount / seconds;
+                info->bitrateBps = static_cast<qint64>(bytes * 8 / seconds);
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+// --- MediaInfo ---
+
+QString MediaInfo::summary() const
+{
+    if (codec.isEmpty()) {
+        return "unknown";
+    }
+    QString text = codec;
+    if (!profile.isEmpty()) {
+        text += " " + profile;
+        if (!level.isEmpty()) {
+            text += "@" + level;
+        }
+    }
+    if (bitrateBps > 0) {
+        text += QString(", %1 Mb/s").arg(bitrateBps / 1e6, 0, 'f', 1);
+    }
+    return text;
+}
+
+QJsonObject MediaInfo::toJson() const
+{
+    QJsonObject json;
+    json["probed"] = probed;
+    json["container"] = container;
+    json["codec"] = codec;
+    json["fourcc"] = fourcc;
+    json["profile"] = profile;
+    json["level"] = level;
+    json["width"] = resolution.width();
+    json["height"] = resolution.height();
+    json["fps"] = fps;
+    json["bitrate"] = bitrateBps;
+    json["durationMs"] = durationMs;
+    json["pixelRate"] = pixelRate();
+    return json;
+}
+
+// --- MediaProbe ---
+
+MediaProbe::MediaProbe(QObject *parent)
+    : QObject(parent)
+{
+    m_pool.setMaxThreadCount(1);
+}
+
+MediaProbe::~MediaProbe()
+{
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+void MediaProbe::request(const QString &path)
+{
+    if (path.isEmpty() || hasInfo(path) || m_pending.contains(path)) {
+        return;
+    }
+    m_pending.insert(path);
+    m_pool.start([this, path]() {
+        MediaInfo info = probeFile(path);
+        QMetaObject::invokeMethod(this, [this, path, info]() {
+            m_pending.remove(path);
+            m_results.insert(path, info);
+            emit probed(path);
+        }, Qt::QueuedConnection);
+    });
+}
+
+bool MediaProbe::hasInfo(const QString &path) const
+{
+    auto it = m_results.constFind(path);
+    return it != m_results.constEnd() &&
+           it->fileModifiedMs == QFileInfo(path).lastModified().toMSecsSinceEpoch();
+}
+
+MediaInfo MediaProbe::info(const QString &path) const
+{
+    return hasInfo(path) ? m_results.value(path) : MediaInfo();
+}
+
+MediaInfo MediaProbe::probeFile(const QString &path)
+{
+    MediaInfo info;
+    QFileInfo fileInfo(path);
+    info.container = fileInfo.suffix().toLower();
+    info.fileModifiedMs = fileInfo.lastModified().toMSecsSinceEpoch();
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return info;
+    }
+
+    // Walk the top-level boxes by their headers alone, down to moov
+    QByteArray moov;
+    qint64 at = 0;
+    const qint64 fileSize = file.size();
+    while (at + 8 <= fileSize && file.seek(at)) {
+        QByteArray header = file.read(16);
+        if (header.size() < 8) {
+            break;
+        }
+        qint64 size = be32(header, 0);
+        qint64 headerSize = 8;
+        if (size == 1 && header.size() == 16) {
+            size = static_cast<qint64>(be64(header, 8));
+            headerSize = 16;
+        } else if (size == 0) {
+            size = fileSize - at;
+        }
+        if (size < headerSize) {
+            break; // Not ISO BMFF, or corrupt
+        }
+
+        QByteArray type = header.mid(4, 4);
+        if (type == "ftyp" && header.size() >= 12) {
+            info.container = header.mid(8, 4) == "qt  " ? "mov" : "mp4";
+        } else if (type == "moov") {
+            if (size - headerSize > MAX_MOOV_BYTES) {
+                LOG_WARNING_CAT(QString("moov of %1 is %2 bytes, not probing").arg(path).arg(size), "MediaProbe");
+                return info;
+            }
+            file.seek(at + headerSize);
+            moov = file.read(size - headerSize);
+            break;
+        }
+        at += size;
+    }
+
+    if (moov.isEmpty() || !readVideoTrack(moov, &info)) {
+        return info; // WebM, AVI, audio only, or damaged: the backend's metadata will have to do
+    }
+    info.probed = true;
+    LOG_DEBUG_CAT(QString("Probed %1: %2 %3x%4 %5 fps").arg(fileInfo.fileName(), info.summary())
+                  .arg(info.resolution.width()).arg(info.resolution.height()).arg(info.fps, 0, 'f', 2), "MediaProbe");
+    return info;
+}
+
+// --- DecodeBudget ---
+
+void DecodeBudget::record(const QString &decoder, double pixelRate, int frames, int lateFrames)
+{
+    if (decoder.isEmpty() || pixelRate <= 0.0 || frames < MIN_FRAMES) {
+        return;
+    }
+    Limits &limits = m_limits[decoder];
+    if (playedLate(frames, lateFrames)) {
+        limits.lateMin = limits.lateMin > 0.0 ? qMin(limits.lateMin, pixelRate) : pixelRate;
+    } else {
+        limits.cleanMax = qMax(limits.cleanMax, pixelRate);
+        // Played cleanly at a rate once seen late: that one was something else
+        if (limits.lateMin > 0.0 && limits.lateMin <= pixelRate) {
+            limits.lateMin = 0.0;
+        }
+    }
+}
+
+bool DecodeBudget::playedLate(int frames, int lateFrames) const
+{
+    return frames >= MIN_FRAMES && lateFrames * 100 >= frames * LATE_PERCENT;
+}
+
+bool DecodeBudget::exceeds(const QString &decoder, double pixelRate) const
+{
+    auto it = m_limits.constFind(decoder);
+    return it != m_limits.constEnd() && it->lateMin > 0.0 && pixelRate >= it->lateMin;
+}
+
+QJsonObject DecodeBudget::toJson() const
+{
+    QJsonObject json;
+    for (auto it = m_limits.constBegin(); it != m_limits.constEnd(); ++it) {
+        QJsonObject limits;
+        limits["cleanMaxPixelRate"] = it->cleanMax;
+        limits["lateMinPixelRate"] = it->lateMin;
+        json[it.key()] = limits;
+    }
+    return json;
+}
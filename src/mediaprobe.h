@@ -0,0 +1,83 @@
+#ifndef MEDIAPROBE_H
+#define MEDIAPROBE_H
+
+#include <QObject>
+#include <QString>
+#include <QSize>
+#include <QHash>
+#include <QSet>
+#include <QThreadPool>
+#include <QJsonObject>
+
+// What a video file's container says about its video track
+struct MediaInfo {
+    bool probed = false;        // Container parsed; false for formats MediaProbe can't read
+    QString container;          // "mp4", "mov", or the file extension if not parsed
+    QString codec;              // "H.264", "H.265", "AV1", "VP9", ..., else the sample entry fourcc
+    QString fourcc;             // Sample entry, e.g. "avc1"
+    QString profile;            // "High", "Main 10", ...
+    QString level;              // "4.1"
+    QSize resolution;
+    double fps = 0.0;           // Average, from the sample count and track duration
+    qint64 bitrateBps = 0;      // Video track only
+    qint64 durationMs = 0;
+    qint64 fileModifiedMs = 0;  // Version of the file this describes
+
+    double pixelRate() const { return resolution.width() * static_cast<double>(resolution.height()) * fps; }
+    QString summary() const;    // "H.264 High@4.1, 8.2 Mb/s"
+    QJsonObject toJson() const;
+};
+
+// Reads codec, profile, level, resolution, frame rate and bitrate of the
+// video track from MP4/MOV (ISO BMFF) containers. Only the moov box is read;
+// the media data is skipped over, so probing costs a few reads wherever moov
+// sits in the file. Probes run on a worker thread, once per file version.
+class MediaProbe : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit MediaProbe(QObject *parent = nullptr);
+    ~MediaProbe();
+
+    void request(const QString &path); // probed() once the result is in
+    bool hasInfo(const QString &path) const;
+    MediaInfo info(const QString &path) const; // Default MediaInfo until probed
+
+    static MediaInfo probeFile(const QString &path);
+
+signals:
+    void probed(const QString &path);
+
+private:
+    QThreadPool m_pool;
+    QHash<QString, MediaInfo> m_results;
+    QSet<QString> m_pending;
+
+    static const qint64 MAX_MOOV_BYTES = 64 * 1024 * 1024;
+};
+
+// What this display has been seen to decode. Cost is the pixel rate (width
+// x height x fps); per decoder path it keeps the highest rate played without
+// late frames and the lowest one that played late. An item at or above the
+// latter is over budget before it even plays.
+class DecodeBudget
+{
+public:
+    void record(const QString &decoder, double pixelRate, int frames, int lateFrames);
+    bool playedLate(int frames, int lateFrames) const;
+    bool exceeds(const QString &decoder, double pixelRate) const;
+    QJsonObject toJson() const;
+
+    static const int MIN_FRAMES = 120;  // Fewer say nothing either way
+    static const int LATE_PERCENT = 5;  // Late frames that make an item too costly
+
+private:
+    struct Limits {
+        double cleanMax = 0.0; // Highest pixel rate played without late frames
+        double lateMin = 0.0;  // Lowest pixel rate that played late, 0 if none yet
+    };
+    QHash<QString, Limits> m_limits; // Decoder path -> limits
+};
+
+#endif // MEDIAPROBE_H
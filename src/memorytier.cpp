@@ -0,0 +1,208 @@
+#include "memorytier.h"
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+
+static const char *TMPFS_ROOT = "/dev/shm";
+
+static qint64 readMemInfo(const QByteArray &field)
+{
+    // /proc files report a size of 0, so read until EOF rather than by size
+    QFile file("/proc/meminfo");
+    if (!file.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+    const QList<QByteArray> lines = file.readAll().split('\n');
+    for (const QByteArray &line : lines) {
+        if (line.startsWith(field + ':')) {
+            QList<QByteArray> parts = line.simplified().split(' ');
+            if (parts.size() >= 2) {
+                return parts.at(1).toLongLong() * 1024; // Reported in kB
+            }
+        }
+    }
+    return -1;
+}
+
+MemoryTier::~MemoryTier()
+{
+    removeDir();
+}
+
+bool MemoryTier::setBudget(qint64 bytes)
+{
+    m_budget = qMax<qint64>(bytes, 0);
+    if (m_budget == 0) {
+        clear();
+        removeDir();
+        return true;
+    }
+
+    if (m_dir.isEmpty()) {
+        QDir root(TMPFS_ROOT);
+        if (!root.exists()) {
+            qWarning() << "Cache: No tmpfs at" << TMPFS_ROOT << "- RAM tier disabled";
+            m_budget = 0;
+            return false;
+        }
+
+        // Tiers of processes that died without cleaning up
+        const QStringList stale = root.entryList(QStringList() << "videotimeline-*", QDir::Dirs);
+        for (const QString &name : stale) {
+            QString pid = name.section('-', 1);
+            if (!QFile::exists("/proc/" + pid)) {
+                QDir(root.filePath(name)).removeRecursively();
+            }
+        }
+
+        m_dir = root.filePath(QString("videotimeline-%1").arg(QCoreApplication::applicationPid()));
+        if (!QDir().mkpath(m_dir)) {
+            qWarning() << "Cache: Failed to create RAM tier directory:" << m_dir;
+            m_dir.clear();
+            m_budget = 0;
+            return false;
+        }
+    }
+
+    while (m_index.totalSize() > m_budget && !m_index.isEmpty()) {
+        demote(lowestRecurrence());
+    }
+    return true;
+}
+
+void MemoryTier::setRecurrence(const QHash<QString, int> &recurrence)
+{
+    m_recurrence = recurrence;
+    const QStringList keys = m_index.keys();
+    for (const QString &key : keys) {
+        if (!m_recurrence.contains(key)) {
+            demote(key);
+        }
+    }
+}
+
+bool MemoryTier::promote(const QString &key, const QString &sourcePath, qint64 size)
+{
+    if (!isEnabled() || m_index.contains(key) || size > m_budget) {
+        return false;
+    }
+    int recurrence = m_recurrence.value(key);
+    if (recurrence == 0) {
+        return false; // Not in the playlist, won't be back soon
+    }
+
+    // Only what recurs less often may make room; find out before dropping anything
+    qint64 freeable = 0;
+    const QStringList keys = m_index.keys();
+    for (const QString &resident : keys) {
+        if (m_recurrence.value(resident) < recurrence) {
+            freeable += m_index.find(resident)->size;
+        }
+    }
+    if (m_index.totalSize() - freeable + size > m_budget) {
+        return false;
+    }
+
+    // tmpfs pages are memory: don't promote into a squeeze
+    qint64 available = availableMemory();
+    if (available >= 0 && available - size < lowMemoryThreshold()) {
+        return false;
+    }
+
+    while (m_index.totalSize() + size > m_budget) {
+        demote(lowestRecurrence());
+    }
+
+    QString path = m_dir + "/" + key;
+    QString partial = path + ".part";
+    QFile::remove(partial);
+    if (!QFile::copy(sourcePath, partial) || !QFile::rename(partial, path)) {
+        qWarning() << "Cache: Failed to copy into the RAM tier:" << sourcePath;
+        QFile::remove(partial);
+        return false;
+    }
+
+    CacheEntry entry;
+    entry.localPath = path;
+    entry.size = size;
+    entry.lastAccess = QDateTime::currentMSecsSinceEpoch();
+    m_index.insert(key, entry);
+    qDebug() << "Cache: Promoted" << key << "to the RAM tier (" << size << "bytes )";
+    return true;
+}
+
+bool MemoryTier::demote(const QString &key)
+{
+    const CacheEntry *entry = m_index.find(key);
+    if (!entry) {
+        return false;
+    }
+    // A player that still has the file open keeps reading it after the unlink
+    QFile::remove(entry->localPath);
+    m_index.remove(key);
+    return true;
+}
+
+qint64 MemoryTier::relieve(qint64 bytes)
+{
+    qint64 freed = 0;
+    while (freed < bytes && !m_index.isEmpty()) {
+        QString key = lowestRecurrence();
+        freed += m_index.find(key)->size;
+        demote(key);
+    }
+    return freed;
+}
+
+void MemoryTier::clear()
+{
+    const QList<CacheEntry> entries = m_index.entries();
+    for (const CacheEntry &entry : entries) {
+        QFile::remove(entry.localPath);
+    }
+    m_index.clear();
+}
+
+QString MemoryTier::lowestRecurrence() const
+{
+    // keys() is least recent first, so ties go to the older entry
+    QString lowestKey;
+    int lowest = 0;
+    const QStringList keys = m_index.keys();
+    for (const QString &key : keys) {
+        int recurrence = m_recurrence.value(key);
+        if (lowestKey.isEmpty() || recurrence < lowest) {
+            lowestKey = key;
+            lowest = recurrence;
+        }
+    }
+    return lowestKey;
+}
+
+void MemoryTier::removeDir()
+{
+    if (!m_dir.isEmpty()) {
+        QDir(m_dir).removeRecursively();
+        m_dir.clear();
+    }
+    m_index.clear();
+}
+
+qint64 MemoryTier::totalMemory()
+{
+    return readMemInfo("MemTotal");
+}
+
+qint64 MemoryTier::availableMemory()
+{
+    return readMemInfo("MemAvailable");
+}
+
+qint64 MemoryTier::lowMemoryThreshold()
+{
+    // A tenth of RAM, but never less than enough for the player to decode
+    static const qint64 threshold = qMax(MIN_LOW_MEMORY, totalMemory() / 10);
+    return threshold;
+}
@@ -0,0 +1,60 @@
+#ifndef MEMORYTIER_H
+#define MEMORYTIER_H
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include "cacheindex.h"
+
+// RAM tier in front of MediaCache's disk directory: copies of hot entries
+// kept on tmpfs (/dev/shm), so looping content is read from memory instead
+// of the SD card, by images and videos alike, through a plain file path.
+// Only entries in the current playlist are promoted, and they only displace
+// entries that recur less often in it; with equal recurrence the resident
+// set stays put rather than churning through a loop larger than the budget.
+// Owned and used by CacheWorker on the cache's I/O thread.
+class MemoryTier
+{
+public:
+    MemoryTier() = default;
+    ~MemoryTier(); // Removes the tier directory; the copies are only a cache
+    MemoryTier(const MemoryTier&) = delete;
+    MemoryTier& operator=(const MemoryTier&) = delete;
+
+    // 0 disables the tier. Returns false if there is no tmpfs to put it on.
+    bool setBudget(qint64 bytes);
+    qint64 budget() const { return m_budget; }
+    bool isEnabled() const { return m_budget > 0 && !m_dir.isEmpty(); }
+
+    // How often each cache key occurs in the playlist; entries that no longer
+    // occur are dropped
+    void setRecurrence(const QHash<QString, int> &recurrence);
+
+    // Copy sourcePath into RAM if the budget and free memory allow
+    bool promote(const QString &key, const QString &sourcePath, qint64 size);
+    bool demote(const QString &key);
+    qint64 relieve(qint64 bytes); // Demote until bytes are freed; returns bytes freed
+    void touch(const QString &key, qint64 accessTime) { m_index.touch(key, accessTime); }
+    void clear();
+
+    bool contains(const QString &key) const { return m_index.contains(key); }
+    const CacheIndex &index() const { return m_index; }
+
+    // From /proc/meminfo, -1 where it isn't available
+    static qint64 totalMemory();
+    static qint64 availableMemory();
+    static qint64 lowMemoryThreshold(); // Below this much available, the tier shrinks
+
+private:
+    QString lowestRecurrence() const; // Least recent among the least recurring; empty if none
+    void removeDir();
+
+    CacheIndex m_index; // Cache key -> copy in m_dir, in LRU order
+    QHash<QString, int> m_recurrence;
+    QString m_dir;
+    qint64 m_budget = 0;
+
+    static constexpr qint64 MIN_LOW_MEMORY = 128LL * 1024 * 1024;
+};
+
+#endif // MEMORYTIER_H
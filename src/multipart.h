@@ -0,0 +1,100 @@
+#ifndef MULTIPART_H
+#define MULTIPART_H
+
+// Framing of multipart/x-mixed-replace (MJPEG) streams. Header-only so the
+// server's stream relay is built from the same code as the client's
+// StreamReceiver: both split parts exactly the same way.
+
+#include <QByteArray>
+#include <QList>
+
+struct MultipartPart {
+    QByteArray body;
+    qint64 timestampMs = 0; // X-Timestamp, capture time on the server's clock
+    bool hasTimestamp = false;
+};
+
+// Boundary from a multipart Content-Type, without quotes or leading dashes
+inline QByteArray multipartBoundary(const QByteArray &contentType) {
+    int at = contentType.indexOf("boundary=");
+    if (at < 0) {
+        return QByteArray();
+    }
+    QByteArray boundary = contentType.mid(at + 9);
+    int end = boundary.indexOf(';');
+    if (end >= 0) {
+        boundary.truncate(end);
+    }
+    boundary = boundary.trimmed();
+    if (boundary.size() >= 2 && boundary.startsWith('"') && boundary.endsWith('"')) {
+        boundary = boundary.mid(1, boundary.size() - 2);
+    }
+    if (boundary.startsWith("--")) {
+        boundary = boundary.mid(2); // Some cameras include the delimiter's dashes
+    }
+    return boundary;
+}
+
+// Value of a part header, matched case-insensitively; empty if absent
+inline QByteArray multipartHeader(const QByteArray &headers, const QByteArray &name) {
+    const QList<QByteArray> lines = headers.split('\n');
+    for (const QByteArray &rawLine : lines) {
+        QByteArray line = rawLine.trimmed();
+        int colon = line.indexOf(':');
+        if (colon > 0 && line.left(colon).trimmed().toLower() == name) {
+            return line.mid(colon + 1).trimmed();
+        }
+    }
+    return QByteArray();
+}
+
+// Removes every complete part from the front of buffer. A part ends after
+// its Content-Length if it has one, else at the next delimiter.
+inline QList<MultipartPart> takeMultipartParts(QByteArray *buffer, const QByteArray &boundary) {
+    const QByteArray delimiter = "--" + boundary;
+    QList<MultipartPart> parts;
+    int consumed = 0;
+
+    while (true) {
+        int start = buffer->indexOf(delimiter, consumed);
+        if (start < 0) {
+            break;
+        }
+        int headerEnd = buffer->indexOf("\r\n\r\n", start);
+        if (headerEnd < 0) {
+            break;
+        }
+        QByteArray headers = buffer->mid(start + delimiter.size(), headerEnd - start - delimiter.size());
+        int bodyStart = headerEnd + 4;
+        int bodyEnd = -1;
+
+        bool hasLength = false;
+        qint64 length = multipartHeader(headers, "content-length").toLongLong(&hasLength);
+        if (hasLength && length >= 0) {
+            if (buffer->size() - bodyStart < length) {
+                break;
+            }
+            bodyEnd = bodyStart + static_cast<int>(length);
+        } else {
+            int next = buffer->indexOf(delimiter, bodyStart);
+            if (next < 0) {
+                break;
+            }
+            bodyEnd = next;
+            while (bodyEnd > bodyStart && (buffer->at(bodyEnd - 1) == '\n' || buffer->at(bodyEnd - 1) == '\r')) {
+                bodyEnd--;
+            }
+        }
+
+        MultipartPart part;
+        part.body = buffer->mid(bodyStart, bodyEnd - bodyStart);
+        part.timestampMs = multipartHeader(headers, "x-timestamp").toLongLong(&part.hasTimestamp);
+        parts.append(part);
+        consumed = bodyEnd;
+    }
+
+    buffer->remove(0, consumed);
+    return parts;
+}
+
+#endif // MULTIPART_H
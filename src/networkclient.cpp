@@ -1,5 +1,7 @@
 #include "networkclient.h"
 #include "logger.h"
+#include "clientsnapshot.h"
+#include "mediacache.h"
 #include <QNetworkRequest>
 #include <QJsonDocument>
 #include <QJsonObject>
@@ -16,6 +18,8 @@
 #include <QStandardPaths>
 #include <QDir>
 #include <QFile>
+#include <QCryptographicHash>
+#include <QSysInfo>
 
 NetworkClient::NetworkClient(QObject *parent)
     : QObject(parent)
@@ -29,8 +33,6 @@ NetworkClient::NetworkClient(QObject *parent)
     , m_reconnectTimer(new QTimer(this))
     , m_reconnectAttempts(0)
     , m_currentBackoffMs(1000)
-    , m_timeSynced(false)
-    , m_timeOffsetMs(0)
 {
     // Set up cache directory
     QString defaultCacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
@@ -49,9 +51,9 @@ NetworkClient::NetworkClient(QObject *parent)
     m_reconnectTimer->setSingleShot(true);
     connect(m_reconnectTimer, &QTimer::timeout, this, &NetworkClient::attemptReconnection);
     
-    // Set up time sync timer (every 10 minutes)
+    // Set up time sync timer (interval adapts to clock stability, 64s..17min)
     m_timeSyncTimer = new QTimer(this);
-    m_timeSyncTimer->setInterval(10 * 60 * 1000); // 10 minutes
+    m_timeSyncTimer->setInterval(m_clock.pollIntervalMs());
     connect(m_timeSyncTimer, &QTimer::timeout, this, &NetworkClient::fetchServerTime);
     
     LOG_INFO_CAT("NetworkClient initialized", "Network");
@@ -137,6 +139,7 @@ void NetworkClient::onScheduleReplyFinished()
             
             // Save to persistent cache
             saveCachedSchedule(scheduleObj);
+            ClientSnapshot::instance().setLastServer(m_serverUrl);
             
             // Parse and emit
             parseScheduleJson(scheduleObj);
@@ -146,6 +149,11 @@ void NetworkClient::onScheduleReplyFinished()
                 emit connectionStatusChanged(true, m_serverUrl, m_hostname);
                 m_reconnectTimer->stop(); // Stop reconnection attempts
                 LOG_INFO_CAT("Connected to server successfully", "Network");
+                
+                // Lock to the server clock as soon as it is reachable
+                if (!m_clock.isSynced()) {
+                    fetchServerTime();
+                }
             }
         } else {
             LOG_ERROR_CAT(QString("JSON parse error: %1").arg(error.errorString()), "Network");
@@ -305,6 +313,7 @@ void NetworkClient::parseScheduleJson(const QJsonObject &json)
         schedule = createDefaultSchedule();
     }
     
+    ClientSnapshot::instance().setSchedule({schoolStart, schoolEnd, schedule, m_hostname});
     emit scheduleReceived(schoolStart, schoolEnd, schedule);
 }
 
@@ -325,6 +334,9 @@ void NetworkClient::parsePlaylistJson(const QJsonObject &json)
         QDate d = QDate::fromString(dateStr, "yyyy-MM-dd");
         if (d.isValid()) playlist.specialDate = d;
     }
+    if (json.contains("epoch")) {
+        playlist.epochMs = json["epoch"].toVariant().toLongLong();
+    }
     QJsonArray itemsArray = json["items"].toArray();
     
     for (const QJsonValue &itemValue : itemsArray) {
@@ -352,11 +364,19 @@ void NetworkClient::parsePlaylistJson(const QJsonObject &json)
             if (item.url.startsWith("/")) {
                 item.url = m_serverUrl + item.url;
             }
+            item.cacheKey = MediaCache::cacheKeyFor(item.url);
             playlist.items.append(item);
         }
     }
     
+    // Playlists without a server epoch get a persisted local one, so a restarted
+    // client resumes mid-loop instead of starting over at item 0
+    if (playlist.hasItems() && !playlist.isSpecial && playlist.epochMs <= 0) {
+        playlist.epochMs = localPlaylistEpoch(playlist);
+    }
+    
     if (playlist.hasItems()) {
+        ClientSnapshot::instance().setPlaylist(playlist);
         emit playlistReceived(playlist);
     } else {
         emit networkError("Received empty or invalid playlist");
@@ -371,6 +391,16 @@ void NetworkClient::discoverAndSetServer()
     
     qDebug() << "Starting server discovery...";
     
+    // Priority 0: The server we were last connected to (usually still there)
+    QString lastServer = ClientSnapshot::instance().lastServer();
+    if (!lastServer.isEmpty() && tryServerUrl(lastServer)) {
+        m_serverUrl = lastServer;
+        m_discovered = true;
+        qDebug() << "Found server at last known address:" << m_serverUrl;
+        emit serverDiscovered(m_serverUrl);
+        return;
+    }
+    
     // Strategy: Try common IPs first, then scan local network
     QString networkPrefix = getLocalNetworkPrefix();
     
@@ -571,6 +601,27 @@ bool NetworkClient::tryServerUrl(const QString &url)
     return found;
 }
 
+void NetworkClient::postDecodeReport(const QJsonObject &report)
+{
+    if (!m_connected) return;
+    
+    QJsonObject body = report;
+    body["host"] = QSysInfo::machineHostName();
+    // The server matches reports to playlist entries by path
+    body["path"] = QUrl(report.value("url").toString()).path();
+    
+    QNetworkRequest request(QUrl(m_serverUrl + "/api/decode/report"));
+    request.setRawHeader("User-Agent", "VideoTimeline Client");
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    QNetworkReply *reply = m_networkManager->post(request, QJsonDocument(body).toJson(QJsonDocument::Compact));
+    connect(reply, &QNetworkReply::finished, this, [reply]() {
+        if (reply->error() != QNetworkReply::NoError) {
+            LOG_WARNING_CAT(QString("Decode report not delivered: %1").arg(reply->errorString()), "Network");
+        }
+        reply->deleteLater();
+    });
+}
+
 void NetworkClient::measurePing()
 {
     if (!m_connected) return;
@@ -656,6 +707,9 @@ void NetworkClient::attemptReconnection()
                     fetchCurrentMedia();
                     m_fetchTimer->start();
                     m_pingTimer->start();
+                    if (!m_clock.isSynced()) {
+                        fetchServerTime();
+                    }
                 }
             } else {
                 // Failed to reconnect, increase backoff
@@ -727,8 +781,87 @@ void NetworkClient::saveCachedPlaylist(const QJsonObject &json)
     }
 }
 
+QJsonObject NetworkClient::loadTimingCache() const
+{
+    QFile file(m_cacheDir + "/playlist_timing.json");
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QJsonObject();
+    }
+    return QJsonDocument::fromJson(file.readAll()).object();
+}
+
+void NetworkClient::saveTimingCache(const QJsonObject &json)
+{
+    QFile file(m_cacheDir + "/playlist_timing.json");
+    if (file.open(QIODevice::WriteOnly)) {
+        file.write(QJsonDocument(json).toJson(QJsonDocument::Compact));
+        file.close();
+    } else {
+        LOG_ERROR_CAT(QString("Failed to save playlist timing cache: %1").arg(file.errorString()), "Network");
+    }
+}
+
+qint64 NetworkClient::localPlaylistEpoch(const MediaPlaylist &playlist)
+{
+    // Identify the playlist by its items so an edited playlist starts a new loop
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    for (const MediaItem &item : playlist.items) {
+        hash.addData(QString("%1|%2|%3\n").arg(item.type, item.url).arg(item.duration).toUtf8());
+    }
+    QString signature = QString::fromLatin1(hash.result().toHex());
+    
+    QJsonObject timing = loadTimingCache();
+    if (timing["signature"].toString() == signature && timing.contains("epoch")) {
+        return timing["epoch"].toVariant().toLongLong();
+    }
+    
+    qint64 epoch = getCurrentDateTime().toMSecsSinceEpoch();
+    timing["signature"] = signature;
+    timing["epoch"] = epoch;
+    saveTimingCache(timing);
+    LOG_DEBUG_CAT("Started new local playlist epoch", "Network");
+    return epoch;
+}
+
+QHash<QString, qint64> NetworkClient::loadCachedDurations() const
+{
+    QHash<QString, qint64> durations;
+    QJsonObject stored = loadTimingCache()["durations"].toObject();
+    for (auto it = stored.constBegin(); it != stored.constEnd(); ++it) {
+        qint64 duration = it.value().toVariant().toLongLong();
+        if (duration > 0) {
+            durations.insert(it.key(), duration);
+        }
+    }
+    return durations;
+}
+
+void NetworkClient::saveCachedDurations(const QHash<QString, qint64> &durations)
+{
+    QJsonObject stored;
+    for (auto it = durations.constBegin(); it != durations.constEnd(); ++it) {
+        if (it.value() > 0) {
+            stored[it.key()] = it.value();
+        }
+    }
+    
+    QJsonObject timing = loadTimingCache();
+    timing["durations"] = stored;
+    saveTimingCache(timing);
+}
+
 bool NetworkClient::loadCachedSchedule()
 {
+    // The binary snapshot holds the already-parsed schedule
+    ClientSnapshot &snapshot = ClientSnapshot::instance();
+    if (snapshot.hasSchedule()) {
+        ScheduleSnapshot cached = snapshot.schedule();
+        m_hostname = cached.hostname;
+        LOG_INFO_CAT("Loaded schedule from client snapshot", "Network");
+        emit scheduleReceived(cached.schoolStart, cached.schoolEnd, cached.blocks);
+        return true;
+    }
+    
     QString schedulePath = m_cacheDir + "/schedule_cache.json";
     QFile file(schedulePath);
     
@@ -755,6 +888,17 @@ bool NetworkClient::loadCachedSchedule()
 
 bool NetworkClient::loadCachedPlaylist()
 {
+    // Snapshot item URLs are already absolute, so only use them for the same server
+    ClientSnapshot &snapshot = ClientSnapshot::instance();
+    if (snapshot.hasPlaylist() && snapshot.lastServer() == m_serverUrl) {
+        MediaPlaylist cached = snapshot.playlist();
+        if (cached.hasItems()) {
+            LOG_INFO_CAT("Loaded playlist from client snapshot", "Network");
+            emit playlistReceived(cached);
+            return true;
+        }
+    }
+    
     QString playlistPath = m_cacheDir + "/playlist_cache.json";
     QFile file(playlistPath);
     
@@ -782,23 +926,38 @@ bool NetworkClient::loadCachedPlaylist()
 void NetworkClient::fetchServerTime()
 {
     if (!m_connected) {
-        LOG_DEBUG_CAT("Not connected to server, attempting internet time sync", "Network");
-        syncTimeFromInternet();
+        // The internet source is only a bootstrap: once the server clock has
+        // locked, mixing sources is what makes displays disagree
+        if (!m_clock.isSynced()) {
+            LOG_DEBUG_CAT("Not connected to server, attempting internet time sync", "Network");
+            syncTimeFromInternet();
+        } else {
+            LOG_DEBUG_CAT("Not connected to server, free-running on disciplined clock", "Network");
+        }
         return;
     }
     
+    if (m_timeBurstRemaining > 0) {
+        return; // Burst already in progress
+    }
+    
+    m_timeBurstRemaining = m_clock.burstSize();
+    LOG_DEBUG_CAT(QString("Requesting server time sync (burst of %1)").arg(m_timeBurstRemaining), "Network");
+    sendTimeRequest();
+}
+
+void NetworkClient::sendTimeRequest()
+{
     QNetworkRequest request(QUrl(m_serverUrl + "/api/time"));
     request.setRawHeader("User-Agent", "VideoTimeline Client");
     request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
     
-    // Record when we send the request (for round-trip compensation)
+    // Record when we send the request (t0 of the exchange)
     qint64 requestTime = QDateTime::currentMSecsSinceEpoch();
     
     QNetworkReply *reply = m_networkManager->get(request);
     reply->setProperty("request_time", requestTime);
     connect(reply, &QNetworkReply::finished, this, &NetworkClient::onTimeReplyFinished);
-    
-    LOG_DEBUG_CAT("Requesting server time sync", "Network");
 }
 
 void NetworkClient::onTimeReplyFinished()
@@ -808,7 +967,7 @@ void NetworkClient::onTimeReplyFinished()
     
     qint64 requestTime = reply->property("request_time").toLongLong();
     qint64 responseTime = QDateTime::currentMSecsSinceEpoch();
-    qint64 roundTripMs = responseTime - requestTime;
+    m_timeBurstRemaining--;
     
     if (reply->error() == QNetworkReply::NoError) {
         QByteArray data = reply->readAll();
@@ -818,54 +977,84 @@ void NetworkClient::onTimeReplyFinished()
         if (error.error == QJsonParseError::NoError && doc.isObject()) {
             QJsonObject timeObj = doc.object();
             
-            // Server should return Unix timestamp in milliseconds or ISO string
-            qint64 serverTimeMs = 0;
-            if (timeObj.contains("timestamp")) {
-                serverTimeMs = timeObj["timestamp"].toVariant().toLongLong();
+            ClockSample sample;
+            sample.t0 = requestTime;
+            sample.t3 = responseTime;
+            
+            // Newer servers report when they received the request and when they
+            // sent the reply; older ones only a single timestamp or ISO string
+            if (timeObj.contains("receive_timestamp") && timeObj.contains("transmit_timestamp")) {
+                sample.t1 = timeObj["receive_timestamp"].toVariant().toLongLong();
+                sample.t2 = timeObj["transmit_timestamp"].toVariant().toLongLong();
+            } else if (timeObj.contains("timestamp")) {
+                sample.t1 = sample.t2 = timeObj["timestamp"].toVariant().toLongLong();
             } else if (timeObj.contains("datetime")) {
                 QString isoString = timeObj["datetime"].toString();
                 QDateTime serverDateTime = QDateTime::fromString(isoString, Qt::ISODate);
                 if (serverDateTime.isValid()) {
-                    serverTimeMs = serverDateTime.toMSecsSinceEpoch();
+                    sample.t1 = sample.t2 = serverDateTime.toMSecsSinceEpoch();
                 }
             }
             
-            if (serverTimeMs > 0) {
-                // Compensate for network latency (assume half round-trip time)
-                serverTimeMs += roundTripMs / 2;
-                
-                // Calculate offset
-                qint64 localTimeMs = QDateTime::currentMSecsSinceEpoch();
-                m_timeOffsetMs = serverTimeMs - localTimeMs;
-                m_timeSynced = true;
-                m_lastSyncTime = QDateTime::currentDateTime();
-                
-                LOG_INFO_CAT(QString("Time synced with server: offset=%1ms, RTT=%2ms")
-                    .arg(m_timeOffsetMs)
-                    .arg(roundTripMs), "Network");
-                
-                QDateTime syncedTime = QDateTime::fromMSecsSinceEpoch(serverTimeMs);
-                emit serverTimeReceived(syncedTime, m_timeOffsetMs);
+            if (sample.t1 > 0) {
+                m_clock.addSample(sample);
             } else {
                 LOG_WARNING_CAT("Invalid server time response", "Network");
                 emit timeSyncFailed("Invalid server time format");
-                // Fallback to internet time
-                syncTimeFromInternet();
             }
         } else {
             LOG_ERROR_CAT(QString("Failed to parse time JSON: %1").arg(error.errorString()), "Network");
             emit timeSyncFailed("Failed to parse server time response");
-            // Fallback to internet time
-            syncTimeFromInternet();
         }
     } else {
         LOG_ERROR_CAT(QString("Time sync error: %1").arg(reply->errorString()), "Network");
         emit timeSyncFailed(reply->errorString());
-        // Fallback to internet time
-        syncTimeFromInternet();
+        m_timeBurstRemaining = 0; // Server unreachable, don't keep hammering it
     }
     
     reply->deleteLater();
+    
+    // Requests within a burst are sequential so they don't queue behind each other
+    if (m_timeBurstRemaining > 0) {
+        sendTimeRequest();
+    } else {
+        finishTimeBurst();
+    }
+}
+
+void NetworkClient::finishTimeBurst()
+{
+    m_timeBurstRemaining = 0;
+    
+    if (m_clock.pendingSamples() == 0) {
+        // Nothing usable from the server; bootstrap from the internet if we have no clock yet
+        if (!m_clock.isSynced()) {
+            syncTimeFromInternet();
+        }
+        return;
+    }
+    
+    qint64 localMs = QDateTime::currentMSecsSinceEpoch();
+    bool accepted = m_clock.commitBurst(localMs);
+    ClockStats stats = m_clock.stats(localMs);
+    m_timeSyncTimer->setInterval(m_clock.pollIntervalMs());
+    
+    if (!accepted) {
+        LOG_DEBUG_CAT(QString("Time sync burst rejected as outlier (delay=%1ms)")
+            .arg(stats.lastDelayMs), "Network");
+        return;
+    }
+    
+    m_lastSyncTime = QDateTime::currentDateTime();
+    LOG_INFO_CAT(QString("Time synced with server: offset=%1ms (target %2ms), jitter=%3ms, drift=%4ppm, delay=%5ms, next poll %6s")
+        .arg(stats.offsetMs, 0, 'f', 1)
+        .arg(stats.targetOffsetMs, 0, 'f', 1)
+        .arg(stats.jitterMs, 0, 'f', 2)
+        .arg(stats.driftPpm, 0, 'f', 1)
+        .arg(stats.lastDelayMs)
+        .arg(stats.pollIntervalSecs), "Network");
+    
+    emit serverTimeReceived(getCurrentDateTime(), qRound64(stats.offsetMs));
 }
 
 void NetworkClient::syncTimeFromInternet()
@@ -947,8 +1136,11 @@ QDateTime NetworkClient::getCurrentDateTime() const
         return m_testDateTime;
     }
     
-    if (m_timeSynced) {
-        // Return synchronized time with offset applied
+    if (m_clock.isSynced()) {
+        // Disciplined server time (slewed, never jumps for small corrections)
+        return QDateTime::fromMSecsSinceEpoch(m_clock.correctedTime(QDateTime::currentMSecsSinceEpoch()));
+    } else if (m_timeSynced) {
+        // Coarse internet offset until the server clock locks
         qint64 localTimeMs = QDateTime::currentMSecsSinceEpoch();
         qint64 syncedTimeMs = localTimeMs + m_timeOffsetMs;
         return QDateTime::fromMSecsSinceEpoch(syncedTimeMs);
@@ -958,6 +1150,11 @@ QDateTime NetworkClient::getCurrentDateTime() const
     }
 }
 
+ClockStats NetworkClient::getClockStats() const
+{
+    return m_clock.stats(QDateTime::currentMSecsSinceEpoch());
+}
+
 void NetworkClient::setTestDateTime(const QDateTime &testDateTime)
 {
     m_testDateTime = testDateTime;
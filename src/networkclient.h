@@ -9,10 +9,12 @@
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QList>
+#include <QHash>
 #include <QString>
 #include <QHostAddress>
 #include <QNetworkInterface>
 #include <QAbstractSocket>
+#include "clockdiscipline.h"
 
 struct ScheduleBlock {
     QTime startTime;
@@ -22,15 +24,17 @@ struct ScheduleBlock {
 };
 
 struct MediaItem {
-    QString type; // "video", "image", or "screen"
+    QString type; // "video", "image", "screen", or "stream"
     QString url;
-    int duration; // in milliseconds (for images) or -1 for full video duration, ignored for screen
+    int duration; // in milliseconds (for images and streams) or -1 for full video duration, ignored for screen
     bool muted; // for videos, ignored for images and screen
     // Optional per-item custom trigger time (HH:MM). If set, this item should be
     // played exactly at that time during special playlists. hasCustomTime indicates
     // whether customTime is valid.
     QTime customTime;
     bool hasCustomTime = false;
+    // MediaCache key for url, computed once when the playlist is parsed
+    QString cacheKey;
 };
 
 struct MediaPlaylist {
@@ -40,6 +44,9 @@ struct MediaPlaylist {
     // Optional special date for playlists loaded from JSON (YYYY-MM-DD)
     QDate specialDate;
     QString title;
+    // Lockstep scheduling: start of the first loop (ms since epoch) as published
+    // by the server; 0 means items advance on local timers
+    qint64 epochMs = 0;
 
     MediaPlaylist() : currentIndex(0) {}
     
@@ -56,6 +63,23 @@ struct MediaPlaylist {
     bool hasItems() const {
         return !items.isEmpty();
     }
+    
+    // Same items, timing, schedule and mode (ignores the playback position)
+    bool hasSameContent(const MediaPlaylist &other) const {
+        if (isSpecial != other.isSpecial || epochMs != other.epochMs || specialDate != other.specialDate ||
+            title != other.title || items.size() != other.items.size()) {
+            return false;
+        }
+        for (int i = 0; i < items.size(); ++i) {
+            const MediaItem &a = items.at(i);
+            const MediaItem &b = other.items.at(i);
+            if (a.type != b.type || a.url != b.url || a.duration != b.duration || a.muted != b.muted ||
+                a.hasCustomTime != b.hasCustomTime || (a.hasCustomTime && a.customTime != b.customTime)) {
+                return false;
+            }
+        }
+        return true;
+    }
 };
 
 class NetworkClient : public QObject
@@ -78,7 +102,17 @@ public:
     QString getServerUrl() const { return m_serverUrl; }
     QString getHostname() const { return m_hostname; }
     QDateTime getCurrentDateTime() const; // Get synchronized time (server or system)
+    ClockStats getClockStats() const; // Offset/jitter/drift of the disciplined clock
     void setTestDateTime(const QDateTime &testDateTime); // Set test date/time for simulation
+    bool isUsingTestDateTime() const { return m_useTestDateTime; }
+    
+    // Probed media durations (url -> ms), persisted next to the cached playlist
+    QHash<QString, qint64> loadCachedDurations() const;
+    void saveCachedDurations(const QHash<QString, qint64> &durations);
+    
+    // Tells the server how a video decoded here, so it can send a lighter
+    // rendition to displays that can't keep up
+    void postDecodeReport(const QJsonObject &report);
 
 signals:
     void scheduleReceived(const QTime &schoolStart, const QTime &schoolEnd, 
@@ -120,8 +154,10 @@ private:
     
     // Time synchronization
     QDateTime m_lastSyncTime; // Last time we synced with server
-    qint64 m_timeOffsetMs = 0; // Offset between local and server time (ms)
-    bool m_timeSynced = false;
+    ClockDiscipline m_clock; // Disciplined server clock (burst sampled, slewed)
+    int m_timeBurstRemaining = 0; // Requests left in the current sampling burst
+    qint64 m_timeOffsetMs = 0; // Coarse internet fallback offset, used only until the server clock locks
+    bool m_timeSynced = false; // Whether the internet fallback offset is valid
     QTimer *m_timeSyncTimer; // Periodic time sync timer
     
     // Test date/time simulation
@@ -136,6 +172,10 @@ private:
     void resetBackoff();
     void increaseBackoff();
     
+    // Time sync helpers
+    void sendTimeRequest();
+    void finishTimeBurst();
+    
     // Schedule/playlist helpers
     QList<ScheduleBlock> createDefaultSchedule();
     void parseScheduleJson(const QJsonObject &json);
@@ -147,6 +187,9 @@ private:
     bool loadCachedSchedule();
     bool loadCachedPlaylist();
     void ensureCacheDir();
+    QJsonObject loadTimingCache() const;
+    void saveTimingCache(const QJsonObject &json);
+    qint64 localPlaylistEpoch(const MediaPlaylist &playlist);
 };
 
 #endif // NETWORKCLIENT_H
@@ -0,0 +1,293 @@
+#include "playbackmetrics.h"
+#include "networkclient.h"
+#include "logger.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QtMath>
+
+// Bucket bounds, ms: fine where the interesting values are, coarse beyond
+static const QList<int> FIRST_FRAME_BOUNDS = {50, 100, 200, 300, 500, 750, 1000, 1500, 2000, 3000, 5000, 10000};
+static const QList<int> FADE_BOUNDS = {100, 200, 300, 400, 500, 750, 1000, 1500, 2000, 3000};
+static const QList<int> STALL_BOUNDS = {100, 250, 500, 1000, 2000, 5000, 10000, 30000};
+// Around 60, 50, 30, 25 and 24 fps, then dropped frames
+static const QList<int> FRAME_INTERVAL_BOUNDS = {10, 17, 20, 25, 34, 42, 50, 67, 84, 100, 150, 250, 500, 1000};
+
+// --- MsHistogram ---
+
+MsHistogram::MsHistogram(const QList<int> &boundsMs)
+    : m_boundsMs(boundsMs)
+{
+    m_counts.fill(0, boundsMs.size() + 1);
+}
+
+void MsHistogram::add(double ms)
+{
+    if (m_counts.isEmpty()) {
+        return; // Default-constructed, no buckets
+    }
+    int bucket = 0;
+    while (bucket < m_boundsMs.size() && ms > m_boundsMs.at(bucket)) {
+        bucket++;
+    }
+    m_counts[bucket]++;
+    m_count++;
+    m_sumMs += ms;
+    m_maxMs = qMax(m_maxMs, ms);
+}
+
+double MsHistogram::percentileMs(double fraction) const
+{
+    if (m_count == 0) {
+        return 0.0;
+    }
+    int rank = qMax(1, qCeil(fraction * m_count));
+    int seen = 0;
+    for (int bucket = 0; bucket < m_counts.size(); ++bucket) {
+        seen += m_counts.at(bucket);
+        if (seen >= rank) {
+            // A bound can be above every sample in its bucket
+            return bucket < m_boundsMs.size() ? qMin<double>(m_boundsMs.at(bucket), m_maxMs) : m_maxMs;
+        }
+    }
+    return m_maxMs;
+}
+
+QString MsHistogram::summary() const
+{
+    if (m_count == 0) {
+        return "--";
+    }
+    return QString("p50 %1, p95 %2, max %3 ms (n=%4)")
+        .arg(percentileMs(0.5), 0, 'f', 0)
+        .arg(percentileMs(0.95), 0, 'f', 0)
+        .arg(m_maxMs, 0, 'f', 0)
+        .arg(m_count);
+}
+
+QJsonObject MsHistogram::toJson() const
+{
+    QJsonArray buckets;
+    for (int bucket = 0; bucket < m_counts.size(); ++bucket) {
+        QJsonObject entry;
+        // The open-ended last bucket has no bound: "le" is left out
+        if (bucket < m_boundsMs.size()) {
+            entry["le"] = m_boundsMs.at(bucket);
+        }
+        entry["count"] = m_counts.at(bucket);
+        buckets.append(entry);
+    }
+
+    QJsonObject json;
+    json["count"] = m_count;
+    json["mean"] = meanMs();
+    json["p50"] = percentileMs(0.5);
+    json["p95"] = percentileMs(0.95);
+    json["p99"] = percentileMs(0.99);
+    json["max"] = m_maxMs;
+    json["buckets"] = buckets;
+    return json;
+}
+
+// --- ItemPlayback / PlaybackStats ---
+
+QJsonObject ItemPlayback::toJson() const
+{
+    QJsonObject json;
+    json["type"] = type;
+    json["url"] = url;
+    json["source"] = source;
+    json["startedAt"] = QDateTime::fromMSecsSinceEpoch(startedAt).toString(Qt::ISODateWithMs);
+    json["firstFrameMs"] = firstFrameMs;
+    json["fadeMs"] = fadeMs;
+    json["stalls"] = stalls;
+    json["stalledMs"] = stalledMs;
+    json["frames"] = frames;
+    json["lateFrames"] = lateFrames;
+    json["worstIntervalMs"] = worstIntervalMs;
+    json["onScreenMs"] = onScreenMs;
+    return json;
+}
+
+QJsonObject PlaybackStats::toJson() const
+{
+    QJsonArray recentItems;
+    for (const ItemPlayback &item : recent) {
+        recentItems.append(item.toJson());
+    }
+
+    QJsonObject json;
+    json["generatedAt"] = QDateTime::currentDateTime().toString(Qt::ISODateWithMs);
+    json["items"] = items;
+    json["stalls"] = stalls;
+    json["frames"] = frames;
+    json["lateFrames"] = lateFrames;
+    json["firstFrameMs"] = firstFrame.toJson();
+    json["fadeMs"] = fade.toJson();
+    json["stallMs"] = stall.toJson();
+    json["frameIntervalMs"] = frameInterval.toJson();
+    if (hasCurrent) {
+        json["current"] = current.toJson();
+    }
+    json["recent"] = recentItems;
+    return json;
+}
+
+// --- PlaybackMetrics ---
+
+PlaybackMetrics::PlaybackMetrics()
+{
+    m_stats.firstFrame = MsHistogram(FIRST_FRAME_BOUNDS);
+    m_stats.fade = MsHistogram(FADE_BOUNDS);
+    m_stats.stall = MsHistogram(STALL_BOUNDS);
+    m_stats.frameInterval = MsHistogram(FRAME_INTERVAL_BOUNDS);
+}
+
+void PlaybackMetrics::itemStarted(const MediaItem &item, const QString &source)
+{
+    itemEnded();
+    m_current = ItemPlayback();
+    m_current.type = item.type;
+    m_current.url = item.url;
+    m_current.source = source;
+    m_current.startedAt = QDateTime::currentMSecsSinceEpoch();
+    m_hasCurrent = true;
+    m_itemClock.start();
+    m_frameClock.invalidate();
+    m_nominalIntervalMs = 0.0; // Learned again from the item's metadata
+}
+
+void PlaybackMetrics::itemEnded()
+{
+    if (!m_hasCurrent) {
+        return;
+    }
+    stallEnded();
+    m_fadeClock.invalidate(); // Cut short: not a duration the fade achieved
+    m_current.onScreenMs = m_itemClock.elapsed();
+    m_hasCurrent = false;
+
+    m_stats.items++;
+    if (m_current.firstFrameMs >= 0) {
+        m_stats.firstFrame.add(m_current.firstFrameMs);
+    }
+    if (m_current.fadeMs >= 0) {
+        m_stats.fade.add(m_current.fadeMs);
+    }
+    m_stats.recent.append(m_current);
+    while (m_stats.recent.size() > RECENT_ITEMS) {
+        m_stats.recent.removeFirst();
+    }
+
+    LOG_DEBUG_CAT(QString("%1 from %2: first frame %3 ms, fade %4 ms, %5 stalls (%6 ms), %7 frames (%8 late)")
+        .arg(m_current.url, m_current.source)
+        .arg(m_current.firstFrameMs)
+        .arg(m_current.fadeMs)
+        .arg(m_current.stalls)
+        .arg(m_current.stalledMs)
+        .arg(m_current.frames)
+        .arg(m_current.lateFrames), "Playback");
+}
+
+void PlaybackMetrics::firstFrameShown()
+{
+    if (!m_hasCurrent || m_current.firstFrameMs >= 0) {
+        return;
+    }
+    m_current.firstFrameMs = m_itemClock.elapsed();
+}
+
+void PlaybackMetrics::fadeStarted()
+{
+    if (m_hasCurrent && !m_fadeClock.isValid()) {
+        m_fadeClock.start();
+    }
+}
+
+void PlaybackMetrics::fadeFinished()
+{
+    if (!m_hasCurrent || !m_fadeClock.isValid()) {
+        return;
+    }
+    m_current.fadeMs = m_fadeClock.elapsed();
+    m_fadeClock.invalidate();
+}
+
+void PlaybackMetrics::stallStarted()
+{
+    // Before the first frame it is loading, which firstFrameMs already covers
+    if (!hasFirstFrame() || m_stallClock.isValid()) {
+        return;
+    }
+    m_current.stalls++;
+    m_stats.stalls++;
+    m_stallClock.start();
+}
+
+void PlaybackMetrics::stallEnded()
+{
+    if (!m_stallClock.isValid()) {
+        return;
+    }
+    qint64 stalledMs = m_stallClock.elapsed();
+    m_stallClock.invalidate();
+    m_current.stalledMs += stalledMs;
+    m_stats.stall.add(stalledMs);
+    m_frameClock.invalidate(); // The gap is counted as a stall, not as a frame interval
+}
+
+void PlaybackMetrics::frameDelivered()
+{
+    if (!m_hasCurrent) {
+        return;
+    }
+    m_current.frames++;
+    m_stats.frames++;
+    if (m_frameClock.isValid()) {
+        double intervalMs = m_frameClock.nsecsElapsed() / 1e6;
+        m_stats.frameInterval.add(intervalMs);
+        m_current.worstIntervalMs = qMax(m_current.worstIntervalMs, intervalMs);
+        if (m_nominalIntervalMs > 0.0 && intervalMs > m_nominalIntervalMs * 1.5) {
+            m_current.lateFrames++;
+            m_stats.lateFrames++;
+        }
+    }
+    m_frameClock.start();
+}
+
+void PlaybackMetrics::setNominalFrameRate(qreal fps)
+{
+    m_nominalIntervalMs = fps > 0.0 ? 1000.0 / fps : 0.0;
+}
+
+PlaybackStats PlaybackMetrics::stats() const
+{
+    PlaybackStats stats = m_stats;
+    stats.hasCurrent = m_hasCurrent;
+    if (m_hasCurrent) {
+        stats.current = m_current;
+        stats.current.onScreenMs = m_itemClock.elapsed();
+    }
+    return stats;
+}
+
+bool PlaybackMetrics::writeJson(const QString &path) const
+{
+    QDir().mkpath(QFileInfo(path).absolutePath());
+
+    // Read by collectors while we play: replaced whole, never seen half-written
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        LOG_WARNING_CAT(QString("Failed to write playback metrics: %1").arg(file.errorString()), "Playback");
+        return false;
+    }
+    file.write(QJsonDocument(stats().toJson()).toJson());
+    if (!file.commit()) {
+        LOG_WARNING_CAT(QString("Failed to commit playback metrics: %1").arg(file.errorString()), "Playback");
+        return false;
+    }
+    return true;
+}
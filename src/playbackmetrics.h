@@ -0,0 +1,117 @@
+#ifndef PLAYBACKMETRICS_H
+#define PLAYBACKMETRICS_H
+
+#include <QString>
+#include <QList>
+#include <QJsonObject>
+#include <QElapsedTimer>
+
+struct MediaItem;
+
+// Millisecond samples counted into fixed buckets. Percentiles come from the
+// bucket bounds, so they are as fine as the bounds are; the last bucket is
+// open-ended and reads as the largest sample seen.
+class MsHistogram
+{
+public:
+    MsHistogram() = default;
+    explicit MsHistogram(const QList<int> &boundsMs); // Ascending upper bounds
+
+    void add(double ms);
+    int count() const { return m_count; }
+    double meanMs() const { return m_count > 0 ? m_sumMs / m_count : 0.0; }
+    double maxMs() const { return m_maxMs; }
+    double percentileMs(double fraction) const;
+    QString summary() const; // "p50 120, p95 480, max 610 ms (n=42)"
+    QJsonObject toJson() const;
+
+private:
+    QList<int> m_boundsMs;
+    QList<int> m_counts; // One per bound, plus the open-ended last bucket
+    int m_count = 0;
+    double m_sumMs = 0.0;
+    double m_maxMs = 0.0;
+};
+
+// Moving average of a per-frame measurement; samples counts this one, so
+// the first sample is taken as is and each later one weighs a fifth
+inline double movingAverage(double average, double sample, int samples)
+{
+    return samples <= 1 ? sample : average * 0.8 + sample * 0.2;
+}
+
+// What happened while one playlist item was on screen
+struct ItemPlayback {
+    QString type;
+    QString url;
+    QString source;             // cache, network, local, decoded, preroll, capture or stream
+    qint64 startedAt = 0;       // Local ms since epoch
+    qint64 firstFrameMs = -1;   // From the switch to the first frame on screen
+    qint64 fadeMs = -1;         // Crossfade into the item as it actually ran
+    int stalls = 0;
+    qint64 stalledMs = 0;
+    int frames = 0;             // Delivered to the video sink
+    int lateFrames = 0;         // Interval over 1.5x the nominal frame time
+    double worstIntervalMs = 0.0;
+    qint64 onScreenMs = 0;
+
+    QJsonObject toJson() const;
+};
+
+struct PlaybackStats {
+    int items = 0;
+    int stalls = 0;
+    int frames = 0;
+    int lateFrames = 0;
+    MsHistogram firstFrame;
+    MsHistogram fade;
+    MsHistogram stall;
+    MsHistogram frameInterval;
+    bool hasCurrent = false;
+    ItemPlayback current;
+    QList<ItemPlayback> recent; // Finished items, oldest first
+
+    QJsonObject toJson() const;
+};
+
+// Per-item playback instrumentation for MediaPlayer, which reports the
+// events as they happen: an item starting (and where its media came from),
+// its first frame on screen, the crossfade into it, buffering stalls and
+// every frame the video sink delivers. A finished item goes into the
+// histograms and a short history; the whole lot is available as JSON for
+// collection off the device.
+class PlaybackMetrics
+{
+public:
+    PlaybackMetrics();
+
+    void itemStarted(const MediaItem &item, const QString &source);
+    void itemEnded();
+    void firstFrameShown(); // Ignored after the first
+    void fadeStarted();
+    void fadeFinished();
+    void stallStarted();
+    void stallEnded();
+    void frameDelivered();
+    void setNominalFrameRate(qreal fps); // 0 if unknown: no frames are counted late
+
+    bool hasCurrent() const { return m_hasCurrent; }
+    bool hasFirstFrame() const { return m_hasCurrent && m_current.firstFrameMs >= 0; }
+    const ItemPlayback &current() const { return m_current; }
+    PlaybackStats stats() const;
+    bool writeJson(const QString &path) const;
+
+private:
+    PlaybackStats m_stats;
+    ItemPlayback m_current;
+    bool m_hasCurrent = false;
+    QElapsedTimer m_itemClock;
+    QElapsedTimer m_fadeClock;  // Valid while a crossfade runs
+    QElapsedTimer m_stallClock; // Valid while stalled
+    QElapsedTimer m_frameClock; // Since the last delivered frame
+    double m_nominalIntervalMs = 0.0;
+
+    static const int RECENT_ITEMS = 50;
+};
+
+#endif // PLAYBACKMETRICS_H
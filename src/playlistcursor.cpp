@@ -0,0 +1,39 @@
+#include "playlistcursor.h"
+#include <algorithm>
+
+void PlaylistCursor::rebuild(const QList<qint64> &durationsMs)
+{
+    m_ends.clear();
+    m_ends.reserve(durationsMs.size());
+
+    qint64 total = 0;
+    for (qint64 duration : durationsMs) {
+        if (duration <= 0) {
+            m_ends.clear(); // Unknown duration, no schedule can be agreed on yet
+            return;
+        }
+        total += duration;
+        m_ends.append(total);
+    }
+}
+
+PlaylistCursor::Position PlaylistCursor::positionAt(qint64 epochMs, qint64 timeMs) const
+{
+    Position position;
+    if (m_ends.isEmpty()) {
+        return position;
+    }
+
+    qint64 cycle = m_ends.last();
+    qint64 loopOffset = (timeMs - epochMs) % cycle;
+    if (loopOffset < 0) {
+        loopOffset += cycle; // Epoch slightly in the future (clock not yet synced)
+    }
+
+    // First item whose end is past the loop offset
+    auto it = std::upper_bound(m_ends.cbegin(), m_ends.cend(), loopOffset);
+    position.index = static_cast<int>(it - m_ends.cbegin());
+    position.offsetMs = loopOffset - startOf(position.index);
+    position.remainingMs = *it - loopOffset;
+    return position;
+}
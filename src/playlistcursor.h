@@ -0,0 +1,36 @@
+#ifndef PLAYLISTCURSOR_H
+#define PLAYLISTCURSOR_H
+
+#include <QtGlobal>
+#include <QList>
+
+// Resolves "which item, and how far into it, should be on screen at time T"
+// for a looping playlist that started at a known epoch. Cumulative item end
+// offsets are precomputed so each lookup is a binary search.
+class PlaylistCursor
+{
+public:
+    struct Position {
+        int index = -1;
+        qint64 offsetMs = 0;    // Time into the item
+        qint64 remainingMs = 0; // Time until the next item starts
+
+        bool isValid() const { return index >= 0; }
+    };
+
+    // Rebuild from per-item durations; any duration <= 0 leaves the cursor invalid
+    void rebuild(const QList<qint64> &durationsMs);
+    void clear() { m_ends.clear(); }
+
+    bool isValid() const { return !m_ends.isEmpty(); }
+    int itemCount() const { return m_ends.size(); }
+    qint64 cycleMs() const { return m_ends.isEmpty() ? 0 : m_ends.last(); }
+    qint64 startOf(int index) const { return index > 0 ? m_ends.at(index - 1) : 0; }
+
+    Position positionAt(qint64 epochMs, qint64 timeMs) const;
+
+private:
+    QList<qint64> m_ends; // m_ends[i] = end of item i relative to loop start
+};
+
+#endif // PLAYLISTCURSOR_H
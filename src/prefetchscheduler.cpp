@@ -0,0 +1,171 @@
+#include "prefetchscheduler.h"
+#include "mediacache.h"
+#include "logger.h"
+#include <QDateTime>
+#include <algorithm>
+
+PrefetchScheduler::PrefetchScheduler(MediaCache *cache, QObject *parent)
+    : QObject(parent)
+    , m_cache(cache)
+    , m_bandwidthBps(INITIAL_BANDWIDTH_BPS)
+{
+    connect(m_cache, &MediaCache::prefetchComplete, this, &PrefetchScheduler::onPrefetchComplete);
+    connect(m_cache, &MediaCache::transferMeasured, this, &PrefetchScheduler::onTransferMeasured);
+    connect(m_cache, &MediaCache::sizeProbed, this, &PrefetchScheduler::onSizeProbed);
+}
+
+void PrefetchScheduler::plan(const QList<PrefetchJob> &jobs)
+{
+    m_queue.clear();
+    QHash<QString, int> queuedIndex; // url -> position in m_queue
+    for (const PrefetchJob &job : jobs) {
+        if (m_active.contains(job.url) || m_cache->isCached(job.url, job.cacheKey)) {
+            continue;
+        }
+        // An item that appears twice only needs to be ready for its first showing
+        auto it = queuedIndex.constFind(job.url);
+        if (it != queuedIndex.constEnd()) {
+            PrefetchJob &queued = m_queue[it.value()];
+            queued.deadlineMs = qMin(queued.deadlineMs, job.deadlineMs);
+            continue;
+        }
+        queuedIndex.insert(job.url, m_queue.size());
+        m_queue.append(job);
+        if (!m_sizes.contains(job.url)) {
+            requestSize(job.url);
+        }
+    }
+
+    std::stable_sort(m_queue.begin(), m_queue.end(), [](const PrefetchJob &a, const PrefetchJob &b) {
+        return a.deadlineMs < b.deadlineMs;
+    });
+
+    // Sizes are only kept for what is still to be downloaded
+    for (auto it = m_sizes.begin(); it != m_sizes.end();) {
+        if (queuedIndex.contains(it.key()) || m_active.contains(it.key())) {
+            ++it;
+        } else {
+            it = m_sizes.erase(it);
+        }
+    }
+
+    LOG_DEBUG_CAT(QString("Prefetch plan: %1 queued, %2 active").arg(m_queue.size()).arg(m_active.size()),
+                  "Prefetch");
+    startJobs();
+}
+
+void PrefetchScheduler::clear()
+{
+    // Transfers already running are left to finish
+    m_queue.clear();
+}
+
+void PrefetchScheduler::startJobs()
+{
+    while (m_active.size() < MAX_ACTIVE && !m_queue.isEmpty()) {
+        PrefetchJob job = m_queue.takeFirst();
+        if (m_cache->isCached(job.url, job.cacheKey)) {
+            continue;
+        }
+        LOG_DEBUG_CAT(QString("Prefetching %1 (due in %2 ms)")
+                      .arg(job.url)
+                      .arg(job.deadlineMs - QDateTime::currentMSecsSinceEpoch()), "Prefetch");
+        m_active.insert(job.url, job);
+        m_cache->prefetchUrl(job.url, job.cacheKey);
+    }
+}
+
+void PrefetchScheduler::onPrefetchComplete(const QString &url, bool success)
+{
+    // A failed job is retried the next time it is planned, a finished one
+    // won't need its size again
+    if (success) {
+        m_sizes.remove(url);
+    }
+    if (m_active.remove(url) > 0) {
+        startJobs();
+    }
+}
+
+void PrefetchScheduler::onTransferMeasured(const QString &url, qint64 bytes, qint64 elapsedMs)
+{
+    Q_UNUSED(url);
+    if (bytes < MIN_SAMPLE_BYTES || elapsedMs <= 0) {
+        return;
+    }
+    // Parallel transfers share the link, so each one sees only its share of it
+    double sample = bytes * 1000.0 / elapsedMs * qMax(1, int(m_active.size()));
+    if (m_bandwidthMeasured) {
+        m_bandwidthBps = BANDWIDTH_ALPHA * sample + (1.0 - BANDWIDTH_ALPHA) * m_bandwidthBps;
+    } else {
+        m_bandwidthBps = sample;
+        m_bandwidthMeasured = true;
+    }
+    LOG_DEBUG_CAT(QString("Bandwidth estimate %1 KB/s (sample %2 KB/s)")
+                  .arg(m_bandwidthBps / 1024.0, 0, 'f', 0)
+                  .arg(sample / 1024.0, 0, 'f', 0), "Prefetch");
+}
+
+void PrefetchScheduler::requestSize(const QString &url)
+{
+    if (m_sizeRequests.contains(url)) {
+        return;
+    }
+    m_sizeRequests.insert(url);
+    m_cache->probeSize(url);
+}
+
+void PrefetchScheduler::onSizeProbed(const QString &url, qint64 bytes)
+{
+    if (!m_sizeRequests.remove(url)) {
+        return;
+    }
+    // Unless the job was dropped from the plan meanwhile
+    bool queued = std::any_of(m_queue.constBegin(), m_queue.constEnd(), [&url](const PrefetchJob &job) {
+        return job.url == url;
+    });
+    if (queued || m_active.contains(url)) {
+        m_sizes.insert(url, bytes);
+    }
+}
+
+qint64 PrefetchScheduler::estimatedBytes(const PrefetchJob &job) const
+{
+    return m_sizes.value(job.url, -1);
+}
+
+PrefetchStats PrefetchScheduler::stats() const
+{
+    PrefetchStats stats;
+    stats.queued = m_queue.size();
+    stats.active = m_active.size();
+    stats.bandwidthBps = m_bandwidthBps;
+    stats.bandwidthMeasured = m_bandwidthMeasured;
+
+    // Replay the schedule at the estimated bandwidth: jobs finish one after
+    // another in deadline order. Active jobs count in full since their
+    // progress isn't known here, which errs on the side of reporting a miss.
+    QList<PrefetchJob> jobs = m_active.values();
+    jobs.append(m_queue);
+    std::stable_sort(jobs.begin(), jobs.end(), [](const PrefetchJob &a, const PrefetchJob &b) {
+        return a.deadlineMs < b.deadlineMs;
+    });
+
+    double finishMs = QDateTime::currentMSecsSinceEpoch();
+    for (const PrefetchJob &job : jobs) {
+        qint64 bytes = estimatedBytes(job);
+        if (bytes < 0) {
+            continue; // Size unknown, can't predict
+        }
+        finishMs += bytes * 1000.0 / m_bandwidthBps;
+        qint64 lateMs = qRound64(finishMs) - job.deadlineMs;
+        if (lateMs > 0) {
+            if (stats.predictedMisses == 0) {
+                stats.firstMissUrl = job.url;
+                stats.firstMissLateMs = lateMs;
+            }
+            stats.predictedMisses++;
+        }
+    }
+    return stats;
+}
@@ -0,0 +1,73 @@
+#ifndef PREFETCHSCHEDULER_H
+#define PREFETCHSCHEDULER_H
+
+#include <QObject>
+#include <QString>
+#include <QList>
+#include <QHash>
+#include <QSet>
+
+class MediaCache;
+
+// An item that should be in the cache by a given time
+struct PrefetchJob {
+    QString url;
+    QString cacheKey;
+    qint64 deadlineMs = 0; // Local ms since epoch when the item goes on screen
+};
+
+struct PrefetchStats {
+    int queued = 0;
+    int active = 0;
+    double bandwidthBps = 0.0;  // Current throughput estimate, bytes/s
+    bool bandwidthMeasured = false;
+    int predictedMisses = 0;    // Queued/active items expected to arrive late
+    QString firstMissUrl;       // Earliest-deadline item among them
+    qint64 firstMissLateMs = 0; // How late it is expected to be
+};
+
+// Decides what MediaCache should download and in which order. MediaPlayer
+// hands it the upcoming items with the time each one goes on screen; jobs
+// are started earliest deadline first (EDF), at most MAX_ACTIVE at a time.
+// Throughput is estimated from finished transfers (EWMA) and file sizes are
+// learned with HEAD requests sent over MediaCache's connections; together
+// they give a predicted completion time per job, and so the items that will
+// probably miss their deadline.
+class PrefetchScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PrefetchScheduler(MediaCache *cache, QObject *parent = nullptr);
+
+    // Replace the queued (not yet started) jobs with this plan
+    void plan(const QList<PrefetchJob> &jobs);
+    void clear();
+
+    PrefetchStats stats() const;
+
+private slots:
+    void onPrefetchComplete(const QString &url, bool success);
+    void onTransferMeasured(const QString &url, qint64 bytes, qint64 elapsedMs);
+    void onSizeProbed(const QString &url, qint64 bytes);
+
+private:
+    void startJobs();
+    void requestSize(const QString &url);
+    qint64 estimatedBytes(const PrefetchJob &job) const; // -1 if unknown
+
+    MediaCache *m_cache;
+    QList<PrefetchJob> m_queue; // Sorted by deadline
+    QHash<QString, PrefetchJob> m_active; // url -> job being downloaded
+    QHash<QString, qint64> m_sizes; // url -> Content-Length (-1 if the server didn't say), queued/active jobs only
+    QSet<QString> m_sizeRequests; // HEAD requests in flight
+    double m_bandwidthBps;
+    bool m_bandwidthMeasured = false;
+
+    static const int MAX_ACTIVE = 2; // Parallel transfers; more just split the same link
+    static const qint64 MIN_SAMPLE_BYTES = 256 * 1024; // Smaller transfers measure latency, not throughput
+    static constexpr double BANDWIDTH_ALPHA = 0.3; // EWMA weight of the newest sample
+    static constexpr double INITIAL_BANDWIDTH_BPS = 2.0 * 1024 * 1024; // Until the first sample
+};
+
+#endif // PREFETCHSCHEDULER_H
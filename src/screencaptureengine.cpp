@@ -0,0 +1,187 @@
+#include "screencaptureengine.h"
+#include "simdkernels.h"
+#include "logger.h"
+#include "playbackmetrics.h"
+#include <QGuiApplication>
+#include <QScreen>
+#include <QPixmap>
+#include <QTimer>
+#include <QHash>
+#ifdef Q_OS_UNIX
+#include <time.h>
+#endif
+
+// CPU time of the calling thread; the X server's share of a grab is not in it
+static qint64 threadCpuNs()
+{
+#ifdef Q_OS_UNIX
+    timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0) {
+        return static_cast<qint64>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+    }
+#endif
+    return 0;
+}
+
+ScreenCaptureEngine::ScreenCaptureEngine(QObject *parent)
+    : QObject(parent)
+{
+    m_timer = new QTimer(this);
+    m_timer->setSingleShot(true);
+    connect(m_timer, &QTimer::timeout, this, &ScreenCaptureEngine::capture);
+}
+
+void ScreenCaptureEngine::start(const QSize &targetSize)
+{
+    m_targetSize = targetSize;
+    m_tileHashes.clear();
+    m_lastFailure = -1;
+    m_intervalMs = MIN_INTERVAL_MS;
+    m_stats = CaptureStats();
+    m_stats.active = true;
+    m_cpuNs = 0;
+    m_running.start();
+    LOG_DEBUG_CAT(QString("Screen capture started at %1x%2").arg(targetSize.width()).arg(targetSize.height()), "Capture");
+    capture();
+}
+
+void ScreenCaptureEngine::stop()
+{
+    m_timer->stop();
+    m_stats.active = false;
+}
+
+void ScreenCaptureEngine::setTargetSize(const QSize &size)
+{
+    if (size == m_targetSize) {
+        return;
+    }
+    m_targetSize = size;
+    m_tileHashes.clear();
+    if (isActive()) {
+        m_timer->stop();
+        capture();
+    }
+}
+
+bool ScreenCaptureEngine::isActive() const
+{
+    return m_stats.active;
+}
+
+CaptureStats ScreenCaptureEngine::stats() const
+{
+    CaptureStats stats = m_stats;
+    stats.intervalMs = m_intervalMs;
+    qint64 elapsedNs = m_running.isValid() ? m_running.nsecsElapsed() : 0;
+    stats.cpuLoad = elapsedNs > 0 ? static_cast<double>(m_cpuNs) / elapsedNs : 0.0;
+    return stats;
+}
+
+void ScreenCaptureEngine::capture()
+{
+    if (!isActive()) {
+        return;
+    }
+
+    QScreen *screen = QGuiApplication::primaryScreen();
+    if (!screen) {
+        fail(NoScreen);
+        return;
+    }
+    // Wayland doesn't let Qt grab the screen at all; no point retrying
+    if (qgetenv("XDG_SESSION_TYPE") == "wayland") {
+        fail(Wayland);
+        stop();
+        return;
+    }
+
+    QElapsedTimer latency;
+    latency.start();
+    qint64 cpuStart = threadCpuNs();
+
+    QPixmap grabbed = screen->grabWindow(0);
+    if (grabbed.isNull()) {
+        m_cpuNs += threadCpuNs() - cpuStart;
+        fail(GrabFailed);
+        return;
+    }
+    m_lastFailure = -1;
+
+    // Neither Qt nor X11 grab at a lower resolution, so reduce first: hashing
+    // and everything after it work on display-sized frames
+    QImage frame = SimdKernels::scaledToFit(grabbed.toImage(), m_targetSize);
+    grabbed = QPixmap();
+
+    double changedRatio = 0.0;
+    bool changed = compareTiles(frame, &changedRatio);
+
+    qint64 cpuNs = threadCpuNs() - cpuStart;
+    m_cpuNs += cpuNs;
+    m_stats.framesCaptured++;
+    m_stats.cpuMsPerFrame = movingAverage(m_stats.cpuMsPerFrame, cpuNs / 1e6, m_stats.framesCaptured);
+
+    if (changed) {
+        m_stats.framesChanged++;
+        m_stats.changedTileRatio = changedRatio;
+        m_stats.latencyMs = movingAverage(m_stats.latencyMs, latency.nsecsElapsed() / 1e6, m_stats.framesChanged);
+        // Moving content: follow it closely
+        m_intervalMs = MIN_INTERVAL_MS;
+        emit frameReady(frame);
+    } else {
+        // Still: back off gradually, so a pause in motion isn't a stall
+        m_intervalMs = qMin(MAX_INTERVAL_MS, m_intervalMs * 3 / 2);
+    }
+
+    if (isActive()) {
+        m_timer->start(m_intervalMs);
+    }
+}
+
+bool ScreenCaptureEngine::compareTiles(const QImage &frame, double *changedRatio)
+{
+    const int columns = (frame.width() + TILE_SIZE - 1) / TILE_SIZE;
+    const int rows = (frame.height() + TILE_SIZE - 1) / TILE_SIZE;
+    QVector<size_t> hashes(columns * rows);
+
+    for (int y = 0; y < frame.height(); ++y) {
+        const uchar *line = frame.constScanLine(y);
+        size_t *rowHashes = hashes.data() + (y / TILE_SIZE) * columns;
+        for (int column = 0; column < columns; ++column) {
+            int x = column * TILE_SIZE;
+            int width = qMin(TILE_SIZE, frame.width() - x);
+            // Chained through the tile's lines
+            rowHashes[column] = qHashBits(line + x * 4, static_cast<size_t>(width) * 4, rowHashes[column]);
+        }
+    }
+
+    bool first = m_tileHashes.size() != hashes.size();
+    int changed = 0;
+    for (int i = 0; i < hashes.size(); ++i) {
+        if (first || hashes.at(i) != m_tileHashes.at(i)) {
+            changed++;
+        }
+    }
+    *changedRatio = hashes.isEmpty() ? 0.0 : static_cast<double>(changed) / hashes.size();
+    if (changed > 0) {
+        m_tileHashes = hashes;
+    }
+    return changed > 0;
+}
+
+void ScreenCaptureEngine::fail(Failure failure)
+{
+    if (m_lastFailure != failure) {
+        m_lastFailure = failure;
+        static const char *reasons[] = { "no primary screen", "Wayland session", "grab returned nothing" };
+        LOG_WARNING_CAT(QString("Screen capture failed: %1").arg(reasons[failure]), "Capture");
+        emit captureFailed(failure);
+    }
+    // The placeholder is up now: the next good grab must replace it even
+    // if the screen hasn't changed since the last frame
+    m_tileHashes.clear();
+    m_intervalMs = RETRY_INTERVAL_MS;
+    if (isActive()) {
+        m_timer->start(m_intervalMs);
+    }
+}
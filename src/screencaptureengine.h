@@ -0,0 +1,69 @@
+#ifndef SCREENCAPTUREENGINE_H
+#define SCREENCAPTUREENGINE_H
+
+#include <QObject>
+#include <QImage>
+#include <QSize>
+#include <QVector>
+#include <QElapsedTimer>
+
+class QTimer;
+
+struct CaptureStats {
+    bool active = false;
+    int intervalMs = 0;            // Current time between captures
+    int framesCaptured = 0;
+    int framesChanged = 0;         // Delivered; the rest matched the frame before
+    double latencyMs = 0.0;        // Grab to frame ready, moving average
+    double cpuMsPerFrame = 0.0;    // Thread CPU time per capture, moving average
+    double cpuLoad = 0.0;          // Share of one core spent capturing since start()
+    double changedTileRatio = 0.0; // Of the last delivered frame
+};
+
+// Mirrors the primary screen for "screen" items. Each grab is reduced to the
+// display size straight away and compared with the previous frame tile by
+// tile; only frames that differ are delivered. The interval follows how often
+// the screen changes: MIN_INTERVAL_MS while content moves, backing off towards
+// MAX_INTERVAL_MS while it stands still.
+class ScreenCaptureEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Failure { NoScreen, Wayland, GrabFailed };
+
+    explicit ScreenCaptureEngine(QObject *parent = nullptr);
+
+    void start(const QSize &targetSize);
+    void stop();
+    void setTargetSize(const QSize &size); // The next capture is delivered regardless
+    bool isActive() const;
+    CaptureStats stats() const;
+
+signals:
+    void frameReady(const QImage &frame);
+    void captureFailed(ScreenCaptureEngine::Failure failure); // Once per failure kind in a row
+
+private slots:
+    void capture();
+
+private:
+    bool compareTiles(const QImage &frame, double *changedRatio); // Updates m_tileHashes
+    void fail(Failure failure);
+
+    QTimer *m_timer;
+    QSize m_targetSize;
+    QVector<size_t> m_tileHashes; // Of the last delivered frame, row by row
+    int m_lastFailure = -1;
+    int m_intervalMs = MIN_INTERVAL_MS;
+    CaptureStats m_stats;
+    QElapsedTimer m_running; // Since start(), for cpuLoad
+    qint64 m_cpuNs = 0;      // Spent capturing since start()
+
+    static constexpr int MIN_INTERVAL_MS = 66;    // About 15 fps while the screen changes
+    static constexpr int MAX_INTERVAL_MS = 1000;  // A still screen is checked once a second
+    static constexpr int RETRY_INTERVAL_MS = 2000; // After a failed grab
+    static constexpr int TILE_SIZE = 32;
+};
+
+#endif // SCREENCAPTUREENGINE_H
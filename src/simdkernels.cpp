@@ -0,0 +1,524 @@
+#include "simdkernels.h"
+#include <QElapsedTimer>
+#include <QPainter>
+#include <QTextStream>
+#include <QVector>
+#include <cstring>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_X86
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#define SIMD_NEON
+#define SIMD_NEON_TARGET
+#include <arm_neon.h>
+#elif defined(__GNUC__) && !defined(__clang__) && defined(__arm__) && defined(__linux__) && defined(__ARM_FP)
+// 32-bit hard-float builds (armhf) don't assume NEON; the kernels are
+// compiled for it anyway and only used if the kernel reports it
+#define SIMD_NEON
+#define SIMD_NEON_RUNTIME
+#define SIMD_NEON_TARGET __attribute__((target("fpu=neon")))
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+// Row primitives every kernel set provides. Bytes are channels; pixel
+// layout doesn't matter to them.
+struct KernelTable {
+    // dst = (a * (256 - weight) + b * weight) / 256, weight in 0..256
+    void (*lerpRow)(const uchar *a, const uchar *b, int weight, uchar *dst, int bytes);
+    // acc += src, widened to 16 bits
+    void (*accumulateRow)(const uchar *src, quint16 *acc, int bytes);
+};
+
+// --- Scalar ---
+
+static void lerpRowScalar(const uchar *a, const uchar *b, int weight, uchar *dst, int bytes)
+{
+    int inverse = 256 - weight;
+    for (int i = 0; i < bytes; ++i) {
+        dst[i] = static_cast<uchar>((a[i] * inverse + b[i] * weight) >> 8);
+    }
+}
+
+static void accumulateRowScalar(const uchar *src, quint16 *acc, int bytes)
+{
+    for (int i = 0; i < bytes; ++i) {
+        acc[i] += src[i];
+    }
+}
+
+// --- SSE2 / AVX2 ---
+// Built with target attributes rather than global -m flags, so the binary
+// still runs on CPUs without them; only called after detection says so
+
+#ifdef SIMD_X86
+__attribute__((target("sse2")))
+static void lerpRowSse2(const uchar *a, const uchar *b, int weight, uchar *dst, int bytes)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i weightA = _mm_set1_epi16(static_cast<short>(256 - weight));
+    const __m128i weightB = _mm_set1_epi16(static_cast<short>(weight));
+    int i = 0;
+    for (; i + 16 <= bytes; i += 16) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+        // At most 255 * 256 per lane, so 16 bits hold the sum
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(va, zero), weightA),
+                                   _mm_mullo_epi16(_mm_unpacklo_epi8(vb, zero), weightB));
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(va, zero), weightA),
+                                   _mm_mullo_epi16(_mm_unpackhi_epi8(vb, zero), weightB));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),
+                         _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8)));
+    }
+    lerpRowScalar(a + i, b + i, weight, dst + i, bytes - i);
+}
+
+__attribute__((target("sse2")))
+static void accumulateRowSse2(const uchar *src, quint16 *acc, int bytes)
+{
+    const __m128i zero = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 16 <= bytes; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        __m128i *lo = reinterpret_cast<__m128i *>(acc + i);
+        __m128i *hi = reinterpret_cast<__m128i *>(acc + i + 8);
+        _mm_storeu_si128(lo, _mm_add_epi16(_mm_loadu_si128(lo), _mm_unpacklo_epi8(v, zero)));
+        _mm_storeu_si128(hi, _mm_add_epi16(_mm_loadu_si128(hi), _mm_unpackhi_epi8(v, zero)));
+    }
+    accumulateRowScalar(src + i, acc + i, bytes - i);
+}
+
+__attribute__((target("avx2")))
+static void lerpRowAvx2(const uchar *a, const uchar *b, int weight, uchar *dst, int bytes)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i weightA = _mm256_set1_epi16(static_cast<short>(256 - weight));
+    const __m256i weightB = _mm256_set1_epi16(static_cast<short>(weight));
+    int i = 0;
+    for (; i + 32 <= bytes; i += 32) {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+        // Unpack and pack both work within 128-bit lanes, so the order comes back intact
+        __m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(va, zero), weightA),
+                                      _mm256_mullo_epi16(_mm256_unpacklo_epi8(vb, zero), weightB));
+        __m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(va, zero), weightA),
+                                      _mm256_mullo_epi16(_mm256_unpackhi_epi8(vb, zero), weightB));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i),
+                            _mm256_packus_epi16(_mm256_srli_epi16(lo, 8), _mm256_srli_epi16(hi, 8)));
+    }
+    lerpRowSse2(a + i, b + i, weight, dst + i, bytes - i);
+}
+
+__attribute__((target("avx2")))
+static void accumulateRowAvx2(const uchar *src, quint16 *acc, int bytes)
+{
+    int i = 0;
+    for (; i + 16 <= bytes; i += 16) {
+        __m256i v = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)));
+        __m256i *sum = reinterpret_cast<__m256i *>(acc + i);
+        _mm256_storeu_si256(sum, _mm256_add_epi16(_mm256_loadu_si256(sum), v));
+    }
+    accumulateRowScalar(src + i, acc + i, bytes - i);
+}
+#endif
+
+// --- NEON ---
+
+#ifdef SIMD_NEON
+SIMD_NEON_TARGET
+static void lerpRowNeon(const uchar *a, const uchar *b, int weight, uchar *dst, int bytes)
+{
+    // vmull_u8 takes 8-bit weights, so the ends of the range are copies
+    if (weight <= 0 || weight >= 256) {
+        std::memcpy(dst, weight <= 0 ? a : b, bytes);
+        return;
+    }
+    const uint8x8_t weightA = vdup_n_u8(static_cast<uint8_t>(256 - weight));
+    const uint8x8_t weightB = vdup_n_u8(static_cast<uint8_t>(weight));
+    int i = 0;
+    for (; i + 16 <= bytes; i += 16) {
+        uint8x16_t va = vld1q_u8(a + i);
+        uint8x16_t vb = vld1q_u8(b + i);
+        uint16x8_t lo = vmlal_u8(vmull_u8(vget_low_u8(va), weightA), vget_low_u8(vb), weightB);
+        uint16x8_t hi = vmlal_u8(vmull_u8(vget_high_u8(va), weightA), vget_high_u8(vb), weightB);
+        vst1q_u8(dst + i, vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8)));
+    }
+    lerpRowScalar(a + i, b + i, weight, dst + i, bytes - i);
+}
+
+SIMD_NEON_TARGET
+static void accumulateRowNeon(const uchar *src, quint16 *acc, int bytes)
+{
+    int i = 0;
+    for (; i + 16 <= bytes; i += 16) {
+        uint8x16_t v = vld1q_u8(src + i);
+        vst1q_u16(acc + i, vaddw_u8(vld1q_u16(acc + i), vget_low_u8(v)));
+        vst1q_u16(acc + i + 8, vaddw_u8(vld1q_u16(acc + i + 8), vget_high_u8(v)));
+    }
+    accumulateRowScalar(src + i, acc + i, bytes - i);
+}
+#endif
+
+// --- Dispatch ---
+
+static KernelTable tableFor(SimdKernels::Isa isa)
+{
+    switch (isa) {
+#ifdef SIMD_X86
+    case SimdKernels::Sse2:
+        return { lerpRowSse2, accumulateRowSse2 };
+    case SimdKernels::Avx2:
+        return { lerpRowAvx2, accumulateRowAvx2 };
+#endif
+#ifdef SIMD_NEON
+    case SimdKernels::Neon:
+        return { lerpRowNeon, accumulateRowNeon };
+#endif
+    default:
+        break;
+    }
+    return { lerpRowScalar, accumulateRowScalar };
+}
+
+static SimdKernels::Isa detectIsa()
+{
+#if defined(SIMD_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SimdKernels::Avx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return SimdKernels::Sse2;
+    }
+#elif defined(SIMD_NEON_RUNTIME)
+    if (getauxval(AT_HWCAP) & HWCAP_NEON) {
+        return SimdKernels::Neon;
+    }
+#elif defined(SIMD_NEON)
+    return SimdKernels::Neon; // Part of the baseline wherever __ARM_NEON is defined
+#endif
+    return SimdKernels::Scalar;
+}
+
+static SimdKernels::Isa s_isa = detectIsa();
+static KernelTable s_kernels = tableFor(s_isa);
+
+SimdKernels::Isa SimdKernels::activeIsa()
+{
+    return s_isa;
+}
+
+QList<SimdKernels::Isa> SimdKernels::supportedIsas()
+{
+    static const QList<Isa> isas = []() {
+        QList<Isa> result;
+        result.append(Scalar);
+        Isa best = detectIsa();
+        if (best == Avx2) {
+            result.append(Sse2);
+        }
+        if (best != Scalar) {
+            result.append(best);
+        }
+        return result;
+    }();
+    return isas;
+}
+
+QString SimdKernels::isaName(Isa isa)
+{
+    switch (isa) {
+    case Sse2:
+        return "SSE2";
+    case Avx2:
+        return "AVX2";
+    case Neon:
+        return "NEON";
+    case Scalar:
+        break;
+    }
+    return "scalar";
+}
+
+bool SimdKernels::setIsa(Isa isa)
+{
+    if (!supportedIsas().contains(isa)) {
+        return false;
+    }
+    s_isa = isa;
+    s_kernels = tableFor(isa);
+    return true;
+}
+
+// --- Kernels ---
+
+static QImage to32Bit(const QImage &src)
+{
+    // Premultiplied, so averaging and blending need no per-pixel alpha handling
+    QImage::Format format = src.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32;
+    return src.format() == format ? src : src.convertToFormat(format);
+}
+
+static inline quint32 lerpPixel(quint32 a, quint32 b, int weight)
+{
+    // Two channels at a time; 255 * 256 still fits the 16 bits each gets
+    int inverse = 256 - weight;
+    quint32 redBlue = ((((a & 0xff00ff) * inverse) + ((b & 0xff00ff) * weight)) >> 8) & 0xff00ff;
+    quint32 alphaGreen = ((((a >> 8) & 0xff00ff) * inverse) + (((b >> 8) & 0xff00ff) * weight)) & 0xff00ff00;
+    return redBlue | alphaGreen;
+}
+
+QImage SimdKernels::scaledToFit(const QImage &src, const QSize &bounds)
+{
+    QSize size = src.size().scaled(bounds, Qt::KeepAspectRatio);
+    if (src.isNull() || size.isEmpty()) {
+        return QImage();
+    }
+    if (size.width() * 2 <= src.width() && size.height() * 2 <= src.height()) {
+        return downscaleArea(src, size);
+    }
+    return scaleBilinear(src, size);
+}
+
+QImage SimdKernels::downscaleArea(const QImage &source, const QSize &size)
+{
+    QImage src = to32Bit(source);
+    const int srcWidth = src.width();
+    const int srcHeight = src.height();
+    const int width = size.width();
+    const int height = size.height();
+
+    // 16-bit row sums hold up to 257 rows of 255 per destination row
+    if (srcHeight / height >= 257) {
+        return src.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    }
+
+    QImage dst(size, src.format());
+    QVector<int> columnStart(width + 1);
+    for (int x = 0; x <= width; ++x) {
+        columnStart[x] = static_cast<int>(static_cast<qint64>(x) * srcWidth / width);
+    }
+    QVector<quint16> rowSums(srcWidth * 4);
+
+    for (int y = 0; y < height; ++y) {
+        int rowStart = static_cast<int>(static_cast<qint64>(y) * srcHeight / height);
+        int rowEnd = qMax(rowStart + 1, static_cast<int>(static_cast<qint64>(y + 1) * srcHeight / height));
+
+        // Vertical: sum the source rows this row covers (the vectorised part)
+        std::fill(rowSums.begin(), rowSums.end(), 0);
+        for (int row = rowStart; row < rowEnd; ++row) {
+            s_kernels.accumulateRow(src.constScanLine(row), rowSums.data(), srcWidth * 4);
+        }
+
+        // Horizontal: sum columns and divide by the box area
+        uchar *out = dst.scanLine(y);
+        for (int x = 0; x < width; ++x) {
+            int start = columnStart[x];
+            int end = qMax(start + 1, columnStart[x + 1]);
+            quint32 sum[4] = { 0, 0, 0, 0 };
+            for (int column = start; column < end; ++column) {
+                const quint16 *pixel = rowSums.constData() + column * 4;
+                sum[0] += pixel[0];
+                sum[1] += pixel[1];
+                sum[2] += pixel[2];
+                sum[3] += pixel[3];
+            }
+            quint32 area = static_cast<quint32>((rowEnd - rowStart) * (end - start));
+            for (int channel = 0; channel < 4; ++channel) {
+                out[x * 4 + channel] = static_cast<uchar>((sum[channel] + area / 2) / area);
+            }
+        }
+    }
+    return dst;
+}
+
+QImage SimdKernels::scaleBilinear(const QImage &source, const QSize &size)
+{
+    QImage src = to32Bit(source);
+    const int srcWidth = src.width();
+    const int srcHeight = src.height();
+    const int width = size.width();
+    const int height = size.height();
+    QImage dst(size, src.format());
+
+    // Source positions of pixel centres, in 8-bit fixed point
+    auto sample = [](int index, int from, int to, int *first, int *weight) {
+        qint64 position = ((2 * static_cast<qint64>(index) + 1) * from * 256) / (2 * to) - 128;
+        position = qBound<qint64>(0, position, (from - 1) * 256LL);
+        *first = static_cast<int>(position >> 8);
+        *weight = static_cast<int>(position & 0xff);
+    };
+    QVector<int> columnFirst(width);
+    QVector<int> columnWeight(width);
+    for (int x = 0; x < width; ++x) {
+        sample(x, srcWidth, width, &columnFirst[x], &columnWeight[x]);
+    }
+
+    // Horizontal pass into two cached rows, then the vertical lerp between
+    // them (the vectorised part)
+    QVector<quint32> upper(width);
+    QVector<quint32> lower(width);
+    int upperRow = -1;
+    int lowerRow = -1;
+    auto resampleRow = [&](int row, QVector<quint32> &out) {
+        const quint32 *line = reinterpret_cast<const quint32 *>(src.constScanLine(row));
+        for (int x = 0; x < width; ++x) {
+            int first = columnFirst[x];
+            int second = qMin(first + 1, srcWidth - 1);
+            out[x] = lerpPixel(line[first], line[second], columnWeight[x]);
+        }
+    };
+
+    for (int y = 0; y < height; ++y) {
+        int first = 0;
+        int weight = 0;
+        sample(y, srcHeight, height, &first, &weight);
+        int second = qMin(first + 1, srcHeight - 1);
+        if (upperRow != first) {
+            if (lowerRow == first) {
+                upper.swap(lower);
+                upperRow = lowerRow;
+                lowerRow = -1;
+            } else {
+                resampleRow(first, upper);
+                upperRow = first;
+            }
+        }
+        if (lowerRow != second) {
+            resampleRow(second, lower);
+            lowerRow = second;
+        }
+        s_kernels.lerpRow(reinterpret_cast<const uchar *>(upper.constData()),
+                          reinterpret_cast<const uchar *>(lower.constData()),
+                          weight, dst.scanLine(y), width * 4);
+    }
+    return dst;
+}
+
+QImage SimdKernels::blend(const QImage &first, const QImage &second, qreal t)
+{
+    if (first.size() != second.size()) {
+        return QImage();
+    }
+    QImage a = to32Bit(first);
+    QImage b = second.format() == a.format() ? second : second.convertToFormat(a.format());
+    QImage dst(a.size(), a.format());
+    int weight = qBound(0, qRound(t * 256), 256);
+    for (int y = 0; y < a.height(); ++y) {
+        s_kernels.lerpRow(a.constScanLine(y), b.constScanLine(y), weight, dst.scanLine(y), a.width() * 4);
+    }
+    return dst;
+}
+
+// --- Benchmark ---
+
+static QImage benchmarkImage(const QSize &size, int seed)
+{
+    // Gradients with some texture, so no scaler gets away with flat areas
+    QImage image(size, QImage::Format_RGB32);
+    for (int y = 0; y < size.height(); ++y) {
+        quint32 *line = reinterpret_cast<quint32 *>(image.scanLine(y));
+        for (int x = 0; x < size.width(); ++x) {
+            int noise = ((x * 7919 + y * 104729 + seed * 31) >> 3) & 0x3f;
+            line[x] = qRgb((x + seed) & 0xff, (y + noise) & 0xff, ((x ^ y) + seed) & 0xff);
+        }
+    }
+    return image;
+}
+
+static int maxDifference(const QImage &a, const QImage &b)
+{
+    if (a.size() != b.size()) {
+        return 255;
+    }
+    int worst = 0;
+    for (int y = 0; y < a.height(); ++y) {
+        const uchar *lineA = a.constScanLine(y);
+        const uchar *lineB = b.constScanLine(y);
+        for (int i = 0; i < a.width() * 4; ++i) {
+            worst = qMax(worst, qAbs(lineA[i] - lineB[i]));
+        }
+    }
+    return worst;
+}
+
+template <typename Function>
+static double millisecondsPerRun(int runs, Function function)
+{
+    function(); // Warm up caches and allocations
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < runs; ++i) {
+        function();
+    }
+    return timer.nsecsElapsed() / 1e6 / runs;
+}
+
+void SimdKernels::runBenchmark(QTextStream &out)
+{
+    const int runs = 20;
+    const QSize uhd(3840, 2160);
+    const QSize hd(1920, 1080);
+    const QSize hdReady(1280, 720);
+    QImage uhdFrame = benchmarkImage(uhd, 1);
+    QImage hdFrame = benchmarkImage(hd, 2);
+    QImage hdOther = benchmarkImage(hd, 3);
+    QImage result;
+
+    out << "Kernel benchmark, ms per run (average of " << runs << "), max channel difference from scalar\n";
+    out << QString("%1 %2 %3 %4\n")
+        .arg("", -8)
+        .arg("area 4K->1080p", 22)
+        .arg("bilinear 1080p->720p", 22)
+        .arg("blend 1080p", 22);
+
+    auto cell = [](double ms, int difference) {
+        return difference < 0 ? QString("%1").arg(ms, 22, 'f', 2)
+                              : QString("%1 (%2)").arg(ms, 16, 'f', 2).arg(difference, 3);
+    };
+
+    // Reference: what the render path used before
+    double qtArea = millisecondsPerRun(runs, [&]() {
+        result = uhdFrame.scaled(hd, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    });
+    double qtBilinear = millisecondsPerRun(runs, [&]() {
+        result = hdFrame.scaled(hdReady, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    });
+    double qtBlend = millisecondsPerRun(runs, [&]() {
+        result = hdFrame.copy();
+        QPainter painter(&result);
+        painter.setOpacity(0.5);
+        painter.drawImage(0, 0, hdOther);
+    });
+    out << QString("%1 %2 %3 %4\n").arg("Qt", -8)
+        .arg(cell(qtArea, -1)).arg(cell(qtBilinear, -1)).arg(cell(qtBlend, -1));
+
+    Isa detected = s_isa;
+    QImage scalarArea;
+    QImage scalarBilinear;
+    QImage scalarBlend;
+    const QList<Isa> isas = supportedIsas();
+    for (Isa isa : isas) {
+        setIsa(isa);
+        QImage area;
+        QImage bilinear;
+        QImage blended;
+        double areaMs = millisecondsPerRun(runs, [&]() { area = downscaleArea(uhdFrame, hd); });
+        double bilinearMs = millisecondsPerRun(runs, [&]() { bilinear = scaleBilinear(hdFrame, hdReady); });
+        double blendMs = millisecondsPerRun(runs, [&]() { blended = blend(hdFrame, hdOther, 0.5); });
+        if (isa == Scalar) {
+            scalarArea = area;
+            scalarBilinear = bilinear;
+            scalarBlend = blended;
+        }
+        out << QString("%1 %2 %3 %4\n").arg(isaName(isa), -8)
+            .arg(cell(areaMs, maxDifference(area, scalarArea)))
+            .arg(cell(bilinearMs, maxDifference(bilinear, scalarBilinear)))
+            .arg(cell(blendMs, maxDifference(blended, scalarBlend)));
+    }
+    setIsa(detected);
+    out << "Render path uses: " << isaName(detected) << "\n";
+    out.flush();
+}
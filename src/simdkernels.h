@@ -0,0 +1,40 @@
+#ifndef SIMDKERNELS_H
+#define SIMDKERNELS_H
+
+#include <QImage>
+#include <QList>
+#include <QSize>
+#include <QString>
+
+class QTextStream;
+
+// Pixel kernels for the render path: downscaling and blending of 32-bit
+// frames (RGB32 or premultiplied ARGB32, channels handled alike). The inner
+// loops exist as scalar code and as SSE2, AVX2 or NEON versions; the best
+// one the CPU supports is picked once, at startup. Area downscaling sums
+// whole source pixels per destination pixel and is used from 2x reduction
+// on, bilinear otherwise, which together match QImage::scaled() with
+// Qt::SmoothTransformation closely.
+class SimdKernels
+{
+public:
+    enum Isa { Scalar, Sse2, Avx2, Neon };
+
+    static Isa activeIsa();
+    static QList<Isa> supportedIsas(); // Scalar first, best last
+    static QString isaName(Isa isa);
+    static bool setIsa(Isa isa); // Benchmarks only; false if the CPU lacks it
+
+    // Fit src into bounds keeping its aspect ratio, like QImage::scaled()
+    // with Qt::KeepAspectRatio and Qt::SmoothTransformation
+    static QImage scaledToFit(const QImage &src, const QSize &bounds);
+    static QImage downscaleArea(const QImage &src, const QSize &size); // size no larger than src
+    static QImage scaleBilinear(const QImage &src, const QSize &size);
+    // a * (1 - t) + b * t; a and b must have the same size
+    static QImage blend(const QImage &a, const QImage &b, qreal t);
+
+    // Times every supported kernel set against QImage::scaled() and QPainter
+    static void runBenchmark(QTextStream &out);
+};
+
+#endif // SIMDKERNELS_H
@@ -1,5 +1,6 @@
 #include "specialevents.h"
 #include "logger.h"
+#include "mediacache.h"
 #include <QFile>
 #include <QJsonDocument>
 #include <QJsonObject>
@@ -301,6 +302,9 @@ MediaPlaylist SpecialEvents::loadPlaylistFromFile(const QString &filePath) const
         }
         
         if (!item.type.isEmpty() && !item.url.isEmpty()) {
+            if (item.url.startsWith("http://") || item.url.startsWith("https://")) {
+                item.cacheKey = MediaCache::cacheKeyFor(item.url);
+            }
             playlist.items.append(item);
         }
     }
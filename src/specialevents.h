@@ -47,6 +47,8 @@ public:
     MediaPlaylist getEventPlaylist() const;
     void addCustomEvent(const SpecialEvent &event);
     void loadSpecialPlaylistsFromDirectory(const QString &dirPath);
+    const QList<SpecialEvent> &events() const { return m_events; }
+    MediaPlaylist loadPlaylistFromFile(const QString &filePath) const;
     
 signals:
     void eventTriggered(const SpecialEvent &event);
@@ -56,7 +58,6 @@ private:
     void initializeEvents();
     void activateEvent(const SpecialEvent &event);
     void deactivateEvent();
-    MediaPlaylist loadPlaylistFromFile(const QString &filePath) const;
     
     QList<SpecialEvent> m_events;
     const SpecialEvent *m_activeEvent = nullptr;
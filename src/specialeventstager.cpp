@@ -0,0 +1,268 @@
+#include "specialeventstager.h"
+#include "specialevents.h"
+#include "mediacache.h"
+#include "logger.h"
+#include <QFileInfo>
+#include <QSet>
+#include <QUrl>
+
+static bool isNetworkUrl(const QString &url)
+{
+    return url.startsWith("http://") || url.startsWith("https://");
+}
+
+static bool localFileReady(const QString &url)
+{
+    QString path = url.startsWith("file://") ? QUrl(url).toLocalFile() : url;
+    QFileInfo info(path);
+    return info.isReadable() && info.size() > 0;
+}
+
+SpecialEventStager::SpecialEventStager(MediaCache *cache, SpecialEvents *events, QObject *parent)
+    : QObject(parent)
+    , m_cache(cache)
+    , m_events(events)
+{
+    connect(m_cache, &MediaCache::prefetchComplete, this, &SpecialEventStager::onPrefetchComplete);
+    connect(m_cache, &MediaCache::verified, this, &SpecialEventStager::onVerified);
+}
+
+void SpecialEventStager::update(const QDateTime &now, bool offHours)
+{
+    m_offHours = offHours;
+
+    qint64 sinceRefresh = m_lastRefresh.isValid() ? m_lastRefresh.msecsTo(now) : -1;
+    if (sinceRefresh < 0 || sinceRefresh >= REFRESH_INTERVAL_MS || now.date() != m_lastRefresh.date()) {
+        m_lastRefresh = now;
+        refresh(now.date());
+    }
+
+    startNext();
+}
+
+void SpecialEventStager::refresh(const QDate &today)
+{
+    QSet<QString> wanted;
+    for (int offset = 0; offset <= LOOKAHEAD_DAYS; ++offset) {
+        QDate date = today.addDays(offset);
+        for (const SpecialEvent &event : m_events->events()) {
+            if (!event.shouldTrigger(QDateTime(date, QTime(0, 0)))) {
+                continue;
+            }
+            QString name = QString("event:%1:%2").arg(date.toString(Qt::ISODate), event.title);
+            wanted.insert(name);
+            if (m_staged.contains(name)) {
+                continue;
+            }
+
+            StagedEvent staged;
+            staged.title = event.title;
+            staged.date = date;
+            MediaPlaylist playlist;
+            if (!event.playlistPath.isEmpty()) {
+                playlist = m_events->loadPlaylistFromFile(event.playlistPath);
+            }
+            QStringList urls;
+            for (const MediaItem &item : playlist.items) {
+                urls.append(item.url);
+            }
+            if (urls.isEmpty() && !event.imageUrl.isEmpty()) {
+                urls.append(event.imageUrl);
+            }
+            if (urls.isEmpty()) {
+                continue;
+            }
+
+            QStringList keys;
+            for (const QString &url : urls) {
+                StagedItem item;
+                item.url = url;
+                if (isNetworkUrl(url)) {
+                    item.cacheKey = MediaCache::cacheKeyFor(url);
+                    keys.append(item.cacheKey);
+                }
+                staged.items.append(item);
+            }
+            m_cache->pin(name, keys);
+            m_staged.insert(name, staged);
+            LOG_INFO_CAT(QString("Staging special event %1 on %2: %3 items, %4 pinned")
+                .arg(event.title)
+                .arg(date.toString(Qt::ISODate))
+                .arg(staged.items.size())
+                .arg(keys.size()), "SpecialEvents");
+        }
+    }
+
+    // Events whose day has passed no longer need their media kept
+    const QStringList names = m_staged.keys();
+    for (const QString &name : names) {
+        if (wanted.contains(name)) {
+            continue;
+        }
+        for (const StagedItem &item : m_staged.value(name).items) {
+            if (item.state == Downloading || item.state == Verifying) {
+                m_active--;
+            }
+        }
+        m_cache->unpin(name);
+        m_staged.remove(name);
+        LOG_DEBUG_CAT(QString("Released %1").arg(name), "SpecialEvents");
+    }
+
+    // Retry failures, and recheck what was ready in case a file went missing
+    for (auto it = m_staged.begin(); it != m_staged.end(); ++it) {
+        for (StagedItem &item : it.value().items) {
+            if (item.cacheKey.isEmpty()) {
+                item.state = localFileReady(item.url) ? Ready : Failed;
+            }
+        }
+        // Before failures go back to pending, so a retry that fails the
+        // same way again is not reported as a change
+        report(it.value(), today);
+        for (StagedItem &item : it.value().items) {
+            if (item.cacheKey.isEmpty()) {
+                continue;
+            }
+            if (item.state == Failed
+                || (item.state == Ready && !m_cache->isCached(item.url, item.cacheKey))) {
+                item.state = Pending;
+            }
+        }
+    }
+}
+
+void SpecialEventStager::startNext()
+{
+    if (!m_offHours) {
+        return; // Downloads already running are left to finish
+    }
+
+    for (auto it = m_staged.begin(); it != m_staged.end(); ++it) {
+        for (StagedItem &item : it.value().items) {
+            if (m_active >= MAX_ACTIVE) {
+                return;
+            }
+            if (item.state != Pending) {
+                continue;
+            }
+            m_active++;
+            if (m_cache->isCached(item.url, item.cacheKey)) {
+                item.state = Verifying;
+                m_cache->verify(item.cacheKey);
+            } else {
+                item.state = Downloading;
+                LOG_DEBUG_CAT(QString("Downloading %1 for %2").arg(item.url, it.value().title), "SpecialEvents");
+                m_cache->prefetchUrl(item.url, item.cacheKey);
+            }
+        }
+    }
+}
+
+void SpecialEventStager::onPrefetchComplete(const QString &url, bool success)
+{
+    for (auto it = m_staged.begin(); it != m_staged.end(); ++it) {
+        for (StagedItem &item : it.value().items) {
+            if (item.url != url || item.state != Downloading) {
+                continue;
+            }
+            if (success) {
+                // Checked against the hash taken while downloading
+                item.state = Verifying;
+                m_cache->verify(item.cacheKey);
+            } else {
+                finishItem(item, false);
+                LOG_WARNING_CAT(QString("Failed to download %1 for %2").arg(url, it.value().title),
+                                "SpecialEvents");
+            }
+        }
+    }
+    startNext();
+}
+
+void SpecialEventStager::onVerified(const QString &cacheKey, bool ok)
+{
+    for (auto it = m_staged.begin(); it != m_staged.end(); ++it) {
+        bool changed = false;
+        for (StagedItem &item : it.value().items) {
+            if (item.cacheKey == cacheKey && item.state == Verifying) {
+                finishItem(item, ok);
+                changed = true;
+            }
+        }
+
+        // Report each event once its last item is done
+        if (changed) {
+            bool done = true;
+            for (const StagedItem &item : it.value().items) {
+                if (item.state != Ready && item.state != Failed) {
+                    done = false;
+                }
+            }
+            if (done) {
+                report(it.value(), m_lastRefresh.date());
+            }
+        }
+    }
+    startNext();
+}
+
+void SpecialEventStager::finishItem(StagedItem &item, bool ok)
+{
+    item.state = ok ? Ready : Failed;
+    m_active--;
+}
+
+EventReadiness SpecialEventStager::readinessOf(const StagedEvent &event) const
+{
+    EventReadiness readiness;
+    readiness.title = event.title;
+    readiness.date = event.date;
+    readiness.items = event.items.size();
+    for (const StagedItem &item : event.items) {
+        if (item.state == Ready) {
+            readiness.ready++;
+        } else if (item.state == Failed) {
+            readiness.failed++;
+        }
+    }
+    return readiness;
+}
+
+QList<EventReadiness> SpecialEventStager::readiness() const
+{
+    QList<EventReadiness> result;
+    for (const StagedEvent &event : m_staged) {
+        result.append(readinessOf(event));
+    }
+    return result;
+}
+
+void SpecialEventStager::report(StagedEvent &event, const QDate &today)
+{
+    EventReadiness readiness = readinessOf(event);
+    // Not ready by the day before is worth someone's attention
+    bool late = !readiness.isReady() && readiness.date <= today.addDays(1);
+
+    // Logged when it changes, not on every refresh
+    QString state = QString("%1/%2/%3/%4").arg(readiness.ready).arg(readiness.items)
+        .arg(readiness.failed).arg(late);
+    if (state == event.reported) {
+        return;
+    }
+    event.reported = state;
+
+    QString message = QString("Readiness of %1 on %2: %3/%4 items ready")
+        .arg(readiness.title)
+        .arg(readiness.date.toString(Qt::ISODate))
+        .arg(readiness.ready)
+        .arg(readiness.items);
+    if (readiness.failed > 0) {
+        message += QString(", %1 failed").arg(readiness.failed);
+    }
+
+    if (late) {
+        LOG_WARNING_CAT(message, "SpecialEvents");
+    } else {
+        LOG_INFO_CAT(message, "SpecialEvents");
+    }
+}
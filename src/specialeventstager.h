@@ -0,0 +1,83 @@
+#ifndef SPECIALEVENTSTAGER_H
+#define SPECIALEVENTSTAGER_H
+
+#include <QObject>
+#include <QString>
+#include <QDate>
+#include <QDateTime>
+#include <QList>
+#include <QMap>
+
+class MediaCache;
+class SpecialEvents;
+
+// How far along the media of one upcoming special event is
+struct EventReadiness {
+    QString title;
+    QDate date;
+    int items = 0;  // Media items in the event playlist
+    int ready = 0;  // Downloaded (or local) and verified
+    int failed = 0; // Failed to download or verify; retried at the next refresh
+
+    bool isReady() const { return items > 0 && ready == items; }
+};
+
+// Gets the media of special events (see SpecialEvents) onto the disk ahead
+// of time, so an event plays from the cache at its exact minute instead of
+// downloading then. Every event within LOOKAHEAD_DAYS has its playlist's
+// network items pinned in MediaCache, so ordinary eviction can't drop them,
+// then downloaded and verified one at a time, only outside school hours.
+// Pins are released once the event's day has passed. Local files are
+// checked for presence only.
+class SpecialEventStager : public QObject
+{
+    Q_OBJECT
+
+public:
+    SpecialEventStager(MediaCache *cache, SpecialEvents *events, QObject *parent = nullptr);
+
+    // Called from the UI timer; re-reads the events every REFRESH_INTERVAL_MS
+    // and starts downloads only when offHours is true
+    void update(const QDateTime &now, bool offHours);
+
+    QList<EventReadiness> readiness() const; // Soonest event first
+
+private slots:
+    void onPrefetchComplete(const QString &url, bool success);
+    void onVerified(const QString &cacheKey, bool ok);
+
+private:
+    enum ItemState { Pending, Downloading, Verifying, Ready, Failed };
+
+    struct StagedItem {
+        QString url;
+        QString cacheKey; // Empty for local files
+        ItemState state = Pending;
+    };
+
+    struct StagedEvent {
+        QString title;
+        QDate date;
+        QList<StagedItem> items;
+        QString reported; // Readiness last logged; only changes are logged
+    };
+
+    void refresh(const QDate &today);
+    void startNext();
+    void finishItem(StagedItem &item, bool ok);
+    EventReadiness readinessOf(const StagedEvent &event) const;
+    void report(StagedEvent &event, const QDate &today);
+
+    MediaCache *m_cache;
+    SpecialEvents *m_events;
+    QMap<QString, StagedEvent> m_staged; // Pin set name ("event:<date>:<title>") -> event, soonest first
+    QDateTime m_lastRefresh;
+    bool m_offHours = false;
+    int m_active = 0; // Items downloading or verifying
+
+    static const int LOOKAHEAD_DAYS = 7;
+    static const int REFRESH_INTERVAL_MS = 10 * 60 * 1000;
+    static const int MAX_ACTIVE = 1; // Leave the link to playback prefetches
+};
+
+#endif // SPECIALEVENTSTAGER_H
@@ -0,0 +1,256 @@
+#include "streamreceiver.h"
+#include "multipart.h"
+#include "simdkernels.h"
+#include "networkclient.h"
+#include "logger.h"
+#include "playbackmetrics.h"
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QImageReader>
+#include <QBuffer>
+#include <QMetaObject>
+#include <QDateTime>
+#include <QTimer>
+
+StreamReceiver::StreamReceiver(QObject *parent)
+    : QObject(parent)
+{
+    m_network = new QNetworkAccessManager(this);
+    m_decoder.setMaxThreadCount(1);
+
+    m_retryTimer = new QTimer(this);
+    m_retryTimer->setSingleShot(true);
+    m_retryTimer->setInterval(RETRY_MS);
+    connect(m_retryTimer, &QTimer::timeout, this, &StreamReceiver::connectToStream);
+
+    m_stallTimer = new QTimer(this);
+    m_stallTimer->setSingleShot(true);
+    m_stallTimer->setInterval(STALL_MS);
+    connect(m_stallTimer, &QTimer::timeout, this, [this]() {
+        LOG_WARNING_CAT(QString("No frame from %1 for %2 ms, reconnecting").arg(m_url).arg(STALL_MS), "Stream");
+        connectToStream();
+    });
+}
+
+StreamReceiver::~StreamReceiver()
+{
+    stop();
+    m_decoder.waitForDone();
+}
+
+void StreamReceiver::setTimeSource(NetworkClient *client)
+{
+    m_timeSource = client;
+}
+
+void StreamReceiver::start(const QString &url, const QSize &targetSize)
+{
+    stop();
+    m_url = url;
+    m_targetSize = targetSize;
+    m_active = true;
+    m_stats = StreamStats();
+    m_stats.active = true;
+    m_fpsClock.start();
+    m_fpsFrames = 0;
+    LOG_INFO_CAT(QString("Receiving stream %1").arg(url), "Stream");
+    connectToStream();
+}
+
+void StreamReceiver::stop()
+{
+    m_active = false;
+    m_stats.active = false;
+    m_stats.connected = false;
+    m_generation++;
+    m_retryTimer->stop();
+    m_stallTimer->stop();
+    if (m_reply) {
+        QNetworkReply *reply = m_reply;
+        m_reply = nullptr;
+        reply->abort();
+    }
+    m_buffer.clear();
+    m_waitingJpeg.clear();
+}
+
+void StreamReceiver::setTargetSize(const QSize &size)
+{
+    if (size == m_targetSize) {
+        return;
+    }
+    m_targetSize = size;
+    m_generation++; // Frames in flight are at the old size
+}
+
+StreamStats StreamReceiver::stats() const
+{
+    return m_stats;
+}
+
+void StreamReceiver::connectToStream()
+{
+    if (!m_active) {
+        return;
+    }
+    if (m_reply) {
+        QNetworkReply *reply = m_reply;
+        m_reply = nullptr;
+        reply->abort();
+    }
+    m_buffer.clear();
+    m_boundary.clear();
+
+    QNetworkRequest request{QUrl(m_url)};
+    request.setRawHeader("Cache-Control", "no-cache");
+    m_reply = m_network->get(request);
+    connect(m_reply, &QNetworkReply::readyRead, this, &StreamReceiver::onReadyRead);
+    connect(m_reply, &QNetworkReply::finished, this, &StreamReceiver::onFinished);
+    m_stallTimer->start();
+}
+
+void StreamReceiver::onReadyRead()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+    if (!reply || reply != m_reply) {
+        return;
+    }
+    if (m_boundary.isEmpty()) {
+        QByteArray contentType = reply->header(QNetworkRequest::ContentTypeHeader).toByteArray();
+        m_boundary = multipartBoundary(contentType);
+        if (m_boundary.isEmpty()) {
+            LOG_ERROR_CAT(QString("Stream %1 is not multipart (Content-Type %2)").arg(m_url, QString(contentType)), "Stream");
+            m_reply = nullptr;
+            reply->abort();
+            m_retryTimer->start();
+            return;
+        }
+        m_stats.connected = true;
+    }
+    m_buffer.append(reply->readAll());
+    parseParts();
+}
+
+void StreamReceiver::onFinished()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+    if (reply) {
+        reply->deleteLater();
+    }
+    if (!reply || reply != m_reply) {
+        return; // Aborted on purpose
+    }
+    m_reply = nullptr;
+    m_stats.connected = false;
+    m_stallTimer->stop();
+    LOG_WARNING_CAT(QString("Stream %1 ended: %2, retrying").arg(m_url, reply->errorString()), "Stream");
+    if (m_active) {
+        m_retryTimer->start();
+    }
+}
+
+void StreamReceiver::parseParts()
+{
+    // Same framing as the server's relay (multipart.h)
+    const QList<MultipartPart> parts = takeMultipartParts(&m_buffer, m_boundary);
+    for (const MultipartPart &part : parts) {
+        // Not from the relay: latency from arrival only
+        queueDecode(part.body, part.hasTimestamp ? part.timestampMs : nowMs());
+    }
+    if (m_buffer.size() > MAX_BUFFER_BYTES) {
+        LOG_WARNING_CAT(QString("No frame in %1 bytes from %2, resynchronising").arg(m_buffer.size()).arg(m_url), "Stream");
+        m_buffer.clear();
+    }
+}
+
+void StreamReceiver::queueDecode(const QByteArray &jpeg, qint64 timestampMs)
+{
+    if (jpeg.isEmpty()) {
+        return;
+    }
+    m_stats.framesReceived++;
+    m_stallTimer->start();
+
+    // Decoder busy: this frame replaces the one waiting, which is never shown
+    if (!m_waitingJpeg.isEmpty()) {
+        m_stats.framesDropped++;
+    }
+    m_waitingJpeg = jpeg;
+    m_waitingTimestampMs = timestampMs;
+    if (!m_decoding) {
+        decodeNext();
+    }
+}
+
+void StreamReceiver::decodeNext()
+{
+    if (m_waitingJpeg.isEmpty()) {
+        return;
+    }
+    m_decoding = true;
+    QByteArray jpeg = m_waitingJpeg;
+    qint64 timestampMs = m_waitingTimestampMs;
+    m_waitingJpeg.clear();
+    QSize target = m_targetSize;
+    int generation = m_generation;
+
+    m_decoder.start([this, jpeg, timestampMs, target, generation]() {
+        QElapsedTimer timer;
+        timer.start();
+
+        QBuffer buffer;
+        buffer.setData(jpeg);
+        buffer.open(QIODevice::ReadOnly);
+        QImageReader reader(&buffer);
+        // JPEG can decode straight to a fraction of its size, which is most of the saving
+        QSize size = reader.size();
+        if (size.isValid() && target.isValid() && (size.width() > target.width() || size.height() > target.height())) {
+            reader.setScaledSize(size.scaled(target, Qt::KeepAspectRatio));
+        }
+        QImage image = reader.read();
+        if (!image.isNull() && target.isValid() && image.size() != image.size().scaled(target, Qt::KeepAspectRatio)) {
+            image = SimdKernels::scaledToFit(image, target);
+        }
+
+        StreamFrame frame;
+        frame.image = image; // Null if it didn't decode
+        frame.timestampMs = timestampMs;
+        frame.decodeMs = timer.nsecsElapsed() / 1e6;
+        frame.generation = generation;
+        QMetaObject::invokeMethod(this, [this, frame]() { onDecoded(frame); }, Qt::QueuedConnection);
+    });
+}
+
+void StreamReceiver::onDecoded(const StreamFrame &frame)
+{
+    m_decoding = false;
+
+    if (m_active && !frame.image.isNull() && frame.generation == m_generation) {
+        m_stats.framesShown++;
+        m_stats.decodeMs = movingAverage(m_stats.decodeMs, frame.decodeMs, m_stats.framesShown);
+        double latency = static_cast<double>(nowMs() - frame.timestampMs);
+        m_stats.latencyMs = movingAverage(m_stats.latencyMs, latency, m_stats.framesShown);
+        m_stats.maxLatencyMs = qMax(m_stats.maxLatencyMs, latency);
+
+        m_fpsFrames++;
+        if (m_fpsClock.elapsed() >= 1000) {
+            m_stats.fps = m_fpsFrames * 1000.0 / m_fpsClock.elapsed();
+            m_fpsFrames = 0;
+            m_fpsClock.restart();
+        }
+        emit frameReady(frame.image);
+    }
+
+    if (m_active) {
+        decodeNext();
+    }
+}
+
+qint64 StreamReceiver::nowMs() const
+{
+    if (m_timeSource) {
+        return m_timeSource->getCurrentDateTime().toMSecsSinceEpoch();
+    }
+    return QDateTime::currentMSecsSinceEpoch();
+}
@@ -0,0 +1,97 @@
+#ifndef STREAMRECEIVER_H
+#define STREAMRECEIVER_H
+
+#include <QObject>
+#include <QImage>
+#include <QSize>
+#include <QThreadPool>
+#include <QElapsedTimer>
+
+class QNetworkAccessManager;
+class QNetworkReply;
+class QTimer;
+class NetworkClient;
+
+struct StreamStats {
+    bool active = false;
+    bool connected = false;    // Receiving from the relay right now
+    int framesReceived = 0;
+    int framesShown = 0;
+    int framesDropped = 0;     // Superseded while waiting for the decoder
+    double latencyMs = 0.0;    // Capture (X-Timestamp) to on screen, moving average
+    double maxLatencyMs = 0.0; // Worst since start()
+    double decodeMs = 0.0;     // Decode and scale, moving average
+    double fps = 0.0;          // Frames shown per second
+};
+
+// A decoded frame on its way from the decoder thread to the screen
+struct StreamFrame {
+    QImage image;
+    qint64 timestampMs = 0; // Capture time on the server's clock
+    double decodeMs = 0.0;
+    int generation = -1;
+};
+
+// Plays "stream" items: MJPEG over HTTP, normally from the server's stream
+// relay. Parts are split off the connection on the GUI thread and decoded,
+// already at display size, one at a time on a worker thread. Only the
+// newest part is ever decoded: one arriving while the decoder is busy
+// replaces the one waiting, so latency stays within about one decode of the
+// network. End-to-end latency is each part's X-Timestamp against the
+// synced server clock.
+class StreamReceiver : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit StreamReceiver(QObject *parent = nullptr);
+    ~StreamReceiver();
+
+    void setTimeSource(NetworkClient *client); // Clock X-Timestamps are compared with
+    void start(const QString &url, const QSize &targetSize);
+    void stop();
+    void setTargetSize(const QSize &size);
+    bool isActive() const { return m_active; }
+    StreamStats stats() const;
+
+signals:
+    void frameReady(const QImage &frame);
+
+private:
+    void connectToStream();
+    void onReadyRead();
+    void onFinished();
+    void parseParts();
+    void queueDecode(const QByteArray &jpeg, qint64 timestampMs);
+    void decodeNext();
+    void onDecoded(const StreamFrame &frame);
+    qint64 nowMs() const;
+
+    QNetworkAccessManager *m_network;
+    QNetworkReply *m_reply = nullptr;
+    NetworkClient *m_timeSource = nullptr;
+    QString m_url;
+    QSize m_targetSize;
+    bool m_active = false;
+    int m_generation = 0; // Bumped by start(), stop() and size changes
+    QByteArray m_buffer;   // Received, not yet parsed
+    QByteArray m_boundary;
+
+    // Decoding: one frame at a time, plus the newest one waiting
+    QThreadPool m_decoder;
+    bool m_decoding = false;
+    QByteArray m_waitingJpeg;
+    qint64 m_waitingTimestampMs = 0;
+
+    QTimer *m_retryTimer;
+    QTimer *m_stallTimer; // Reconnects when the stream goes quiet
+    StreamStats m_stats;
+    QElapsedTimer m_fpsClock;
+    int m_fpsFrames = 0;
+
+    static const int RETRY_MS = 2000;
+    static const int STALL_MS = 5000;
+    static const int MAX_BUFFER_BYTES = 16 * 1024 * 1024; // Without a parsable frame in it
+};
+
+#endif // STREAMRECEIVER_H
@@ -0,0 +1,93 @@
+#include "transitionoverlay.h"
+#include <QPainter>
+#include <QTimer>
+#include <QVariantAnimation>
+
+TransitionOverlay::TransitionOverlay(QWidget *parent)
+    : QWidget(parent)
+{
+    setAttribute(Qt::WA_TransparentForMouseEvents);
+
+    m_animation = new QVariantAnimation(this);
+    m_animation->setStartValue(1.0);
+    m_animation->setEndValue(0.0);
+    connect(m_animation, &QVariantAnimation::valueChanged, this, [this](const QVariant &value) {
+        m_opacity = value.toReal();
+        update();
+    });
+    connect(m_animation, &QVariantAnimation::finished, this, &TransitionOverlay::finish);
+
+    m_holdTimer = new QTimer(this);
+    m_holdTimer->setSingleShot(true);
+    m_holdTimer->setInterval(MAX_HOLD_MS);
+    connect(m_holdTimer, &QTimer::timeout, this, &TransitionOverlay::reveal);
+
+    hide();
+}
+
+void TransitionOverlay::hold(const QPixmap &outgoing, int durationMs)
+{
+    m_animation->stop();
+    m_animation->setDuration(qMax(1, durationMs));
+    m_snapshot = outgoing;
+    m_opacity = 1.0;
+    if (parentWidget()) {
+        setGeometry(parentWidget()->rect());
+    }
+    show();
+    raise();
+    update();
+    m_holdTimer->start();
+}
+
+void TransitionOverlay::showIncoming(const QImage &frame)
+{
+    if (!isActive()) {
+        return;
+    }
+    m_incoming = frame;
+    m_paintsIncoming = true;
+    update();
+}
+
+void TransitionOverlay::reveal()
+{
+    m_holdTimer->stop();
+    if (!isActive()) {
+        emit finished();
+        return;
+    }
+    if (m_animation->state() != QAbstractAnimation::Running) {
+        m_animation->start();
+    }
+}
+
+void TransitionOverlay::cancel()
+{
+    m_holdTimer->stop();
+    m_animation->stop();
+    m_snapshot = QPixmap();
+    m_incoming = QImage();
+    m_paintsIncoming = false;
+    hide();
+}
+
+void TransitionOverlay::finish()
+{
+    cancel();
+    emit finished();
+}
+
+void TransitionOverlay::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event);
+    QPainter painter(this);
+    if (m_paintsIncoming) {
+        painter.fillRect(rect(), Qt::black);
+        if (!m_incoming.isNull()) {
+            painter.drawImage(rect(), m_incoming);
+        }
+    }
+    painter.setOpacity(m_opacity);
+    painter.drawPixmap(rect(), m_snapshot);
+}
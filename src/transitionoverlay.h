@@ -0,0 +1,54 @@
+#ifndef TRANSITIONOVERLAY_H
+#define TRANSITIONOVERLAY_H
+
+#include <QWidget>
+#include <QPixmap>
+#include <QImage>
+
+class QTimer;
+class QVariantAnimation;
+
+// Crossfade layer for MediaPlayer's transitions, a child of the media area.
+// hold() covers the area with a snapshot of the outgoing item, taken once,
+// while the next item starts underneath; reveal() then fades the snapshot
+// out over it. The blend is plain QPainter opacity in the widget backing
+// store, so no compositor is needed. The video output is a native window
+// that would cover any sibling, so an incoming video is drawn here instead,
+// from frames passed to showIncoming(), until the fade is done.
+class TransitionOverlay : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit TransitionOverlay(QWidget *parent = nullptr);
+
+    // Show outgoing over the parent at full opacity until reveal(), which
+    // then fades it out over durationMs
+    void hold(const QPixmap &outgoing, int durationMs);
+    // Paint frame (black while null) under the snapshot instead of letting
+    // the widgets below show through; cleared with the snapshot
+    void showIncoming(const QImage &frame);
+    void reveal(); // finished() once the snapshot is gone
+    void cancel(); // Drop the snapshot at once, without finished()
+    bool isActive() const { return !m_snapshot.isNull(); }
+
+signals:
+    void finished();
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+
+private:
+    void finish();
+
+    QPixmap m_snapshot;
+    QImage m_incoming;
+    bool m_paintsIncoming = false;
+    qreal m_opacity = 1.0;
+    QVariantAnimation *m_animation;
+    QTimer *m_holdTimer; // Reveals anyway if the incoming item never shows up
+
+    static const int MAX_HOLD_MS = 3000;
+};
+
+#endif // TRANSITIONOVERLAY_H
@@ -0,0 +1,101 @@
+#include "videowall.h"
+#include <QGraphicsScene>
+#include <QGraphicsVideoItem>
+#include <QPainter>
+#include <QResizeEvent>
+#include <QStringList>
+
+bool WallConfig::parse(const QString &grid, const QString &tile, WallConfig *config, QString *errorMessage)
+{
+    QStringList gridParts = grid.toLower().split('x');
+    if (gridParts.size() != 2) {
+        *errorMessage = QString("Invalid wall layout '%1' (expected COLSxROWS, e.g. 2x2)").arg(grid);
+        return false;
+    }
+    bool colsOk = false, rowsOk = false;
+    int columns = gridParts[0].toInt(&colsOk);
+    int rows = gridParts[1].toInt(&rowsOk);
+    if (!colsOk || !rowsOk || columns < 1 || rows < 1) {
+        *errorMessage = QString("Invalid wall layout '%1'").arg(grid);
+        return false;
+    }
+
+    QStringList tileParts = tile.split(',');
+    if (tileParts.size() != 2) {
+        *errorMessage = QString("Invalid tile position '%1' (expected COL,ROW, e.g. 1,0)").arg(tile);
+        return false;
+    }
+    bool colOk = false, rowOk = false;
+    int column = tileParts[0].toInt(&colOk);
+    int row = tileParts[1].toInt(&rowOk);
+    if (!colOk || !rowOk || column < 0 || row < 0 || column >= columns || row >= rows) {
+        *errorMessage = QString("Tile position '%1' is outside a %2x%3 wall").arg(tile).arg(columns).arg(rows);
+        return false;
+    }
+
+    config->columns = columns;
+    config->rows = rows;
+    config->column = column;
+    config->row = row;
+    return true;
+}
+
+QImage renderWallTile(const QImage &source, const WallConfig &config, const QSize &tileSize)
+{
+    QImage tile(tileSize, QImage::Format_RGB32);
+    tile.fill(Qt::black);
+    if (source.isNull() || tileSize.isEmpty()) {
+        return tile;
+    }
+
+    // Fit the image to the whole wall, then map our tile back to source pixels
+    // so only the visible part is scaled
+    QSize wallSize = config.wallSize(tileSize);
+    QSize scaledSize = source.size().scaled(wallSize, Qt::KeepAspectRatio);
+    qreal scale = static_cast<qreal>(scaledSize.width()) / source.width();
+    QPointF origin((wallSize.width() - scaledSize.width()) / 2.0,
+                   (wallSize.height() - scaledSize.height()) / 2.0);
+
+    QRectF tileRect = config.tileRect(tileSize);
+    QRectF visible = tileRect.intersected(QRectF(origin, QSizeF(scaledSize)));
+    if (visible.isEmpty()) {
+        return tile; // Tile is entirely in the letterbox
+    }
+
+    QRectF sourceRect((visible.topLeft() - origin) / scale, visible.size() / scale);
+    QPainter painter(&tile);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+    painter.drawImage(visible.translated(-tileRect.topLeft()), source, sourceRect);
+    return tile;
+}
+
+VideoWallView::VideoWallView(const WallConfig &config, QWidget *parent)
+    : QGraphicsView(parent)
+    , m_config(config)
+{
+    m_scene = new QGraphicsScene(this);
+    m_videoItem = new QGraphicsVideoItem();
+    m_videoItem->setAspectRatioMode(Qt::KeepAspectRatio);
+    m_scene->addItem(m_videoItem);
+
+    setScene(m_scene);
+    setFrameShape(QFrame::NoFrame);
+    setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    setAlignment(Qt::AlignLeft | Qt::AlignTop);
+    setBackgroundBrush(Qt::black);
+    setViewportUpdateMode(QGraphicsView::FullViewportUpdate);
+}
+
+void VideoWallView::resizeEvent(QResizeEvent *event)
+{
+    QGraphicsView::resizeEvent(event);
+    layoutTile();
+}
+
+void VideoWallView::layoutTile()
+{
+    QSize tileSize = viewport()->size();
+    m_videoItem->setSize(m_config.wallSize(tileSize));
+    m_scene->setSceneRect(m_config.tileRect(tileSize));
+}
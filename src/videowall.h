@@ -0,0 +1,66 @@
+#ifndef VIDEOWALL_H
+#define VIDEOWALL_H
+
+#include <QGraphicsView>
+#include <QImage>
+#include <QRect>
+#include <QSize>
+#include <QString>
+
+class QGraphicsScene;
+class QGraphicsVideoItem;
+
+// Position of this display in a multi-display video wall (e.g. tile 1,0 of a
+// 2x2 wall). The default 1x1 wall is a normal standalone display.
+struct WallConfig {
+    int columns = 1;
+    int rows = 1;
+    int column = 0;
+    int row = 0;
+
+    bool isEnabled() const { return columns * rows > 1; }
+
+    // Full wall size and this display's region of it, given one tile's size
+    QSize wallSize(const QSize &tileSize) const {
+        return QSize(tileSize.width() * columns, tileSize.height() * rows);
+    }
+    QRect tileRect(const QSize &tileSize) const {
+        return QRect(column * tileSize.width(), row * tileSize.height(),
+                     tileSize.width(), tileSize.height());
+    }
+    QString toString() const {
+        return QString("%1x%2 tile %3,%4").arg(columns).arg(rows).arg(column).arg(row);
+    }
+
+    // Parses "--wall 2x2" and "--tile 1,0" values; sets errorMessage on bad input
+    static bool parse(const QString &grid, const QString &tile, WallConfig *config, QString *errorMessage);
+};
+
+// Renders this display's tile of an image fitted to the whole wall. Works
+// on QImage so it can run on ImageDecodePool's threads.
+QImage renderWallTile(const QImage &source, const WallConfig &config, const QSize &tileSize);
+
+// Video output for wall mode. The video item is laid out at full wall size
+// and the view's scene rect is this display's tile, so only the crop region
+// is drawn while every display decodes the same source.
+class VideoWallView : public QGraphicsView
+{
+    Q_OBJECT
+
+public:
+    explicit VideoWallView(const WallConfig &config, QWidget *parent = nullptr);
+
+    QGraphicsVideoItem *videoItem() const { return m_videoItem; }
+
+protected:
+    void resizeEvent(QResizeEvent *event) override;
+
+private:
+    void layoutTile();
+
+    WallConfig m_config;
+    QGraphicsScene *m_scene;
+    QGraphicsVideoItem *m_videoItem;
+};
+
+#endif // VIDEOWALL_H
@@ -9,7 +9,7 @@
 #include <QPixmap>
 #include <QDebug>
 
-VideoWidget::VideoWidget(MediaCache *cache, QWidget *parent)
+VideoWidget::VideoWidget(MediaCache *cache, const WallConfig &wall, QWidget *parent)
     : QWidget(parent)
     , m_mediaCache(cache)
 {
@@ -21,7 +21,14 @@ VideoWidget::VideoWidget(MediaCache *cache, QWidget *parent)
     setStyleSheet("border: none;");
 
     // --- Video Widget for Videos ---
-    m_videoOutput = new QVideoWidget(this);
+    // In wall mode the video is rendered through a graphics view so it can be cropped to our tile
+    VideoWallView *wallView = nullptr;
+    if (wall.isEnabled()) {
+        wallView = new VideoWallView(wall, this);
+        m_videoOutput = wallView;
+    } else {
+        m_videoOutput = new QVideoWidget(this);
+    }
 
     // --- Fallback Image Label ---
     m_fallbackLabel = new QLabel(this);
@@ -46,7 +53,12 @@ VideoWidget::VideoWidget(MediaCache *cache, QWidget *parent)
     m_mainLayout->setCurrentWidget(m_fallbackLabel);
 
     // --- Initialize Media Player ---
-    m_mediaPlayer = new MediaPlayer(m_videoOutput, m_fallbackLabel, m_mainLayout, this);
+    if (wallView) {
+        m_mediaPlayer = new MediaPlayer(wallView, wallView->videoItem(), m_fallbackLabel, m_mainLayout, this);
+    } else {
+        m_mediaPlayer = new MediaPlayer(static_cast<QVideoWidget*>(m_videoOutput), m_fallbackLabel, m_mainLayout, this);
+    }
+    m_mediaPlayer->setWallConfig(wall);
     m_mediaPlayer->setMediaCache(m_mediaCache); // Set the cache
     connect(m_mediaPlayer, &MediaPlayer::mediaChanged, this, &VideoWidget::onMediaChanged);
     
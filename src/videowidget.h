@@ -4,6 +4,7 @@
 #include <QWidget>
 #include <QResizeEvent>
 #include "networkclient.h" // For the MediaItem struct
+#include "videowall.h"
 
 // Forward declarations
 class QVideoWidget;
@@ -17,7 +18,7 @@ class VideoWidget : public QWidget
     Q_OBJECT
 
 public:
-    explicit VideoWidget(MediaCache *cache, QWidget *parent = nullptr);
+    explicit VideoWidget(MediaCache *cache, const WallConfig &wall = WallConfig(), QWidget *parent = nullptr);
     
     // Expose MediaPlayer for signal connections
     MediaPlayer* getMediaPlayer() const { return m_mediaPlayer; }
@@ -37,7 +38,7 @@ protected:
     void resizeEvent(QResizeEvent *event) override;
 
 private:
-    QVideoWidget *m_videoOutput;
+    QWidget *m_videoOutput; // QVideoWidget, or VideoWallView in wall mode
     QLabel *m_fallbackLabel;
     QStackedLayout *m_mainLayout;
     MediaPlayer *m_mediaPlayer;